@@ -13,66 +13,75 @@
 #include <iostream>
 #include <string>
 
-#include "json_parser.h"
+#include "json_parser.hpp"
+
+// Prints a value and everything below it in document order, numbered like the token array
+static void Print(const json::value &value, size_t &index)
+{
+    std::cout << "Token " << index++ << ": ";
+
+    switch(value.type())
+    {
+        case JSON_TOKEN_OBJECT:
+            std::cout << "Object\n";
+
+            for(auto [key, member] : value.items())
+            {
+                std::cout << "Token " << index++ << ": String: " << key << "\n";
+                Print(member, index);
+            }
+
+            break;
+
+        case JSON_TOKEN_ARRAY:
+            std::cout << "Array\n";
+
+            for(json::value element : value)
+            {
+                Print(element, index);
+            }
+
+            break;
+
+        case JSON_TOKEN_STRING:
+            std::cout << "String: " << value.as_string() << "\n";
+            break;
+
+        case JSON_TOKEN_NUMBER:
+            std::cout << "Number: " << value.as_double() << "\n";
+            break;
+
+        case JSON_TOKEN_TRUE:
+            std::cout << "Boolean: true\n";
+            break;
+
+        case JSON_TOKEN_FALSE:
+            std::cout << "Boolean: false\n";
+            break;
+
+        case JSON_TOKEN_NULL:
+            std::cout << "Null\n";
+            break;
+
+        default:
+            std::cout << "Unknown\n";
+    }
+}
 
 int main()
 {
     // Use raw string literal to avoid escaping characters
     const std::string json = R"({"name":"John\u00D0e","age":30,"scores":[90.5,80.0]})";
-    json_parser_t parser;
-    json_parser_init(&parser, json.data(), json.size());
-    const json_error_t error = json_parser_parse(&parser);
+    json::document doc; // Frees the parser when it goes out of scope
+    const json_error_t error = doc.parse(json);
 
     if(error != JSON_ERROR_NONE)
     {
         std::cerr << "Error: " << json_error_string(error) << "\n";
-        json_parser_free(&parser);
         return 1;
     }
 
-    size_t token_count = 0;
-    const json_token_t *tokens = json_get_tokens(&parser, &token_count);
-
-    for(size_t i = 0; i < token_count; ++i)
-    {
-        const auto &token = tokens[i];
-        std::cout << "Token " << i << ": ";
-
-        switch(token.type)
-        {
-            case JSON_TOKEN_OBJECT:
-                std::cout << "Object\n";
-                break;
-
-            case JSON_TOKEN_ARRAY:
-                std::cout << "Array\n";
-                break;
-
-            case JSON_TOKEN_STRING:
-                std::cout << "String: " << token.value.string << "\n";
-                break;
-
-            case JSON_TOKEN_NUMBER:
-                std::cout << "Number: " << token.value.number << "\n";
-                break;
-
-            case JSON_TOKEN_TRUE:
-                std::cout << "Boolean: true\n";
-                break;
-
-            case JSON_TOKEN_FALSE:
-                std::cout << "Boolean: false\n";
-                break;
-
-            case JSON_TOKEN_NULL:
-                std::cout << "Null\n";
-                break;
-
-            default:
-                std::cout << "Unknown\n";
-        }
-    }
-
-    json_parser_free(&parser);
+    size_t index = 0;
+    Print(doc.root(), index);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+/**
+    @brief JSON Parser Library
+
+    A lightweight, single-header C library for parsing JSON data. Designed for simplicity and portability, this parser provides a low-footprint solution to decode JSON-formatted strings into structured tokens while adhering to core JSON specifications.
+
+    @date 2025-05-03
+    @version 1.0
+    @author Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license MIT License
+*/
+
+// Built with JSON_PROFILE_EMBEDDED, for the library and this file alike
+#include <gtest/gtest.h>
+#include "json_parser.h"
+#include <string>
+
+class JsonEmbeddedTest : public ::testing::Test
+{
+protected:
+    alignas(16) char buffer[16 * 1024];
+    json_arena_t arena;
+    json_parser_t parser;
+
+    void SetUp() override
+    {
+        json_arena_init(&arena, buffer, sizeof(buffer));
+        // A zeroed parser owns nothing, so Parse and TearDown may free it before the first init
+        memset(&parser, 0, sizeof(parser));
+    }
+
+    void TearDown() override
+    {
+        json_parser_free(&parser);
+        json_arena_free(&arena);
+    }
+
+    json_error_t Parse(const char *json)
+    {
+        json_parser_free(&parser);
+        json_parser_init_arena(&parser, json, strlen(json), &arena);
+        return json_parser_parse(&parser);
+    }
+};
+
+// Test: Every number is an integer, anything else is rejected
+TEST_F(JsonEmbeddedTest, IntegersOnly)
+{
+    ASSERT_EQ(Parse("[21, -5, 18446744073709551615, -9223372036854775808, -0]"), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.tokens[1].flags, JSON_TOKEN_FLAG_INTEGER);
+    EXPECT_EQ(parser.tokens[1].value.integer, 21);
+    EXPECT_EQ(parser.tokens[2].value.integer, -5);
+    EXPECT_EQ(parser.tokens[3].flags, JSON_TOKEN_FLAG_INTEGER | JSON_TOKEN_FLAG_UNSIGNED);
+    EXPECT_EQ(parser.tokens[3].value.uinteger, UINT64_MAX);
+    EXPECT_EQ(parser.tokens[4].value.integer, INT64_MIN);
+    EXPECT_EQ(parser.tokens[5].value.integer, 0);
+    int64_t value = 0;
+    EXPECT_EQ(json_token_get_int64(&parser, &parser.tokens[2], &value), JSON_ERROR_NONE);
+    EXPECT_EQ(value, -5);
+
+    const char *rejected[] = {"[1.5]", "[1e3]", "[2E-1]", "18446744073709551616", "[-9223372036854775809]"};
+
+    for(const char *json : rejected)
+    {
+        EXPECT_EQ(Parse(json), JSON_ERROR_INVALID_NUMBER) << json;
+        EXPECT_EQ(json_validate(json, strlen(json), JSON_DEFAULT_MAX_DEPTH, JSON_DEFAULT_MAX_STRING, NULL), JSON_ERROR_INVALID_NUMBER) << json;
+    }
+}
+
+// Test: Strings reference the input, \u escapes are not supported
+TEST_F(JsonEmbeddedTest, StringsReferenceInput)
+{
+    const char *json = "{\"key\": \"line\\nnext\"}";
+    ASSERT_EQ(Parse(json), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.tokens[1].flags, JSON_TOKEN_FLAG_RAW);
+    EXPECT_EQ(parser.tokens[1].value.string, json + 2);
+    EXPECT_EQ(parser.tokens[2].flags, JSON_TOKEN_FLAG_RAW | JSON_TOKEN_FLAG_ESCAPED);
+    EXPECT_EQ(parser.string_count, 0u);
+
+    // Decoding on access takes its buffer from the arena
+    size_t length;
+    const char *decoded = json_token_string(&parser, &parser.tokens[2], &length);
+    EXPECT_EQ(std::string(decoded, length), "line\nnext");
+    EXPECT_GE(decoded, buffer);
+    EXPECT_LT(decoded, buffer + sizeof(buffer));
+
+    EXPECT_EQ(Parse("\"\\u0041\""), JSON_ERROR_INVALID_UNICODE);
+    EXPECT_EQ(parser.pos, 3u);
+}
+
+// Test: The token array is taken from the arena once and never grows
+TEST_F(JsonEmbeddedTest, FixedTokenArray)
+{
+    std::string json = "[";
+
+    for(int i = 1; i < JSON_DEFAULT_MAX_TOKENS; i++)
+    {
+        json += i > 1 ? ",0" : "0";
+    }
+
+    json += "]";
+    ASSERT_EQ(Parse(json.c_str()), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.token_count, (size_t)JSON_DEFAULT_MAX_TOKENS);
+    EXPECT_EQ(parser.token_cap, (size_t)JSON_DEFAULT_MAX_TOKENS);
+    EXPECT_GE((const char *)parser.tokens, buffer);
+    EXPECT_LT((const char *)parser.tokens, buffer + sizeof(buffer));
+
+    json.insert(1, "0,");
+    EXPECT_EQ(Parse(json.c_str()), JSON_ERROR_MAX_TOKENS);
+    EXPECT_EQ(parser.token_cap, (size_t)JSON_DEFAULT_MAX_TOKENS);
+}
@@ -17,11 +17,32 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <math.h>
 
+/*
+    Profiles select feature switches for a whole build and must be defined the same way for
+    the library and its users:
+    - JSON_PROFILE_STRICT: no trailing comma in objects either.
+    - JSON_PROFILE_FAST: new parsers default to zero-copy strings and lazy numbers.
+    - JSON_PROFILE_EMBEDDED: integers only, no \u escapes, strings always reference the
+      input, and a token array of JSON_DEFAULT_MAX_TOKENS that never grows. Parsing with
+      json_parser_init_arena then runs without any heap allocation.
+    Without a profile the build is the general one, and each switch can be set on its own.
+*/
+#if defined(JSON_PROFILE_STRICT)
+#define JSON_STRICT
+#elif defined(JSON_PROFILE_FAST)
+#define JSON_DEFAULT_FLAGS (JSON_FLAG_ZERO_COPY | JSON_FLAG_LAZY_NUMBERS)
+#elif defined(JSON_PROFILE_EMBEDDED)
+#define JSON_NO_FLOAT
+#define JSON_NO_UNICODE_ESCAPES
+#define JSON_NO_STRING_COPY
+#define JSON_FIXED_TOKENS
+#endif
+
 #ifndef JSON_DEFAULT_MAX_TOKENS
 #define JSON_DEFAULT_MAX_TOKENS 128
 #endif
@@ -34,11 +55,37 @@ extern "C" {
 #define JSON_DEFAULT_MAX_STRING 256
 #endif
 
-// ASCII optimization for whitespace skipping
-#ifdef JSON_USE_SIMPLE_WHITESPACE_SKIPPING
-#define IS_WHITESPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
-#else
-#define IS_WHITESPACE(c) isspace(c)
+#ifndef JSON_ARENA_ALIGNMENT
+#define JSON_ARENA_ALIGNMENT 16
+#endif
+
+// Flags a parser starts with
+#ifndef JSON_DEFAULT_FLAGS
+#define JSON_DEFAULT_FLAGS 0
+#endif
+
+#ifndef JSON_OBJECT_INDEX_THRESHOLD
+#define JSON_OBJECT_INDEX_THRESHOLD 16
+#endif
+
+// Containers the parser tracks on the C stack before it allocates a frame stack
+#ifndef JSON_INLINE_FRAMES
+#define JSON_INLINE_FRAMES 64
+#endif
+
+// First capacity of a growing json_writer_t buffer
+#ifndef JSON_WRITER_INITIAL_CAPACITY
+#define JSON_WRITER_INITIAL_CAPACITY 256
+#endif
+
+// First capacity of a json_batch_t record array
+#ifndef JSON_BATCH_INITIAL_RECORDS
+#define JSON_BATCH_INITIAL_RECORDS 64
+#endif
+
+// Nesting json_validate tracks without allocating, a multiple of 64
+#ifndef JSON_VALIDATE_INLINE_DEPTH
+#define JSON_VALIDATE_INLINE_DEPTH 4096
 #endif
 
 typedef enum
@@ -54,7 +101,15 @@ typedef enum
     JSON_ERROR_INVALID_NUMBER,
     JSON_ERROR_TRAILING_CHARS,
     JSON_ERROR_ALLOCATION_FAILED,
-    JSON_ERROR_EMPTY_INPUT
+    JSON_ERROR_EMPTY_INPUT,
+    JSON_ERROR_NEED_MORE,
+    JSON_ERROR_ABORTED,
+    JSON_ERROR_IO,
+    JSON_ERROR_BUFFER_FULL,
+    JSON_ERROR_TYPE_MISMATCH,
+    JSON_ERROR_CORRUPT,
+    JSON_ERROR_STALE,
+    JSON_ERROR_TOO_LARGE
 } json_error_t;
 
 typedef enum
@@ -69,18 +124,185 @@ typedef enum
     JSON_TOKEN_NULL
 } json_token_type_t;
 
+// Parser option flags (json_parser_t.flags)
+#define JSON_FLAG_ZERO_COPY 0x01 // String tokens reference the input instead of owning a copy
+#define JSON_FLAG_PRESCAN 0x02   // Count tokens first so the token array is allocated once
+#define JSON_FLAG_STRUCTURAL_INDEX 0x04 // Build a SIMD structural index before parsing
+#define JSON_FLAG_INTEGERS 0x08 // Integer literals that fit 64 bits are stored as integers
+#define JSON_FLAG_LAZY_NUMBERS 0x10 // Numbers are only validated, conversion happens on access
+#define JSON_FLAG_OBJECT_INDEX 0x20 // Hash the keys of large objects right after parsing
+#define JSON_FLAG_INTERN_KEYS 0x40 // Copied object keys share one canonical string per distinct key
+
+// Token flags (json_token_t.flags)
+#define JSON_TOKEN_FLAG_RAW 0x01     // value.string points into the input, length is end - start
+#define JSON_TOKEN_FLAG_ESCAPED 0x02 // Raw string contains escapes, decode via json_token_string
+#define JSON_TOKEN_FLAG_INTEGER 0x04 // Number is held in value.integer
+#define JSON_TOKEN_FLAG_UNSIGNED 0x08 // Number is above INT64_MAX and held in value.uinteger
+#define JSON_TOKEN_FLAG_LAZY 0x10 // Number not converted yet, read it via json_token_get_*
+#define JSON_TOKEN_FLAG_INTERNED 0x20 // value.string is owned by an intern table, not by the token
+
+#define JSON_TOKEN_NO_PARENT ((unsigned int)-1)
+
+struct json_object_index;
+struct json_stream;
+struct json_frame;
+struct json_batch_worker;
+struct json_split;
+struct json_intern_block;
+
 typedef struct
 {
     json_token_type_t type;
+    unsigned int flags;
     union
     {
         char *string;
         double number;
+        int64_t integer;
+        uint64_t uinteger;
+        struct json_object_index *index; // Key table of an object, built by json_object_find
     } value;
     size_t start;
     size_t end;
+    unsigned int size; // Members of an object or elements of an array, 0 for scalars
+    unsigned int next; // Index one past the last descendant, i.e. the next sibling
+#ifdef JSON_PARENT_LINKS
+    unsigned int parent; // Index of the enclosing container, JSON_TOKEN_NO_PARENT for the root
+#endif
 } json_token_t;
 
+// Token of a frozen document, 16 bytes. Numbers, strings and key tables follow the tokens and
+// are referenced by their offset from the start of the blob, so a blob can be copied to any
+// 8-byte aligned address and stay valid.
+typedef struct
+{
+    uint16_t type;   // json_token_type_t
+    uint16_t flags;  // JSON_TOKEN_FLAG_INTEGER / JSON_TOKEN_FLAG_UNSIGNED for numbers
+    uint32_t size;   // Members or elements of a container, decoded byte length of a string
+    uint32_t next;   // Index one past the last descendant, i.e. the next sibling
+    uint32_t offset; // Blob offset of a number, a string's bytes or an object's key table, else 0
+} json_frozen_token_t;
+
+// Value of a frozen number, read with json_frozen_value
+typedef union
+{
+    double number;
+    int64_t integer;
+    uint64_t uinteger;
+} json_frozen_value_t;
+
+// Header of a frozen document. The tokens follow it, then the numbers, then the key tables of
+// objects with at least JSON_OBJECT_INDEX_THRESHOLD members, then the NUL-terminated strings.
+typedef struct
+{
+    uint32_t magic;   // JSON_FROZEN_MAGIC
+    uint32_t version; // JSON_FROZEN_VERSION
+    uint64_t size;    // Bytes of the whole blob, header included
+    uint64_t token_count;
+} json_frozen_t;
+
+#define JSON_FROZEN_MAGIC 0x4E5A464Au // "JFZN" read as little-endian bytes
+#define JSON_FROZEN_VERSION 2
+#define JSON_FROZEN_TOKENS(frozen) ((const json_frozen_token_t *)((const json_frozen_t *)(frozen) + 1))
+
+// Frozen document loaded from a tape file, or rebuilt from the source JSON by json_tape_open
+typedef struct
+{
+    const json_frozen_t *frozen; // Valid until json_tape_free
+    int reparsed;                // The tape could not be used and the source was parsed instead
+    char *file;                  // Tape file, mapped or read into the heap
+    size_t file_size;
+    int file_mapped;
+    json_frozen_t *owned;        // Document frozen from a reparse
+} json_tape_t;
+
+// Compiled JSON Pointer (RFC 6901). A "*" reference token matches every member or element.
+typedef struct
+{
+    const char *name; // Decoded reference token
+    size_t length;
+    size_t index;     // Array index, SIZE_MAX when the token is not a valid index
+    int wildcard;
+} json_path_segment_t;
+
+typedef struct
+{
+    json_path_segment_t *segments;
+    size_t count;
+    int wildcard; // Some segment is "*", so the path can match more than once
+} json_path_t;
+
+// Byte span [start, end) of a matched value in the input
+typedef struct
+{
+    size_t start;
+    size_t end;
+} json_path_match_t;
+
+// Return value of SAX callbacks
+typedef enum
+{
+    JSON_SAX_CONTINUE = 0,
+    JSON_SAX_SKIP, // From a *_begin or on_key callback: report nothing for that value's subtree
+    JSON_SAX_STOP  // End the parse, json_parser_parse_sax returns JSON_ERROR_ABORTED
+} json_sax_action_t;
+
+// Event callbacks for json_parser_parse_sax, any of them may be NULL.
+// Strings are not NUL-terminated and are only valid during the call.
+typedef struct
+{
+    json_sax_action_t (*on_object_begin)(void *user);
+    json_sax_action_t (*on_object_end)(void *user);
+    json_sax_action_t (*on_array_begin)(void *user);
+    json_sax_action_t (*on_array_end)(void *user);
+    json_sax_action_t (*on_key)(void *user, const char *key, size_t length);
+    json_sax_action_t (*on_string)(void *user, const char *value, size_t length);
+    json_sax_action_t (*on_number)(void *user, const json_token_t *token);
+    json_sax_action_t (*on_boolean)(void *user, int value);
+    json_sax_action_t (*on_null)(void *user);
+    void (*on_end)(void *user); // The whole document was parsed and validated
+} json_sax_handler_t;
+
+// Bump allocator over one contiguous region.
+// Token arrays are carved from the low end and strings from the high end.
+typedef struct
+{
+    char *base;
+    size_t size;
+    size_t low;
+    size_t high;
+    int owned;
+} json_arena_t;
+
+// Canonical copies of strings, each stored once in blocks together with its hash and length.
+// Pointers returned by json_intern stay valid until json_intern_free.
+typedef struct
+{
+    char **slots; // Open addressing, NULL marks an empty slot
+    size_t capacity;
+    size_t count;
+    struct json_intern_block *blocks;
+} json_intern_t;
+
+#ifdef JSON_PARSER_STATS
+// What the last json_parser_parse did, for finding out why a parse is slow.
+// Cycles come from the time stamp counter (rdtsc) where there is one, clock() otherwise.
+typedef struct
+{
+    size_t tokens;         // Tokens emitted
+    size_t token_reallocs; // Growths of the token array in json_add_token
+    size_t string_bytes;   // Bytes allocated for string copies
+    size_t escapes;        // Escape sequences decoded (validated only, in zero-copy mode)
+    size_t numbers;        // Numbers converted, lazy ones included when they are read
+    size_t max_depth;      // Deepest container nesting reached
+
+    uint64_t prescan_cycles;      // JSON_FLAG_PRESCAN token count
+    uint64_t index_cycles;        // JSON_FLAG_STRUCTURAL_INDEX stage 1
+    uint64_t parse_cycles;        // Token building
+    uint64_t object_index_cycles; // JSON_FLAG_OBJECT_INDEX key hashing
+} json_parse_stats_t;
+#endif
+
 typedef struct
 {
     const char *json;
@@ -93,19 +315,256 @@ typedef struct
 
     size_t max_depth;
     size_t max_string;
+    unsigned int flags;
+    size_t string_count;
+    size_t index_count;
+
+    json_arena_t *arena;
+    size_t arena_low;
+    size_t arena_high;
+
+    uint32_t *structurals;
+    size_t structural_count;
+    size_t structural_cap;
+    size_t structural_cursor;
+    int use_index;
+
+    struct json_frame *frames; // Container stack of the iterative parser
+    size_t frame_cap;
+
+    struct json_stream *stream; // State of json_parser_feed, NULL outside push parsing
+    struct json_split *split;   // Pre-parsed array of json_parser_parse_parallel
+
+    char *file;       // Input owned by json_parser_init_file, released by json_parser_free
+    size_t file_size;
+    int file_mapped;  // `file` is a read-only mapping rather than a heap copy
+
+    const json_sax_handler_t *sax; // Set only during json_parser_parse_sax
+    void *sax_user;
+    int sax_muted;     // Inside a subtree a callback asked to skip
+    int sax_skip_next; // on_key asked to skip the member value
+    char *scratch;     // Reused buffer for decoding escaped SAX strings and interned keys
+    size_t scratch_cap;
+
+    json_intern_t *intern;              // Table JSON_FLAG_INTERN_KEYS adds keys to, made on first use if NULL
+    const json_intern_t *intern_shared; // Searched first and never modified, so parsers on several threads may share it
+    int intern_owned;                   // `intern` was made by the parser and is freed with it
+
+    int borrowed; // The tokens belong to a batch record (json_record_view): never cached into nor freed
 
     json_error_t error;
     int depth;
+#ifdef JSON_PARENT_LINKS
+    unsigned int parent;
+#endif
+#ifdef JSON_PARSER_STATS
+    json_parse_stats_t stats; // Reset and filled by json_parser_parse
+#endif
 } json_parser_t;
 
+// Fixed set of parsers handed out and taken back without locks, e.g. one per request thread.
+// Parsers keep their token arrays and settings between uses.
+typedef struct
+{
+    json_parser_t *parsers;
+    uint32_t *links; // Free list: index + 1 of the next free parser, 0 ends the list
+    size_t count;
+    uint64_t head;   // Index + 1 of the first free parser in the low half, a change count in the high half
+} json_parser_pool_t;
+
+// Streaming JSON writer. Commas and colons are placed automatically; the output is not
+// NUL-terminated.
+typedef struct
+{
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    int owned;       // The writer allocated `buffer` and grows it as needed
+    int needs_comma; // A value was completed at the current level
+    int after_key;   // The next value is a member value
+    size_t depth;
+    json_error_t error; // First error, every later write is a no-op
+} json_writer_t;
+
+// One line of a newline-delimited (NDJSON / JSON Lines) batch
+typedef struct
+{
+    size_t start; // Byte range of the line in the batch input, without the newline
+    size_t end;
+    const json_token_t *tokens; // Tokens of this record, NULL when it failed to parse
+    size_t token_count;         // next/parent links index into `tokens`; token offsets are absolute
+    json_error_t error;
+    size_t error_pos;           // Absolute offset where parsing stopped
+} json_record_t;
+
+typedef struct
+{
+    // Settings, applied to every record
+    unsigned int flags;   // JSON_FLAG_*, lazy numbers and the object index are not supported
+    size_t max_depth;
+    size_t max_string;
+    unsigned int threads; // Workers parsing disjoint record ranges, needs JSON_THREADS
+
+    // Results of the last json_batch_parse
+    const char *json;     // Its input, which record views read through
+    size_t length;
+    json_record_t *records;
+    size_t record_count;
+    size_t error_count;   // Records with error != JSON_ERROR_NONE
+
+    struct json_batch_worker *workers;
+    unsigned int worker_count;
+} json_batch_t;
+
+// Where json_bind stores a member's value: an integer of 1, 2, 4 or 8 bytes, a float or
+// double, a bool (any integer size), a NUL-terminated char array, or a nested struct
+typedef enum
+{
+    JSON_FIELD_INT,
+    JSON_FIELD_UINT,
+    JSON_FIELD_DOUBLE,
+    JSON_FIELD_BOOL,
+    JSON_FIELD_STRING,
+    JSON_FIELD_OBJECT
+} json_field_type_t;
+
+struct json_schema;
+
+typedef struct
+{
+    const char *key;
+    json_field_type_t type;
+    size_t offset;                    // Of the member in the target struct
+    size_t size;                      // Of the member, the buffer capacity for strings
+    const struct json_schema *schema; // Members of a JSON_FIELD_OBJECT, compiled beforehand
+} json_field_t;
+
+// Field table of one struct, with the key hashes json_schema_compile precomputes
+typedef struct json_schema
+{
+    const json_field_t *fields;
+    size_t count;
+    uint32_t *slots; // Open addressing: (key hash, field index + 1, key length) per slot
+    uint32_t mask;
+    size_t max_key;  // Longest key; longer input keys are skipped without being decoded
+    // Limits json_bind applies with this schema at the root. Known string members are bounded
+    // by their buffer only; max_string covers keys and skipped values, unbounded by default.
+    size_t max_depth;
+    size_t max_string;
+} json_schema_t;
+
+#define JSON_BIND(key, type, member, kind) {key, kind, offsetof(type, member), sizeof(((type *)0)->member), NULL}
+#define JSON_BIND_OBJECT(key, type, member, schema) {key, JSON_FIELD_OBJECT, offsetof(type, member), sizeof(((type *)0)->member), schema}
+
 // Initialization and cleanup
 void json_parser_init(json_parser_t *parser, const char *json, size_t length);
+void json_parser_init_arena(json_parser_t *parser, const char *json, size_t length, json_arena_t *arena);
+json_error_t json_parser_init_file(json_parser_t *parser, const char *path);
 void json_parser_free(json_parser_t *parser);
+void json_parser_reset(json_parser_t *parser, const char *json, size_t length);
 json_error_t json_parser_parse(json_parser_t *parser);
+json_error_t json_parser_reserve(json_parser_t *parser, size_t count);
+size_t json_count_tokens(const char *json, size_t length);
+json_error_t json_validate(const char *json, size_t length, size_t max_depth, size_t max_string, size_t *error_pos);
+
+// Push parsing of chunked input
+json_error_t json_parser_feed(json_parser_t *parser, const char *chunk, size_t length);
+json_error_t json_parser_finish(json_parser_t *parser);
+
+// Parsing one large array on several threads
+json_error_t json_parser_parse_parallel(json_parser_t *parser, const json_path_t *array, unsigned int threads);
+
+// Event-driven parsing without a token array
+json_error_t json_parser_parse_sax(json_parser_t *parser, const json_sax_handler_t *handler, void *user);
+
+// Newline-delimited batches
+void json_batch_init(json_batch_t *batch);
+json_error_t json_batch_parse(json_batch_t *batch, const char *json, size_t length);
+json_error_t json_record_view(const json_batch_t *batch, const json_record_t *record, json_parser_t *view);
+void json_batch_free(json_batch_t *batch);
+
+// Arena management
+json_error_t json_arena_init(json_arena_t *arena, void *buffer, size_t size);
+void json_arena_reset(json_arena_t *arena);
+void json_arena_free(json_arena_t *arena);
 
 // Utility functions
 const char *json_error_string(json_error_t error);
 const json_token_t *json_get_tokens(const json_parser_t *parser, size_t *count);
+const char *json_token_string(json_parser_t *parser, const json_token_t *token, size_t *length);
+const char *json_structural_backend(void);
+#ifndef JSON_NO_FLOAT
+double json_token_get_double(json_parser_t *parser, const json_token_t *token);
+#endif
+json_error_t json_token_get_int64(json_parser_t *parser, const json_token_t *token, int64_t *value);
+json_error_t json_token_get_uint64(json_parser_t *parser, const json_token_t *token, uint64_t *value);
+
+// Object lookup
+const json_token_t *json_object_find(json_parser_t *parser, const json_token_t *object, const char *key, size_t length);
+
+// Path queries over raw input
+json_error_t json_path_compile(json_path_t *path, const char *pointer, size_t length);
+void json_path_free(json_path_t *path);
+json_error_t json_path_query(const json_path_t *path, const char *json, size_t length,
+                             json_path_match_t *matches, size_t max_matches, size_t *count);
+
+// String interning
+void json_intern_init(json_intern_t *table);
+const char *json_intern(json_intern_t *table, const char *string, size_t length);
+const char *json_intern_find(const json_intern_t *table, const char *string, size_t length);
+void json_intern_free(json_intern_t *table);
+
+// Frozen documents: one self-contained, read-only allocation that any number of threads can
+// read at once. json_freeze with a NULL buffer only reports the size.
+json_error_t json_freeze(json_parser_t *parser, void *buffer, size_t capacity, size_t *size);
+json_error_t json_freeze_alloc(json_parser_t *parser, json_frozen_t **frozen);
+void json_frozen_free(json_frozen_t *frozen);
+const char *json_frozen_string(const json_frozen_t *frozen, const json_frozen_token_t *token, size_t *length);
+const json_frozen_value_t *json_frozen_value(const json_frozen_t *frozen, const json_frozen_token_t *token);
+const json_frozen_token_t *json_frozen_find(const json_frozen_t *frozen, const json_frozen_token_t *object, const char *key, size_t length);
+json_error_t json_frozen_check(const void *blob, size_t size);
+
+// Tape files: a frozen document on disk, reloaded with one mmap. `source_path` may be NULL
+// to skip the staleness check.
+json_error_t json_tape_save(json_parser_t *parser, const char *path, const char *source_path);
+json_error_t json_tape_load(json_tape_t *tape, const char *path, const char *source_path);
+json_error_t json_tape_open(json_tape_t *tape, const char *path, const char *source_path, unsigned int flags);
+void json_tape_free(json_tape_t *tape);
+
+// Parser pools. acquire returns NULL when every parser is in use.
+json_error_t json_parser_pool_init(json_parser_pool_t *pool, size_t count);
+json_parser_t *json_parser_pool_acquire(json_parser_pool_t *pool, const char *json, size_t length);
+void json_parser_pool_release(json_parser_pool_t *pool, json_parser_t *parser);
+void json_parser_pool_free(json_parser_pool_t *pool);
+
+// Decoding straight into structs
+json_error_t json_schema_compile(json_schema_t *schema, const json_field_t *fields, size_t count);
+void json_schema_free(json_schema_t *schema);
+json_error_t json_bind(const json_schema_t *schema, const char *json, size_t length, void *target, size_t *error_pos);
+
+// Writer. A NULL buffer makes the writer allocate `capacity` bytes and grow them, a caller
+// buffer is never grown and fails with JSON_ERROR_BUFFER_FULL.
+void json_writer_init(json_writer_t *writer, char *buffer, size_t capacity);
+void json_writer_reset(json_writer_t *writer);
+void json_writer_free(json_writer_t *writer);
+json_error_t json_write_object_begin(json_writer_t *writer);
+json_error_t json_write_object_end(json_writer_t *writer);
+json_error_t json_write_array_begin(json_writer_t *writer);
+json_error_t json_write_array_end(json_writer_t *writer);
+json_error_t json_write_key(json_writer_t *writer, const char *key, size_t length);
+json_error_t json_write_string(json_writer_t *writer, const char *string, size_t length);
+#ifndef JSON_NO_FLOAT
+json_error_t json_write_double(json_writer_t *writer, double value);
+#endif
+json_error_t json_write_int64(json_writer_t *writer, int64_t value);
+json_error_t json_write_uint64(json_writer_t *writer, uint64_t value);
+json_error_t json_write_bool(json_writer_t *writer, int value);
+json_error_t json_write_null(json_writer_t *writer);
+json_error_t json_write_raw(json_writer_t *writer, const char *json, size_t length);
+
+// Verbatim copies of parsed values and keys from the parser's input, which must still be valid
+json_error_t json_write_token(json_writer_t *writer, const json_parser_t *parser, const json_token_t *token);
+json_error_t json_write_key_token(json_writer_t *writer, const json_parser_t *parser, const json_token_t *key);
 
 #ifdef __cplusplus
 }
@@ -119,751 +578,7454 @@ const json_token_t *json_get_tokens(const json_parser_t *parser, size_t *count);
 
 #ifdef JSON_PARSER_IMPLEMENTATION
 
-static void json_set_error(json_parser_t *parser, json_error_t error)
+// Allocation hooks. Define all four before including the implementation to route the
+// library's heap use elsewhere, e.g. to count allocations.
+#ifndef JSON_MALLOC
+#define JSON_MALLOC(size) malloc(size)
+#define JSON_CALLOC(count, size) calloc(count, size)
+#define JSON_REALLOC(ptr, size) realloc(ptr, size)
+#define JSON_FREE(ptr) free(ptr)
+#endif
+
+#ifdef JSON_THREADS
+#include <pthread.h>
+#endif
+
+#include <stdio.h>
+
+// Parse statistics. Without JSON_PARSER_STATS every hook expands to nothing.
+#ifdef JSON_PARSER_STATS
+#include <time.h>
+
+static uint64_t json_cycles(void)
 {
-    if(parser->error == JSON_ERROR_NONE)
-    {
-        parser->error = error;
-    }
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return (uint64_t)clock();
+#endif
 }
 
-static int json_parse_value(json_parser_t *parser);
+#define JSON_STATS_ADD(parser, field, n) ((parser)->stats.field += (n))
+#define JSON_STATS_MAX(parser, field, n) ((parser)->stats.field = (parser)->stats.field < (size_t)(n) ? (size_t)(n) : (parser)->stats.field)
+#define JSON_STATS_START(var) uint64_t var = json_cycles()
+#define JSON_STATS_STOP(parser, field, var) ((parser)->stats.field += json_cycles() - (var))
+#else
+#define JSON_STATS_ADD(parser, field, n) ((void)0)
+#define JSON_STATS_MAX(parser, field, n) ((void)0)
+#define JSON_STATS_START(var) ((void)0)
+#define JSON_STATS_STOP(parser, field, var) ((void)0)
+#endif
 
-void json_parser_init(json_parser_t *parser, const char *json, size_t length)
+// Byte classes shared by the scanners. Whitespace is exactly the four RFC 8259 bytes
+// whatever the C locale, and each test is a single load instead of a libc call.
+#define JSON_CHAR_SPACE 0x01      // ' ' '\t' '\n' '\r'
+#define JSON_CHAR_DIGIT 0x02      // '0'..'9'
+#define JSON_CHAR_HEX 0x04        // Digits and 'a'..'f', 'A'..'F'
+#define JSON_CHAR_OPEN 0x08       // '{' '['
+#define JSON_CHAR_CLOSE 0x10      // '}' ']'
+#define JSON_CHAR_SEPARATOR 0x20  // ',' ':'
+#define JSON_CHAR_STRING_END 0x40 // '"', '\\' and control bytes, which end a plain string run
+#define JSON_CHAR_NUMBER 0x80     // Bytes a number can start with: digits, '-' and '.'
+#define JSON_CHAR_STRUCTURAL (JSON_CHAR_OPEN | JSON_CHAR_CLOSE | JSON_CHAR_SEPARATOR)
+
+// Bytes 0x80 and above belong to no class
+static const unsigned char json_char_class[256] =
 {
-    memset(parser, 0, sizeof(*parser));
-    parser->json = json;
-    parser->length = length;
-    parser->token_cap = JSON_DEFAULT_MAX_TOKENS;
-    parser->max_depth = JSON_DEFAULT_MAX_DEPTH;
-    parser->max_string = JSON_DEFAULT_MAX_STRING;
-    parser->tokens = malloc(parser->token_cap * sizeof(json_token_t));
+    0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x41, 0x41, 0x40, 0x40, 0x41, 0x40, 0x40, // 0x00
+    0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, // 0x10
+    0x01, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x80, 0x80, 0x00, // 0x20
+    0x86, 0x86, 0x86, 0x86, 0x86, 0x86, 0x86, 0x86, 0x86, 0x86, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x30
+    0x00, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x40
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x40, 0x10, 0x00, 0x00, // 0x50
+    0x00, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x60
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x10, 0x00, 0x00, // 0x70
+};
+
+#define JSON_IS_CHAR(c, cls) (json_char_class[(unsigned char)(c)] & (cls))
+#define JSON_IS_WHITESPACE(c) JSON_IS_CHAR(c, JSON_CHAR_SPACE)
+
+#if defined(__unix__) || defined(__APPLE__)
+#define JSON_HAVE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
-    if(!parser->tokens)
+static void json_set_error(json_parser_t *parser, json_error_t error)
+{
+    if(parser->error == JSON_ERROR_NONE)
     {
-        parser->error = JSON_ERROR_ALLOCATION_FAILED;
+        parser->error = error;
     }
 }
 
-void json_parser_free(json_parser_t *parser)
+json_error_t json_arena_init(json_arena_t *arena, void *buffer, size_t size)
 {
-    for(size_t i = 0; i < parser->token_count; i++)
+    memset(arena, 0, sizeof(*arena));
+
+    if(!buffer)
     {
-        if(parser->tokens[i].type == JSON_TOKEN_STRING)
+        buffer = JSON_MALLOC(size);
+
+        if(!buffer)
         {
-            free(parser->tokens[i].value.string);
+            return JSON_ERROR_ALLOCATION_FAILED;
         }
+
+        arena->owned = 1;
     }
 
-    free(parser->tokens);
-    memset(parser, 0, sizeof(*parser));
+    arena->base = buffer;
+    arena->size = size;
+    arena->high = size;
+    return JSON_ERROR_NONE;
 }
 
-const char *json_error_string(json_error_t error)
+void json_arena_reset(json_arena_t *arena)
 {
-    switch(error)
+    arena->low = 0;
+    arena->high = arena->size;
+}
+
+void json_arena_free(json_arena_t *arena)
+{
+    if(arena->owned)
     {
-        case JSON_ERROR_NONE:
-            return "No error";
+        JSON_FREE(arena->base);
+    }
 
-        case JSON_ERROR_INVALID_TOKEN:
-            return "Invalid token";
+    memset(arena, 0, sizeof(*arena));
+}
 
-        case JSON_ERROR_UNEXPECTED_CHAR:
-            return "Unexpected character";
+static size_t json_arena_padding(const json_arena_t *arena)
+{
+    uintptr_t addr = (uintptr_t)(arena->base + arena->low);
+    return (JSON_ARENA_ALIGNMENT - (addr & (JSON_ARENA_ALIGNMENT - 1))) & (JSON_ARENA_ALIGNMENT - 1);
+}
 
-        case JSON_ERROR_MAX_TOKENS:
-            return "Max tokens exceeded";
+// Bytes usable by the next low allocation once alignment is applied
+static size_t json_arena_available(const json_arena_t *arena)
+{
+    size_t pad = json_arena_padding(arena);
+    size_t free_bytes = arena->high - arena->low;
+    return free_bytes > pad ? free_bytes - pad : 0;
+}
 
-        case JSON_ERROR_STRING_TOO_LONG:
-            return "String too long";
+static void *json_arena_alloc_low(json_arena_t *arena, size_t size)
+{
+    if(size == 0 || json_arena_available(arena) < size)
+    {
+        return NULL;
+    }
 
-        case JSON_ERROR_INVALID_ESCAPE:
-            return "Invalid escape sequence";
+    arena->low += json_arena_padding(arena);
+    void *ptr = arena->base + arena->low;
+    arena->low += size;
+    return ptr;
+}
 
-        case JSON_ERROR_INVALID_UNICODE:
-            return "Invalid Unicode escape";
+static void *json_arena_alloc_high(json_arena_t *arena, size_t size)
+{
+    if(arena->high - arena->low < size)
+    {
+        return NULL;
+    }
 
-        case JSON_ERROR_NESTING_DEPTH:
-            return "Nesting depth exceeded";
+    arena->high -= size;
+    return arena->base + arena->high;
+}
 
-        case JSON_ERROR_INVALID_NUMBER:
-            return "Invalid number format";
+// Copied strings are preceded by their decoded length, so strings with embedded NULs keep it
+// and reading it costs no strlen. Arena strings are byte aligned, hence the memcpy.
+#define JSON_STRING_HEADER sizeof(size_t)
 
-        case JSON_ERROR_TRAILING_CHARS:
-            return "Trailing characters";
+static void json_string_set_length(char *string, size_t length)
+{
+    memcpy(string - JSON_STRING_HEADER, &length, sizeof(length));
+}
 
-        case JSON_ERROR_ALLOCATION_FAILED:
-            return "Memory allocation failed";
+static size_t json_string_length(const char *string)
+{
+    size_t length;
+    memcpy(&length, string - JSON_STRING_HEADER, sizeof(length));
+    return length;
+}
 
-        default:
-            return "Unknown error";
+static void json_free_string(char *string)
+{
+    if(string)
+    {
+        JSON_FREE(string - JSON_STRING_HEADER);
     }
 }
 
-const json_token_t *json_get_tokens(const json_parser_t *parser, size_t *count)
+// Room for `length` bytes and a NUL, from the arena when one is attached, otherwise from the
+// heap. The stored length is `length` until json_string_set_length corrects it.
+static char *json_alloc_string(json_parser_t *parser, size_t length)
 {
-    if(count)
+    JSON_STATS_ADD(parser, string_bytes, length + 1);
+    char *buffer;
+
+    if(parser->arena)
     {
-        *count = parser->token_count;
+        buffer = json_arena_alloc_high(parser->arena, JSON_STRING_HEADER + length + 1);
+    }
+    else
+    {
+        buffer = JSON_MALLOC(JSON_STRING_HEADER + length + 1);
+
+        if(buffer)
+        {
+            parser->string_count++;
+        }
     }
 
-    return parser->tokens;
+    if(!buffer)
+    {
+        return NULL;
+    }
+
+    buffer += JSON_STRING_HEADER;
+    json_string_set_length(buffer, length);
+    return buffer;
 }
 
-static void json_skip_whitespace(json_parser_t *parser)
+void json_parser_init(json_parser_t *parser, const char *json, size_t length)
 {
-    while(parser->pos < parser->length && IS_WHITESPACE(parser->json[parser->pos]))
-    {
-        parser->pos++;
-    }
+    json_parser_init_arena(parser, json, length, NULL);
 }
 
-static int json_add_token(json_parser_t *parser, json_token_type_t type)
+void json_parser_init_arena(json_parser_t *parser, const char *json, size_t length, json_arena_t *arena)
 {
-    if(parser->token_count >= parser->token_cap)
+    memset(parser, 0, sizeof(*parser));
+    parser->json = json;
+    parser->length = length;
+    parser->token_cap = JSON_DEFAULT_MAX_TOKENS;
+    parser->max_depth = JSON_DEFAULT_MAX_DEPTH;
+    parser->max_string = JSON_DEFAULT_MAX_STRING;
+    parser->flags = JSON_DEFAULT_FLAGS;
+    parser->arena = arena;
+
+    if(arena)
     {
-        size_t new_cap = parser->token_cap * 2;
-        json_token_t *new_tokens = realloc(parser->tokens, new_cap * sizeof(json_token_t));
+        parser->arena_low = arena->low;
+        parser->arena_high = arena->high;
+#ifdef JSON_FIXED_TOKENS
+        // The whole token array is taken at once, it never grows
+        parser->tokens = json_arena_alloc_low(arena, parser->token_cap * sizeof(json_token_t));
+#else
+        // Nothing is reserved up front: the token array grows in place one slot at a time,
+        // so tokens and strings share the arena without either side starving the other
+        parser->token_cap = 0;
 
-        if(!new_tokens)
+        if(json_arena_padding(arena) <= arena->high - arena->low)
         {
-            json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
-            return -1;
+            arena->low += json_arena_padding(arena);
+            parser->tokens = (json_token_t *)(arena->base + arena->low);
         }
-
-        parser->tokens = new_tokens;
-        parser->token_cap = new_cap;
+#endif
+    }
+    else
+    {
+        parser->tokens = JSON_MALLOC(parser->token_cap * sizeof(json_token_t));
     }
 
-    json_token_t *token = &parser->tokens[parser->token_count++];
-    memset(token, 0, sizeof(*token));
-    token->type = type;
-    token->start = parser->pos;
-    token->end = parser->pos;
-    return 0;
+    if(!parser->tokens)
+    {
+        parser->token_cap = 0;
+        parser->error = JSON_ERROR_ALLOCATION_FAILED;
+    }
 }
 
-static int json_parse_unicode_escape(json_parser_t *parser, char *buf, size_t *idx)
+static void json_stream_release(json_parser_t *parser);
+
+// Fallback for inputs that cannot be mapped: pipes, special files or platforms without mmap
+static int json_read_file(const char *path, char **contents, size_t *contents_size)
 {
-    if(parser->pos + 4 > parser->length)
+    FILE *file = fopen(path, "rb");
+
+    if(!file)
     {
         return -1;
     }
 
-    unsigned int codepoint = 0;
+    size_t cap = 0;
+    size_t size = 0;
+    char *data = NULL;
+    int failed = 0;
 
-    for(int i = 0; i < 4; i++)
+    for(;;)
     {
-        char c = parser->json[parser->pos++];
-        codepoint <<= 4;
-
-        if(c >= '0' && c <= '9')
+        if(size == cap)
         {
-            codepoint += c - '0';
-        }
-        else if(c >= 'a' && c <= 'f')
-        {
-            codepoint += c - 'a' + 10;
-        }
-        else if(c >= 'A' && c <= 'F')
-        {
-            codepoint += c - 'A' + 10;
+            char *grown = JSON_REALLOC(data, cap ? cap * 2 : 65536);
+
+            if(!grown)
+            {
+                failed = 1;
+                break;
+            }
+
+            data = grown;
+            cap = cap ? cap * 2 : 65536;
         }
-        else
+
+        size_t got = fread(data + size, 1, cap - size, file);
+        size += got;
+
+        if(got == 0)
         {
-            return -1;
+            failed = ferror(file);
+            break;
         }
     }
 
-    // Check if it's a high surrogate (D800-DBFF)
-    if(codepoint >= 0xD800 && codepoint <= 0xDBFF)
+    fclose(file);
+
+    if(failed)
     {
+        JSON_FREE(data);
+        return -1;
+    }
+
+    *contents = data;
+    *contents_size = size;
+    return 0;
+}
+
+#ifdef JSON_HAVE_MMAP
+static int json_map_file(const char *path, char **contents, size_t *contents_size)
+{
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    struct stat st;
+    void *map = MAP_FAILED;
+
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX)
+    {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    if(map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    // One front-to-back pass: read ahead aggressively and drop pages behind the parser.
+    // The advice is only declared when the build exposes POSIX or BSD extensions.
+#if defined(POSIX_MADV_SEQUENTIAL)
+    posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+#elif defined(MADV_SEQUENTIAL)
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+    *contents = map;
+    *contents_size = (size_t)st.st_size;
+    return 0;
+}
+#endif
+
+// Maps `path` read-only, or reads it into the heap when it cannot be mapped
+static int json_load_file(const char *path, char **contents, size_t *size, int *mapped)
+{
+#ifdef JSON_HAVE_MMAP
+    *mapped = json_map_file(path, contents, size) == 0;
+
+    if(*mapped)
+    {
+        return 0;
+    }
+#else
+    *mapped = 0;
+#endif
+    return json_read_file(path, contents, size);
+}
+
+static void json_unload_file(char *contents, size_t size, int mapped)
+{
+#ifdef JSON_HAVE_MMAP
+    if(mapped)
+    {
+        munmap(contents, size);
+        return;
+    }
+#else
+    (void)size;
+    (void)mapped;
+#endif
+    JSON_FREE(contents);
+}
+
+json_error_t json_parser_init_file(json_parser_t *parser, const char *path)
+{
+    json_parser_init(parser, NULL, 0);
+
+    if(parser->error != JSON_ERROR_NONE)
+    {
+        return parser->error;
+    }
+
+    if(json_load_file(path, &parser->file, &parser->file_size, &parser->file_mapped))
+    {
+        parser->error = JSON_ERROR_IO;
+        return parser->error;
+    }
+
+    parser->json = parser->file;
+    parser->length = parser->file_size;
+    return JSON_ERROR_NONE;
+}
+
+static void json_release_file(json_parser_t *parser)
+{
+    json_unload_file(parser->file, parser->file_size, parser->file_mapped);
+    parser->file = NULL;
+    parser->file_size = 0;
+    parser->file_mapped = 0;
+}
+
+// String interning. Every canonical string is stored as its hash and length (two uint32_t)
+// followed by the bytes and a NUL, 4-byte aligned, in blocks that are only freed together.
+#define JSON_INTERN_BLOCK_SIZE 4096
+#define JSON_INTERN_HEADER (2 * sizeof(uint32_t))
+
+struct json_intern_block
+{
+    struct json_intern_block *next;
+    size_t used;
+    size_t size;
+    uint32_t data[];
+};
+
+static uint32_t json_hash_key(const char *key, size_t length);
+
+static uint32_t json_intern_hash(const char *interned)
+{
+    uint32_t hash;
+    memcpy(&hash, interned - JSON_INTERN_HEADER, sizeof(hash));
+    return hash;
+}
+
+static size_t json_intern_length(const char *interned)
+{
+    uint32_t length;
+    memcpy(&length, interned - sizeof(uint32_t), sizeof(length));
+    return length;
+}
+
+// Copied strings are owned by their token; raw ones belong to the input, interned ones to a table
+static int json_token_owns_string(const json_token_t *token)
+{
+    return token->type == JSON_TOKEN_STRING && !(token->flags & (JSON_TOKEN_FLAG_RAW | JSON_TOKEN_FLAG_INTERNED));
+}
+
+void json_intern_init(json_intern_t *table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+void json_intern_free(json_intern_t *table)
+{
+    while(table->blocks)
+    {
+        struct json_intern_block *next = table->blocks->next;
+        JSON_FREE(table->blocks);
+        table->blocks = next;
+    }
+
+    JSON_FREE(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+static const char *json_intern_lookup(const json_intern_t *table, const char *string, size_t length, uint32_t hash, size_t *slot)
+{
+    size_t mask = table->capacity - 1;
+    *slot = hash & mask;
+
+    while(table->slots[*slot])
+    {
+        const char *candidate = table->slots[*slot];
+
+        if(json_intern_hash(candidate) == hash && json_intern_length(candidate) == length && memcmp(candidate, string, length) == 0)
+        {
+            return candidate;
+        }
+
+        *slot = (*slot + 1) & mask;
+    }
+
+    return NULL;
+}
+
+const char *json_intern_find(const json_intern_t *table, const char *string, size_t length)
+{
+    size_t slot;
+    return table->count ? json_intern_lookup(table, string, length, json_hash_key(string, length), &slot) : NULL;
+}
+
+// Keeps the load factor at or below one half
+static int json_intern_grow(json_intern_t *table)
+{
+    size_t capacity = table->capacity ? table->capacity * 2 : 64;
+    char **slots = JSON_CALLOC(capacity, sizeof(char *));
+
+    if(!slots)
+    {
+        return -1;
+    }
+
+    for(size_t i = 0; i < table->capacity; i++)
+    {
+        if(table->slots[i])
+        {
+            size_t slot = json_intern_hash(table->slots[i]) & (capacity - 1);
+
+            while(slots[slot])
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            slots[slot] = table->slots[i];
+        }
+    }
+
+    JSON_FREE(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    return 0;
+}
+
+const char *json_intern(json_intern_t *table, const char *string, size_t length)
+{
+    if(length > UINT32_MAX || ((table->count + 1) * 2 > table->capacity && json_intern_grow(table)))
+    {
+        return NULL;
+    }
+
+    uint32_t hash = json_hash_key(string, length);
+    size_t slot;
+    const char *found = json_intern_lookup(table, string, length, hash, &slot);
+
+    if(found)
+    {
+        return found;
+    }
+
+    size_t words = (JSON_INTERN_HEADER + length + 1 + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    struct json_intern_block *block = table->blocks;
+
+    if(!block || block->size - block->used < words)
+    {
+        // Strings longer than a block get a block of their own
+        size_t size = words > JSON_INTERN_BLOCK_SIZE / sizeof(uint32_t) ? words : JSON_INTERN_BLOCK_SIZE / sizeof(uint32_t);
+        block = JSON_MALLOC(sizeof(struct json_intern_block) + size * sizeof(uint32_t));
+
+        if(!block)
+        {
+            return NULL;
+        }
+
+        block->next = table->blocks;
+        block->used = 0;
+        block->size = size;
+        table->blocks = block;
+    }
+
+    uint32_t *entry = block->data + block->used;
+    block->used += words;
+    entry[0] = hash;
+    entry[1] = (uint32_t)length;
+    char *interned = (char *)(entry + 2);
+    memcpy(interned, string, length);
+    interned[length] = '\0';
+    table->slots[slot] = interned;
+    table->count++;
+    return interned;
+}
+
+// Points a key token at the canonical copy of `string`, from the shared table when it has
+// one and from the parser's own table otherwise
+static int json_intern_token(json_parser_t *parser, json_token_t *token, const char *string, size_t length)
+{
+    const char *interned = parser->intern_shared ? json_intern_find(parser->intern_shared, string, length) : NULL;
+
+    if(!interned && !parser->intern)
+    {
+        parser->intern = JSON_MALLOC(sizeof(json_intern_t));
+
+        if(parser->intern)
+        {
+            json_intern_init(parser->intern);
+            parser->intern_owned = 1;
+        }
+    }
+
+    if(!interned && parser->intern)
+    {
+        interned = json_intern(parser->intern, string, length);
+    }
+
+    if(!interned)
+    {
+        json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+        return -1;
+    }
+
+    token->value.string = (char *)interned;
+    token->flags = JSON_TOKEN_FLAG_INTERNED;
+    return 0;
+}
+
+// Grows the scratch buffer used to decode escaped strings that are not kept
+static char *json_reserve_scratch(json_parser_t *parser, size_t size)
+{
+    if(parser->scratch_cap < size)
+    {
+        char *scratch = JSON_REALLOC(parser->scratch, size);
+
+        if(!scratch)
+        {
+            json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+            return NULL;
+        }
+
+        parser->scratch = scratch;
+        parser->scratch_cap = size;
+    }
+
+    return parser->scratch;
+}
+
+static void json_free_strings(json_parser_t *parser)
+{
+    // Zero-copy strings are not owned, so the walk is skipped when nothing was copied
+    for(size_t i = 0; (parser->string_count || parser->index_count) && i < parser->token_count; i++)
+    {
+        if(json_token_owns_string(&parser->tokens[i]))
+        {
+            json_free_string(parser->tokens[i].value.string);
+        }
+        else if(parser->tokens[i].type == JSON_TOKEN_OBJECT)
+        {
+            JSON_FREE(parser->tokens[i].value.index);
+        }
+    }
+
+    parser->string_count = 0;
+    parser->index_count = 0;
+}
+
+// Points the parser at new input; tokens already parsed are left in place
+static void json_parser_rewind(json_parser_t *parser, const char *json, size_t length)
+{
+    parser->json = json;
+    parser->length = length;
+    parser->pos = 0;
+    parser->error = JSON_ERROR_NONE;
+    parser->depth = 0;
+    parser->structural_count = 0;
+    parser->use_index = 0;
+}
+
+void json_parser_reset(json_parser_t *parser, const char *json, size_t length)
+{
+    json_free_strings(parser);
+    json_stream_release(parser);
+
+    if(parser->arena)
+    {
+        // Strings and the structural index are rewound, the token array keeps its in-place capacity
+        parser->arena->high = parser->arena_high;
+        parser->structurals = NULL;
+        parser->structural_cap = 0;
+        parser->frames = NULL;
+        parser->frame_cap = 0;
+    }
+
+    parser->token_count = 0;
+    json_parser_rewind(parser, json, length);
+}
+
+void json_parser_free(json_parser_t *parser)
+{
+    if(parser->borrowed)
+    {
+        parser->tokens = NULL;
+        parser->token_count = 0;
+    }
+
+    json_free_strings(parser);
+    json_stream_release(parser);
+
+    if(parser->arena)
+    {
+        // Everything this parser took from the arena is released by rewinding it
+        parser->arena->low = parser->arena_low;
+        parser->arena->high = parser->arena_high;
+    }
+    else
+    {
+        JSON_FREE(parser->tokens);
+        JSON_FREE(parser->structurals);
+        JSON_FREE(parser->frames);
+    }
+
+    JSON_FREE(parser->scratch);
+    json_release_file(parser);
+
+    if(parser->intern_owned)
+    {
+        json_intern_free(parser->intern);
+        JSON_FREE(parser->intern);
+    }
+
+    memset(parser, 0, sizeof(*parser));
+}
+
+const char *json_error_string(json_error_t error)
+{
+    switch(error)
+    {
+        case JSON_ERROR_NONE:
+            return "No error";
+
+        case JSON_ERROR_INVALID_TOKEN:
+            return "Invalid token";
+
+        case JSON_ERROR_UNEXPECTED_CHAR:
+            return "Unexpected character";
+
+        case JSON_ERROR_MAX_TOKENS:
+            return "Max tokens exceeded";
+
+        case JSON_ERROR_STRING_TOO_LONG:
+            return "String too long";
+
+        case JSON_ERROR_INVALID_ESCAPE:
+            return "Invalid escape sequence";
+
+        case JSON_ERROR_INVALID_UNICODE:
+            return "Invalid Unicode escape";
+
+        case JSON_ERROR_NESTING_DEPTH:
+            return "Nesting depth exceeded";
+
+        case JSON_ERROR_INVALID_NUMBER:
+            return "Invalid number format";
+
+        case JSON_ERROR_TRAILING_CHARS:
+            return "Trailing characters";
+
+        case JSON_ERROR_ALLOCATION_FAILED:
+            return "Memory allocation failed";
+
+        case JSON_ERROR_EMPTY_INPUT:
+            return "Empty input";
+
+        case JSON_ERROR_NEED_MORE:
+            return "More input needed";
+
+        case JSON_ERROR_ABORTED:
+            return "Parsing stopped by callback";
+
+        case JSON_ERROR_IO:
+            return "Cannot read file";
+
+        case JSON_ERROR_BUFFER_FULL:
+            return "Output buffer full";
+
+        case JSON_ERROR_TYPE_MISMATCH:
+            return "Value does not match the field type";
+
+        case JSON_ERROR_CORRUPT:
+            return "Binary data is damaged or from another version";
+
+        case JSON_ERROR_STALE:
+            return "Binary data is older than its source";
+
+        case JSON_ERROR_TOO_LARGE:
+            return "Document too large to freeze";
+
+        default:
+            return "Unknown error";
+    }
+}
+
+const json_token_t *json_get_tokens(const json_parser_t *parser, size_t *count)
+{
+    if(count)
+    {
+        *count = parser->token_count;
+    }
+
+    return parser->tokens;
+}
+
+static size_t json_decode_string(const char *src, size_t length, char *dst);
+
+const char *json_token_string(json_parser_t *parser, const json_token_t *token, size_t *length)
+{
+    if(token->type != JSON_TOKEN_STRING)
+    {
+        return NULL;
+    }
+
+    json_token_t *tok = &parser->tokens[token - parser->tokens];
+    size_t decoded_length;
+
+    if(tok->flags & JSON_TOKEN_FLAG_ESCAPED)
+    {
+        // Escaped zero-copy strings are decoded on first access. The copy then belongs to the
+        // token like any other copied string, decoded length included.
+        char *buffer = json_alloc_string(parser, tok->end - tok->start);
+
+        if(!buffer)
+        {
+            json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+            return NULL;
+        }
+
+        decoded_length = json_decode_string(parser->json + tok->start, tok->end - tok->start, buffer);
+        json_string_set_length(buffer, decoded_length);
+        tok->value.string = buffer;
+        tok->flags = 0;
+    }
+    else if(tok->flags & JSON_TOKEN_FLAG_RAW)
+    {
+        decoded_length = tok->end - tok->start;
+    }
+    else if(tok->flags & JSON_TOKEN_FLAG_INTERNED)
+    {
+        decoded_length = json_intern_length(tok->value.string);
+    }
+    else
+    {
+        decoded_length = json_string_length(tok->value.string);
+    }
+
+    if(length)
+    {
+        *length = decoded_length;
+    }
+
+    return tok->value.string;
+}
+
+/*
+    Stage 1: structural index
+
+    The input is classified 64 bytes at a time into quote, backslash, operator and whitespace
+    bitmasks. Escaped quotes are removed, a prefix XOR turns the remaining quotes into an
+    in-string mask, and the positions of every operator, quote and scalar start outside strings
+    are flattened into parser->structurals. The recursive descent stage then skips whitespace
+    and finds closing quotes by reading the index instead of scanning byte by byte.
+*/
+
+#if !defined(JSON_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define JSON_STAGE1_SSE2 1
+#define JSON_STAGE1_AVX2 1
+#include <immintrin.h>
+#elif !defined(JSON_NO_SIMD) && defined(_MSC_VER) && defined(_M_X64)
+#define JSON_STAGE1_SSE2 1
+#include <intrin.h>
+#elif !defined(JSON_NO_SIMD) && defined(__aarch64__)
+#define JSON_STAGE1_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct
+{
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t whitespace;
+} json_block_masks_t;
+
+typedef void (*json_classify_fn)(const unsigned char *block, json_block_masks_t *masks);
+
+static int json_ctz64(uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#else
+    int n = 0;
+
+    while(!(x & 1))
+    {
+        x >>= 1;
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+static void json_classify_scalar(const unsigned char *block, json_block_masks_t *masks)
+{
+    memset(masks, 0, sizeof(*masks));
+
+    for(int i = 0; i < 64; i++)
+    {
+        uint64_t bit = (uint64_t)1 << i;
+
+        unsigned char cls = json_char_class[block[i]];
+        masks->quote |= block[i] == '"' ? bit : 0;
+        masks->backslash |= block[i] == '\\' ? bit : 0;
+        masks->op |= cls & JSON_CHAR_STRUCTURAL ? bit : 0;
+        masks->whitespace |= cls & JSON_CHAR_SPACE ? bit : 0;
+    }
+}
+
+#ifdef JSON_STAGE1_SSE2
+static void json_classify_sse2(const unsigned char *block, json_block_masks_t *masks)
+{
+    memset(masks, 0, sizeof(*masks));
+
+    for(int k = 0; k < 4; k++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + 16 * k));
+        // '[' and ']' fold onto '{' and '}' once bit 5 is set
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                                               _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                                               _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                               _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                               _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        int shift = 16 * k;
+        masks->quote |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << shift;
+        masks->backslash |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << shift;
+        masks->op |= (uint64_t)(unsigned int)_mm_movemask_epi8(op) << shift;
+        masks->whitespace |= (uint64_t)(unsigned int)_mm_movemask_epi8(ws) << shift;
+    }
+}
+#endif
+
+#ifdef JSON_STAGE1_AVX2
+__attribute__((target("avx2")))
+static void json_classify_avx2(const unsigned char *block, json_block_masks_t *masks)
+{
+    memset(masks, 0, sizeof(*masks));
+
+    for(int k = 0; k < 2; k++)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + 32 * k));
+        __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                                     _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')),
+                                             _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                             _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        int shift = 32 * k;
+        masks->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << shift;
+        masks->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << shift;
+        masks->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+        masks->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << shift;
+    }
+}
+#endif
+
+#ifdef JSON_STAGE1_NEON
+static uint64_t json_neon_movemask(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3)
+{
+    const uint8x16_t bits = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t sum0 = vpaddq_u8(vandq_u8(m0, bits), vandq_u8(m1, bits));
+    uint8x16_t sum1 = vpaddq_u8(vandq_u8(m2, bits), vandq_u8(m3, bits));
+    sum0 = vpaddq_u8(sum0, sum1);
+    sum0 = vpaddq_u8(sum0, sum0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+
+static void json_classify_neon(const unsigned char *block, json_block_masks_t *masks)
+{
+    uint8x16_t quote[4], backslash[4], op[4], ws[4];
+
+    for(int k = 0; k < 4; k++)
+    {
+        uint8x16_t v = vld1q_u8(block + 16 * k);
+        uint8x16_t folded = vorrq_u8(v, vdupq_n_u8(0x20));
+        quote[k] = vceqq_u8(v, vdupq_n_u8('"'));
+        backslash[k] = vceqq_u8(v, vdupq_n_u8('\\'));
+        op[k] = vorrq_u8(vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')), vceqq_u8(folded, vdupq_n_u8('}'))),
+                         vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')), vceqq_u8(v, vdupq_n_u8(','))));
+        ws[k] = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+                         vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))));
+    }
+
+    masks->quote = json_neon_movemask(quote[0], quote[1], quote[2], quote[3]);
+    masks->backslash = json_neon_movemask(backslash[0], backslash[1], backslash[2], backslash[3]);
+    masks->op = json_neon_movemask(op[0], op[1], op[2], op[3]);
+    masks->whitespace = json_neon_movemask(ws[0], ws[1], ws[2], ws[3]);
+}
+#endif
+
+static json_classify_fn json_select_classifier(const char **name)
+{
+#ifdef JSON_STAGE1_AVX2
+
+    if(__builtin_cpu_supports("avx2"))
+    {
+        *name = "avx2";
+        return json_classify_avx2;
+    }
+
+#endif
+#if defined(JSON_STAGE1_SSE2)
+    *name = "sse2";
+    return json_classify_sse2;
+#elif defined(JSON_STAGE1_NEON)
+    *name = "neon";
+    return json_classify_neon;
+#else
+    *name = "scalar";
+    return json_classify_scalar;
+#endif
+}
+
+const char *json_structural_backend(void)
+{
+    const char *name;
+    json_select_classifier(&name);
+    return name;
+}
+
+// Marks bytes preceded by an odd-length run of backslashes, carrying runs across blocks
+static uint64_t json_find_escaped(uint64_t backslash, uint64_t *prev_odd_run)
+{
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    const uint64_t odd_bits = ~even_bits;
+    uint64_t start_edges = backslash & ~(backslash << 1);
+    uint64_t even_start_mask = even_bits ^ *prev_odd_run;
+    uint64_t even_starts = start_edges & even_start_mask;
+    uint64_t odd_starts = start_edges & ~even_start_mask;
+    uint64_t even_carries = backslash + even_starts;
+    uint64_t odd_carries = backslash + odd_starts;
+    uint64_t ends_odd_run = odd_carries < backslash;
+    odd_carries |= *prev_odd_run;
+    *prev_odd_run = ends_odd_run;
+    uint64_t even_carry_ends = even_carries & ~backslash;
+    uint64_t odd_carry_ends = odd_carries & ~backslash;
+    return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+}
+
+static uint64_t json_prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Builds parser->structurals; returns -1 when the index cannot be used for this input
+static int json_build_structural_index(json_parser_t *parser)
+{
+    if(parser->length >= UINT32_MAX)
+    {
+        return -1;
+    }
+
+    // Worst case every byte is indexed; one extra slot keeps the lookups branch-free at the end
+    size_t needed = parser->length + 1;
+
+    if(parser->arena)
+    {
+        parser->structurals = json_arena_alloc_high(parser->arena, needed * sizeof(uint32_t) + sizeof(uint32_t));
+
+        if(!parser->structurals)
+        {
+            return -1;
+        }
+
+        // High allocations are byte aligned, so round down to a uint32_t boundary
+        parser->structurals = (uint32_t *)((uintptr_t)parser->structurals & ~(uintptr_t)(sizeof(uint32_t) - 1)) + 1;
+        parser->structural_cap = needed;
+    }
+    else if(needed > parser->structural_cap)
+    {
+        uint32_t *index = JSON_REALLOC(parser->structurals, needed * sizeof(uint32_t));
+
+        if(!index)
+        {
+            return -1;
+        }
+
+        parser->structurals = index;
+        parser->structural_cap = needed;
+    }
+
+    const char *name;
+    json_classify_fn classify = json_select_classifier(&name);
+    const unsigned char *input = (const unsigned char *)parser->json;
+    uint32_t *out = parser->structurals;
+    uint64_t prev_odd_run = 0;
+    uint64_t prev_in_string = 0;
+    uint64_t prev_scalar = 0;
+
+    for(size_t base = 0; base < parser->length; base += 64)
+    {
+        json_block_masks_t masks;
+        size_t remaining = parser->length - base;
+
+        if(remaining >= 64)
+        {
+            classify(input + base, &masks);
+        }
+        else
+        {
+            // Pad the tail with spaces so it classifies as insignificant whitespace
+            unsigned char tail[64];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, input + base, remaining);
+            json_classify_scalar(tail, &masks);
+        }
+
+        uint64_t escaped = json_find_escaped(masks.backslash, &prev_odd_run);
+        uint64_t quotes = masks.quote & ~escaped;
+        uint64_t in_string = json_prefix_xor(quotes) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+        uint64_t scalar = ~(masks.op | masks.whitespace | quotes);
+        uint64_t scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+        prev_scalar = scalar >> 63;
+        uint64_t bits = ((masks.op | scalar_start) & ~in_string) | quotes;
+
+        while(bits)
+        {
+            *out++ = (uint32_t)(base + json_ctz64(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    parser->structural_count = (size_t)(out - parser->structurals);
+    parser->structural_cursor = 0;
+    return 0;
+}
+
+// Returns the first indexed position at or after pos, or the input length
+static size_t json_next_structural(json_parser_t *parser, size_t pos)
+{
+    while(parser->structural_cursor < parser->structural_count && parser->structurals[parser->structural_cursor] < pos)
+    {
+        parser->structural_cursor++;
+    }
+
+    return parser->structural_cursor < parser->structural_count ? parser->structurals[parser->structural_cursor] : parser->length;
+}
+
+static void json_skip_whitespace(json_parser_t *parser)
+{
+    if(parser->use_index && parser->pos < parser->length && JSON_IS_WHITESPACE(parser->json[parser->pos]))
+    {
+        // The first non-whitespace byte after a whitespace run is always indexed
+        parser->pos = json_next_structural(parser, parser->pos);
+        return;
+    }
+
+    while(parser->pos < parser->length && JSON_IS_WHITESPACE(parser->json[parser->pos]))
+    {
+        parser->pos++;
+    }
+}
+
+// Ensures room for at least `count` tokens without re-growing during the parse
+static int json_reserve_tokens(json_parser_t *parser, size_t count)
+{
+    if(count <= parser->token_cap)
+    {
+        return 0;
+    }
+
+    json_token_t *new_tokens;
+
+    if(parser->arena)
+    {
+        json_arena_t *arena = parser->arena;
+        size_t extra = (count - parser->token_cap) * sizeof(json_token_t);
+
+        if(parser->tokens && (char *)(parser->tokens + parser->token_cap) == arena->base + arena->low)
+        {
+            // The token array is the newest low allocation, so it can be extended in place
+            if(arena->high - arena->low < extra)
+            {
+                json_set_error(parser, JSON_ERROR_MAX_TOKENS);
+                return -1;
+            }
+
+            arena->low += extra;
+            parser->token_cap = count;
+            return 0;
+        }
+
+        new_tokens = json_arena_alloc_low(arena, count * sizeof(json_token_t));
+
+        if(!new_tokens)
+        {
+            json_set_error(parser, JSON_ERROR_MAX_TOKENS);
+            return -1;
+        }
+
+        if(parser->token_count)
+        {
+            memcpy(new_tokens, parser->tokens, parser->token_count * sizeof(json_token_t));
+        }
+    }
+    else
+    {
+        new_tokens = JSON_REALLOC(parser->tokens, count * sizeof(json_token_t));
+
+        if(!new_tokens)
+        {
+            json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+            return -1;
+        }
+    }
+
+    parser->tokens = new_tokens;
+    parser->token_cap = count;
+    return 0;
+}
+
+static int json_add_token(json_parser_t *parser, json_token_type_t type)
+{
+    if(parser->token_count >= parser->token_cap)
+    {
+#ifdef JSON_FIXED_TOKENS
+        json_set_error(parser, JSON_ERROR_MAX_TOKENS);
+        return -1;
+#else
+        // Arena arrays grow in place one slot at a time, heap arrays double
+        size_t new_cap = parser->arena ? parser->token_cap + 1 :
+                         parser->token_cap ? parser->token_cap * 2 : JSON_DEFAULT_MAX_TOKENS;
+
+        // Navigation links are stored as unsigned int indices
+        if(parser->token_count >= JSON_TOKEN_NO_PARENT)
+        {
+            json_set_error(parser, JSON_ERROR_MAX_TOKENS);
+            return -1;
+        }
+
+        if(json_reserve_tokens(parser, new_cap))
+        {
+            return -1;
+        }
+
+        JSON_STATS_ADD(parser, token_reallocs, 1);
+#endif
+    }
+
+    JSON_STATS_ADD(parser, tokens, 1);
+    json_token_t *token = &parser->tokens[parser->token_count++];
+    memset(token, 0, sizeof(*token));
+    token->type = type;
+    token->start = parser->pos;
+    token->end = parser->pos;
+    token->next = (unsigned int)parser->token_count;
+#ifdef JSON_PARENT_LINKS
+    token->parent = parser->parent;
+#endif
+    return 0;
+}
+
+size_t json_count_tokens(const char *json, size_t length)
+{
+    // Token starts are '{', '[', opening quotes and the first byte of each scalar run;
+    // the class table folds whitespace and structural bytes into one lookup per byte
+    size_t count = 0;
+    size_t i = 0;
+    int in_scalar = 0;
+
+    while(i < length)
+    {
+        unsigned char c = (unsigned char)json[i++];
+
+        if(c == '"')
+        {
+            // Jump between quotes with memchr, skipping quotes preceded by an odd run of backslashes
+            count++;
+            in_scalar = 0;
+
+            for(;;)
+            {
+                const char *quote = memchr(json + i, '"', length - i);
+
+                if(!quote)
+                {
+                    return count;
+                }
+
+                size_t backslashes = 0;
+
+                while(quote - backslashes > json + i && quote[-1 - (ptrdiff_t)backslashes] == '\\')
+                {
+                    backslashes++;
+                }
+
+                i = (size_t)(quote - json) + 1;
+
+                if(!(backslashes & 1))
+                {
+                    break;
+                }
+            }
+
+            continue;
+        }
+
+        unsigned char cls = json_char_class[c] & (JSON_CHAR_SPACE | JSON_CHAR_STRUCTURAL);
+        count += (cls == JSON_CHAR_OPEN) | (!cls & !in_scalar);
+        in_scalar = !cls;
+    }
+
+    return count;
+}
+
+json_error_t json_parser_reserve(json_parser_t *parser, size_t count)
+{
+    json_error_t saved = parser->error;
+    parser->error = JSON_ERROR_NONE;
+
+    if(json_reserve_tokens(parser, count))
+    {
+        json_error_t error = parser->error;
+        parser->error = saved;
+        return error;
+    }
+
+    parser->error = saved;
+    return JSON_ERROR_NONE;
+}
+
+#ifndef JSON_NO_UNICODE_ESCAPES
+static int json_hex_digit(char c)
+{
+    if(!JSON_IS_CHAR(c, JSON_CHAR_HEX))
+    {
+        return -1;
+    }
+
+    // Setting bit 5 lowercases the letters and leaves the digits unchanged
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+static int json_read_hex4(const char *p, unsigned int *value)
+{
+    *value = 0;
+
+    for(int i = 0; i < 4; i++)
+    {
+        int digit = json_hex_digit(p[i]);
+
+        if(digit < 0)
+        {
+            return -1;
+        }
+
+        *value = (*value << 4) | (unsigned int)digit;
+    }
+
+    return 0;
+}
+
+// Decodes the hex digits following "\u" (and a trailing low surrogate escape if needed).
+// Returns the number of input bytes consumed, or -1 on a malformed escape.
+static int json_parse_unicode_escape(const char *p, size_t available, unsigned int *codepoint)
+{
+    if(available < 4 || json_read_hex4(p, codepoint))
+    {
+        return -1;
+    }
+
+    // Check if it's a high surrogate (D800-DBFF)
+    if(*codepoint >= 0xD800 && *codepoint <= 0xDBFF)
+    {
+        unsigned int low_surrogate;
+
         // Expect a low surrogate (DC00-DFFF) next
-        if(parser->pos + 6 > parser->length ||
-                parser->json[parser->pos] != '\\' ||
-                parser->json[parser->pos + 1] != 'u')
+        if(available < 10 || p[4] != '\\' || p[5] != 'u' || json_read_hex4(p + 6, &low_surrogate))
+        {
+            return -1; // Missing low surrogate
+        }
+
+        if(low_surrogate < 0xDC00 || low_surrogate > 0xDFFF)
+        {
+            return -1; // Invalid low surrogate
+        }
+
+        // Combine into 32-bit codepoint
+        *codepoint = 0x10000 + ((*codepoint - 0xD800) << 10) + (low_surrogate - 0xDC00);
+        return 10;
+    }
+    else if(*codepoint >= 0xDC00 && *codepoint <= 0xDFFF)
+    {
+        return -1; // Unpaired low surrogate
+    }
+
+    return 4;
+}
+
+static size_t json_utf8_length(unsigned int codepoint)
+{
+    if(codepoint <= 0x7F)
+    {
+        return 1;
+    }
+    else if(codepoint <= 0x7FF)
+    {
+        return 2;
+    }
+    else if(codepoint <= 0xFFFF)
+    {
+        return 3;
+    }
+
+    return 4;
+}
+
+static size_t json_utf8_encode(unsigned int codepoint, char *buf)
+{
+    if(codepoint <= 0x7F)
+    {
+        buf[0] = codepoint;
+        return 1;
+    }
+    else if(codepoint <= 0x7FF)
+    {
+        buf[0] = 0xC0 | (codepoint >> 6);
+        buf[1] = 0x80 | (codepoint & 0x3F);
+        return 2;
+    }
+    else if(codepoint <= 0xFFFF)
+    {
+        buf[0] = 0xE0 | (codepoint >> 12);
+        buf[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+        buf[2] = 0x80 | (codepoint & 0x3F);
+        return 3;
+    }
+
+    buf[0] = 0xF0 | (codepoint >> 18);
+    buf[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+    buf[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+    buf[3] = 0x80 | (codepoint & 0x3F);
+    return 4;
+}
+#endif
+
+// Returns the first byte in [p, end) that needs attention inside a string: a quote,
+// a backslash or an unescaped control character. Returns end when the run is clean.
+static const char *json_find_string_special(const char *p, const char *end)
+{
+#if defined(JSON_STAGE1_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+
+    while(end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                    _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        int mask = _mm_movemask_epi8(hits);
+
+        if(mask)
+        {
+            return p + json_ctz64((uint64_t)(unsigned int)mask);
+        }
+
+        p += 16;
+    }
+
+#elif defined(JSON_STAGE1_NEON)
+
+    while(end - p >= 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t *)p);
+        uint8x16_t hits = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))),
+                                   vcleq_u8(v, vdupq_n_u8(0x1F)));
+
+        if(vmaxvq_u8(hits))
+        {
+            break; // The exact byte is located by the scalar tail below
+        }
+
+        p += 16;
+    }
+
+#else
+    // SWAR: test 8 bytes per step for '"', '\\' or a byte below 0x20
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    while(end - p >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        uint64_t q = word ^ (ones * '"');
+        uint64_t b = word ^ (ones * '\\');
+        uint64_t hits = ((q - ones) & ~q) | ((b - ones) & ~b) | ((word - ones * 0x20) & ~word);
+
+        if(hits & highs)
+        {
+            break; // The exact byte is located by the scalar tail below
+        }
+
+        p += 8;
+    }
+
+#endif
+
+    while(p < end && !JSON_IS_CHAR(*p, JSON_CHAR_STRING_END))
+    {
+        p++;
+    }
+
+    return p;
+}
+
+// Returns the first byte in [p, end) that is not whitespace, 16 bytes per step where SIMD
+// is available
+static const char *json_skip_ascii_whitespace(const char *p, const char *end)
+{
+#if defined(JSON_STAGE1_SSE2)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    while(end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, cr)));
+        int mask = ~_mm_movemask_epi8(ws) & 0xFFFF;
+
+        if(mask)
+        {
+            return p + json_ctz64((uint64_t)(unsigned int)mask);
+        }
+
+        p += 16;
+    }
+
+#endif
+
+    while(p < end && JSON_IS_WHITESPACE(*p))
+    {
+        p++;
+    }
+
+    return p;
+}
+
+// Validates the string starting at the opening quote and advances past the closing quote.
+// Reports the decoded length and whether any escape sequence was seen.
+static int json_scan_string(json_parser_t *parser, size_t *decoded_length, int *escaped)
+{
+    size_t idx = 0;
+
+    if(parser->use_index)
+    {
+        // The closing quote is the next indexed position after the opening one
+        size_t open = json_next_structural(parser, parser->pos);
+        size_t close = parser->structural_cursor + 1 < parser->structural_count ? parser->structurals[parser->structural_cursor + 1] : parser->length;
+
+        if(open == parser->pos && close < parser->length && parser->json[close] == '"' &&
+                json_find_string_special(parser->json + open + 1, parser->json + close) == parser->json + close)
+        {
+            if(close - open - 1 > parser->max_string - 1)
+            {
+                json_set_error(parser, JSON_ERROR_STRING_TOO_LONG);
+                return -1;
+            }
+
+            parser->structural_cursor += 2;
+            parser->pos = close + 1;
+            *decoded_length = close - open - 1;
+            return 0;
+        }
+    }
+
+    parser->pos++; // Skip opening quote
+
+    while(parser->pos < parser->length)
+    {
+        // Skip the run of ordinary bytes up to the next quote, escape or control character
+        const char *run = parser->json + parser->pos;
+        size_t run_length = (size_t)(json_find_string_special(run, parser->json + parser->length) - run);
+
+        if(idx + run_length > parser->max_string - 1)
+        {
+            json_set_error(parser, JSON_ERROR_STRING_TOO_LONG);
+            return -1;
+        }
+
+        idx += run_length;
+        parser->pos += run_length;
+
+        if(parser->pos >= parser->length)
+        {
+            break;
+        }
+
+        char c = parser->json[parser->pos++];
+
+        if(c == '"')
+        {
+            *decoded_length = idx;
+            return 0;
+        }
+
+        if((unsigned char)c < 0x20)
+        {
+            // Control characters must be escaped inside strings
+            parser->pos--;
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            return -1;
+        }
+
+        if(c == '\\')
+        {
+            if(parser->pos >= parser->length)
+            {
+                break;
+            }
+
+            *escaped = 1;
+            JSON_STATS_ADD(parser, escapes, 1);
+            c = parser->json[parser->pos++];
+
+            switch(c)
+            {
+                case '"':
+                case '\\':
+                case '/':
+                case 'b':
+                case 'f':
+                case 'n':
+                case 'r':
+                case 't':
+                    break;
+
+                case 'u':
+                {
+#ifdef JSON_NO_UNICODE_ESCAPES
+                    json_set_error(parser, JSON_ERROR_INVALID_UNICODE);
+                    return -1;
+#else
+                    unsigned int codepoint;
+                    int consumed = json_parse_unicode_escape(parser->json + parser->pos, parser->length - parser->pos, &codepoint);
+
+                    if(consumed < 0)
+                    {
+                        json_set_error(parser, JSON_ERROR_INVALID_UNICODE);
+                        return -1;
+                    }
+
+                    parser->pos += consumed;
+                    idx += json_utf8_length(codepoint);
+
+                    if(idx > parser->max_string - 1)
+                    {
+                        json_set_error(parser, JSON_ERROR_STRING_TOO_LONG);
+                        return -1;
+                    }
+
+                    continue;
+#endif
+                }
+
+                default:
+                    json_set_error(parser, JSON_ERROR_INVALID_ESCAPE);
+                    return -1;
+            }
+        }
+
+        if(idx >= parser->max_string - 1)
+        {
+            json_set_error(parser, JSON_ERROR_STRING_TOO_LONG);
+            return -1;
+        }
+
+        idx++;
+    }
+
+    json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+    return -1;
+}
+
+// Decodes an already validated string body into dst, which must hold length + 1 bytes
+static size_t json_decode_string(const char *src, size_t length, char *dst)
+{
+    size_t idx = 0;
+    size_t i = 0;
+
+    while(i < length)
+    {
+        // Copy everything up to the next escape in one go
+        const char *escape = memchr(src + i, '\\', length - i);
+        size_t run_length = escape ? (size_t)(escape - (src + i)) : length - i;
+        memcpy(dst + idx, src + i, run_length);
+        idx += run_length;
+        i += run_length;
+
+        if(i >= length)
+        {
+            break;
+        }
+
+        char c = src[i++];
+
+        if(c == '\\')
+        {
+            c = src[i++];
+
+            switch(c)
+            {
+                case 'b':
+                    c = '\b';
+                    break;
+
+                case 'f':
+                    c = '\f';
+                    break;
+
+                case 'n':
+                    c = '\n';
+                    break;
+
+                case 'r':
+                    c = '\r';
+                    break;
+
+                case 't':
+                    c = '\t';
+                    break;
+
+#ifndef JSON_NO_UNICODE_ESCAPES
+                case 'u':
+                {
+                    unsigned int codepoint;
+                    i += json_parse_unicode_escape(src + i, length - i, &codepoint);
+                    idx += json_utf8_encode(codepoint, dst + idx);
+                    continue;
+                }
+#endif
+
+                default:
+                    break; // '"', '\\' and '/' decode to themselves
+            }
+        }
+
+        dst[idx++] = c;
+    }
+
+    dst[idx] = '\0';
+    return idx;
+}
+
+// `key` is set for member names, which JSON_FLAG_INTERN_KEYS stores once per distinct name
+static int json_parse_string(json_parser_t *parser, int key)
+{
+    if(json_add_token(parser, JSON_TOKEN_STRING))
+    {
+        return -1;
+    }
+
+    json_token_t *token = &parser->tokens[parser->token_count - 1];
+    token->start = parser->pos + 1;
+    size_t length = 0;
+    int escaped = 0;
+
+    if(json_scan_string(parser, &length, &escaped))
+    {
+        return -1;
+    }
+
+    token->end = parser->pos - 1;
+    const char *raw = parser->json + token->start;
+
+#ifdef JSON_NO_STRING_COPY
+    (void)key;
+    token->flags = JSON_TOKEN_FLAG_RAW | (escaped ? JSON_TOKEN_FLAG_ESCAPED : 0);
+    token->value.string = (char *)raw;
+    return 0;
+#else
+
+    if(parser->flags & JSON_FLAG_ZERO_COPY)
+    {
+        token->flags = JSON_TOKEN_FLAG_RAW | (escaped ? JSON_TOKEN_FLAG_ESCAPED : 0);
+        token->value.string = (char *)raw;
+        return 0;
+    }
+
+    if(key && (parser->flags & JSON_FLAG_INTERN_KEYS))
+    {
+        if(escaped)
+        {
+            if(!json_reserve_scratch(parser, length + 1))
+            {
+                return -1;
+            }
+
+            json_decode_string(raw, token->end - token->start, parser->scratch);
+            raw = parser->scratch;
+        }
+
+        return json_intern_token(parser, token, raw, length);
+    }
+
+    char *buffer = json_alloc_string(parser, length);
+
+    if(!buffer)
+    {
+        json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+        return -1;
+    }
+
+    if(escaped)
+    {
+        json_decode_string(raw, token->end - token->start, buffer);
+    }
+    else
+    {
+        memcpy(buffer, raw, length);
+        buffer[length] = '\0';
+    }
+
+    token->value.string = buffer;
+    return 0;
+#endif
+}
+
+// Decimal form of a validated number: value = mantissa * 10^exponent, with digits
+// beyond the 19th dropped (truncated is set when any of them was non-zero)
+typedef struct
+{
+    uint64_t mantissa;
+    int64_t exponent;
+    int digits;
+    int negative;
+    int truncated;
+    int integer;
+} json_number_t;
+
+static void json_number_push_digit(json_number_t *num, int digit, int fraction)
+{
+    // A 20th integer digit is still kept when the value fits in 64 bits
+    if(num->digits < 19 || (!fraction && num->digits == 19 && num->mantissa <= (UINT64_MAX - (uint64_t)digit) / 10))
+    {
+        num->mantissa = num->mantissa * 10 + (uint64_t)digit;
+        num->digits += num->mantissa != 0;
+        num->exponent -= fraction;
+    }
+    else
+    {
+        num->truncated |= digit != 0;
+        num->exponent += !fraction;
+    }
+}
+
+// Validates the number grammar in [p, end) and returns the first byte after it, or NULL
+static const char *json_scan_number(const char *p, const char *end, json_number_t *num)
+{
+    memset(num, 0, sizeof(*num));
+
+    // Check optional sign
+    if(p < end && *p == '-')
+    {
+        num->negative = 1;
+        p++;
+    }
+
+    // Validate integer part
+    if(p >= end || !JSON_IS_CHAR(*p, JSON_CHAR_DIGIT))
+    {
+        return NULL;
+    }
+
+    if(*p == '0')
+    {
+        p++;
+
+        // Leading zeros and hexadecimal prefixes are not JSON numbers
+        if(p < end && (JSON_IS_CHAR(*p, JSON_CHAR_DIGIT) || *p == 'x' || *p == 'X'))
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        while(p < end && JSON_IS_CHAR(*p, JSON_CHAR_DIGIT))
+        {
+            json_number_push_digit(num, *p++ - '0', 0);
+        }
+    }
+
+    num->integer = 1;
+
+#ifdef JSON_NO_FLOAT
+    // Integers only: fractions, exponents and values beyond 64 bits are rejected
+    if((p < end && (*p == '.' || *p == 'e' || *p == 'E')) || num->truncated || num->exponent ||
+            (num->negative && num->mantissa > (uint64_t)INT64_MAX + 1))
+    {
+        return NULL;
+    }
+
+    return p;
+#endif
+
+    // Validate fractional part
+    if(p < end && *p == '.')
+    {
+        p++;
+
+        if(p >= end || !JSON_IS_CHAR(*p, JSON_CHAR_DIGIT))
+        {
+            return NULL;
+        }
+
+        num->integer = 0;
+
+        while(p < end && JSON_IS_CHAR(*p, JSON_CHAR_DIGIT))
+        {
+            json_number_push_digit(num, *p++ - '0', 1);
+        }
+    }
+
+    // Validate exponent part
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+        int negative_exponent = 0;
+        int64_t exponent = 0;
+        p++;
+
+        if(p < end && (*p == '+' || *p == '-'))
+        {
+            negative_exponent = *p++ == '-';
+        }
+
+        if(p >= end || !JSON_IS_CHAR(*p, JSON_CHAR_DIGIT))
+        {
+            return NULL;
+        }
+
+        num->integer = 0;
+
+        while(p < end && JSON_IS_CHAR(*p, JSON_CHAR_DIGIT))
+        {
+            // Anything past this saturates to zero or infinity anyway
+            if(exponent < 100000)
+            {
+                exponent = exponent * 10 + (*p - '0');
+            }
+
+            p++;
+        }
+
+        num->exponent += negative_exponent ? -exponent : exponent;
+    }
+
+    return p;
+}
+
+#ifndef JSON_NO_FLOAT
+/*
+    Exact fallback: arbitrary precision decimal that is scaled by powers of two until it
+    is in floating point range, then rounded to nearest-even. Only reached for inputs
+    the fast paths cannot convert exactly (more than 19 digits, huge exponents, ...).
+*/
+
+#define JSON_DECIMAL_DIGITS 800
+#define JSON_DECIMAL_MAX_SHIFT 60
+
+typedef struct
+{
+    unsigned char d[JSON_DECIMAL_DIGITS]; // digit values, most significant first
+    int nd;                               // digits used
+    int dp;                               // decimal point position: value = 0.d * 10^dp
+    int trunc;                            // non-zero digits were dropped
+} json_decimal_t;
+
+static void json_decimal_assign(json_decimal_t *a, const char *p, const char *end)
+{
+    int saw_dot = 0;
+    a->nd = 0;
+    a->dp = 0;
+    a->trunc = 0;
+
+    if(*p == '-')
+    {
+        p++;
+    }
+
+    for(; p < end; p++)
+    {
+        if(*p == '.')
+        {
+            saw_dot = 1;
+            a->dp = a->nd;
+        }
+        else if(JSON_IS_CHAR(*p, JSON_CHAR_DIGIT))
+        {
+            if(*p == '0' && a->nd == 0)
+            {
+                a->dp--; // Leading zeros only move the decimal point
+            }
+            else if(a->nd < JSON_DECIMAL_DIGITS)
+            {
+                a->d[a->nd++] = (unsigned char)(*p - '0');
+            }
+            else if(*p != '0')
+            {
+                a->trunc = 1;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if(!saw_dot)
+    {
+        a->dp = a->nd;
+    }
+
+    if(p < end)
+    {
+        // Exponent, already validated by json_scan_number
+        int negative = 0;
+        int exponent = 0;
+        p++;
+
+        if(*p == '+' || *p == '-')
+        {
+            negative = *p++ == '-';
+        }
+
+        for(; p < end; p++)
+        {
+            if(exponent < 10000)
+            {
+                exponent = exponent * 10 + (*p - '0');
+            }
+        }
+
+        a->dp += negative ? -exponent : exponent;
+    }
+}
+
+static void json_decimal_trim(json_decimal_t *a)
+{
+    while(a->nd > 0 && a->d[a->nd - 1] == 0)
+    {
+        a->nd--;
+    }
+
+    if(a->nd == 0)
+    {
+        a->dp = 0;
+    }
+}
+
+static void json_decimal_left_shift(json_decimal_t *a, unsigned int k)
+{
+    unsigned char tmp[JSON_DECIMAL_DIGITS + 24];
+    int w = (int)sizeof(tmp);
+    uint64_t n = 0;
+
+    for(int r = a->nd - 1; r >= 0; r--)
+    {
+        n += (uint64_t)a->d[r] << k;
+        tmp[--w] = (unsigned char)(n % 10);
+        n /= 10;
+    }
+
+    while(n > 0)
+    {
+        tmp[--w] = (unsigned char)(n % 10);
+        n /= 10;
+    }
+
+    int count = (int)sizeof(tmp) - w;
+    a->dp += count - a->nd;
+
+    if(count > JSON_DECIMAL_DIGITS)
+    {
+        for(int i = JSON_DECIMAL_DIGITS; i < count; i++)
+        {
+            a->trunc |= tmp[w + i] != 0;
+        }
+
+        count = JSON_DECIMAL_DIGITS;
+    }
+
+    memcpy(a->d, tmp + w, (size_t)count);
+    a->nd = count;
+    json_decimal_trim(a);
+}
+
+static void json_decimal_right_shift(json_decimal_t *a, unsigned int k)
+{
+    int r = 0;
+    int w = 0;
+    uint64_t n = 0;
+
+    // Pick up enough leading digits to cover the first shift
+    for(; (n >> k) == 0; r++)
+    {
+        if(r >= a->nd)
+        {
+            if(n == 0)
+            {
+                a->nd = 0;
+                return;
+            }
+
+            while((n >> k) == 0)
+            {
+                n *= 10;
+                r++;
+            }
+
+            break;
+        }
+
+        n = n * 10 + a->d[r];
+    }
+
+    a->dp -= r - 1;
+    uint64_t mask = ((uint64_t)1 << k) - 1;
+
+    // Pick up a digit, put down a digit
+    for(; r < a->nd; r++)
+    {
+        uint64_t digit = n >> k;
+        n &= mask;
+        a->d[w++] = (unsigned char)digit;
+        n = n * 10 + a->d[r];
+    }
+
+    // Put down extra digits
+    while(n > 0)
+    {
+        uint64_t digit = n >> k;
+        n &= mask;
+
+        if(w < JSON_DECIMAL_DIGITS)
+        {
+            a->d[w++] = (unsigned char)digit;
+        }
+        else if(digit > 0)
+        {
+            a->trunc = 1;
+        }
+
+        n *= 10;
+    }
+
+    a->nd = w;
+    json_decimal_trim(a);
+}
+
+static void json_decimal_shift(json_decimal_t *a, int k)
+{
+    if(a->nd == 0)
+    {
+        return;
+    }
+
+    for(; k > JSON_DECIMAL_MAX_SHIFT; k -= JSON_DECIMAL_MAX_SHIFT)
+    {
+        json_decimal_left_shift(a, JSON_DECIMAL_MAX_SHIFT);
+    }
+
+    for(; k < -JSON_DECIMAL_MAX_SHIFT; k += JSON_DECIMAL_MAX_SHIFT)
+    {
+        json_decimal_right_shift(a, JSON_DECIMAL_MAX_SHIFT);
+    }
+
+    if(k > 0)
+    {
+        json_decimal_left_shift(a, (unsigned int)k);
+    }
+    else if(k < 0)
+    {
+        json_decimal_right_shift(a, (unsigned int)-k);
+    }
+}
+
+static uint64_t json_decimal_rounded_integer(const json_decimal_t *a)
+{
+    if(a->dp > 20)
+    {
+        return UINT64_MAX;
+    }
+
+    uint64_t n = 0;
+    int i;
+
+    for(i = 0; i < a->dp && i < a->nd; i++)
+    {
+        n = n * 10 + a->d[i];
+    }
+
+    for(; i < a->dp; i++)
+    {
+        n *= 10;
+    }
+
+    // Round half to even; dropped digits put an exact half above the midpoint
+    if(a->dp >= 0 && a->dp < a->nd)
+    {
+        if(a->d[a->dp] == 5 && a->dp + 1 == a->nd)
+        {
+            n += a->trunc || (a->dp > 0 && (a->d[a->dp - 1] & 1));
+        }
+        else
+        {
+            n += a->d[a->dp] >= 5;
+        }
+    }
+
+    return n;
+}
+
+static double json_decimal_to_double(json_decimal_t *a, int negative)
+{
+    static const int powers[] = {1, 3, 6, 9, 13, 16, 19, 23, 26};
+    const int bias = -1023;
+    uint64_t mantissa = 0;
+    int exp = bias;
+
+    if(a->nd == 0 || a->dp < -330)
+    {
+        goto out; // Zero or certain underflow
+    }
+
+    if(a->dp > 310)
+    {
+        goto overflow;
+    }
+
+    // Scale by powers of two until the value is in [0.5, 1)
+    exp = 0;
+
+    while(a->dp > 0)
+    {
+        int n = a->dp >= 9 ? 27 : powers[a->dp];
+        json_decimal_shift(a, -n);
+        exp += n;
+    }
+
+    while(a->dp < 0 || (a->dp == 0 && a->d[0] < 5))
+    {
+        int n = -a->dp >= 9 ? 27 : powers[-a->dp];
+        json_decimal_shift(a, n);
+        exp -= n;
+    }
+
+    // The range is [0.5, 1) but the floating point range is [1, 2)
+    exp--;
+
+    // Denormals: move the exponent up to the minimum and shift the digits down
+    if(exp < bias + 1)
+    {
+        json_decimal_shift(a, -(bias + 1 - exp));
+        exp = bias + 1;
+    }
+
+    if(exp - bias >= 0x7FF)
+    {
+        goto overflow;
+    }
+
+    // Extract 53 bits
+    json_decimal_shift(a, 53);
+    mantissa = json_decimal_rounded_integer(a);
+
+    // Rounding might have added a bit
+    if(mantissa == ((uint64_t)2 << 52))
+    {
+        mantissa >>= 1;
+        exp++;
+
+        if(exp - bias >= 0x7FF)
+        {
+            goto overflow;
+        }
+    }
+
+    if(!(mantissa & ((uint64_t)1 << 52)))
+    {
+        exp = bias;
+    }
+
+    goto out;
+overflow:
+    mantissa = 0;
+    exp = 0x7FF + bias;
+out:
+    {
+        uint64_t bits = (mantissa & (((uint64_t)1 << 52) - 1)) | ((uint64_t)((exp - bias) & 0x7FF) << 52);
+        double value;
+
+        if(negative)
+        {
+            bits |= (uint64_t)1 << 63;
+        }
+
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+}
+
+static double json_number_to_double(const json_number_t *num, const char *start, const char *stop)
+{
+    static const double powers[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const uint64_t max_exact = (uint64_t)1 << 53;
+
+    if(!num->truncated)
+    {
+        // Integer fast path: the hardware conversion rounds correctly
+        if(num->exponent == 0)
+        {
+            double value = (double)num->mantissa;
+            return num->negative ? -value : value;
+        }
+
+        // Clinger's fast path: exact mantissa times an exact power of ten, one rounding
+        if(num->mantissa <= max_exact)
+        {
+            uint64_t mantissa = num->mantissa;
+            int64_t exponent = num->exponent;
+
+            // Move surplus exponent into the mantissa while it stays exact
+            while(exponent > 22 && exponent <= 22 + 15 && mantissa <= max_exact / 10)
+            {
+                mantissa *= 10;
+                exponent--;
+            }
+
+            if(exponent >= -22 && exponent <= 22)
+            {
+                double value = (double)mantissa;
+                value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+                return num->negative ? -value : value;
+            }
+        }
+    }
+
+    json_decimal_t decimal;
+    json_decimal_assign(&decimal, start, stop);
+    return json_decimal_to_double(&decimal, num->negative);
+}
+
+#endif
+
+// Stores integer literals that fit 64 bits without any float conversion
+static int json_number_to_integer(const json_number_t *num, json_token_t *token)
+{
+    if(!(num->integer && !num->truncated && num->exponent == 0))
+    {
+        return 0;
+    }
+
+    if(num->negative)
+    {
+#ifndef JSON_NO_FLOAT
+        // "-0" stays a double to keep its sign
+        if(num->mantissa == 0 || num->mantissa > (uint64_t)INT64_MAX + 1)
+        {
+            return 0;
+        }
+#endif
+
+        token->value.integer = num->mantissa == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)num->mantissa;
+        token->flags = JSON_TOKEN_FLAG_INTEGER;
+    }
+    else if(num->mantissa > (uint64_t)INT64_MAX)
+    {
+        token->value.uinteger = num->mantissa;
+        token->flags = JSON_TOKEN_FLAG_INTEGER | JSON_TOKEN_FLAG_UNSIGNED;
+    }
+    else
+    {
+        token->value.integer = (int64_t)num->mantissa;
+        token->flags = JSON_TOKEN_FLAG_INTEGER;
+    }
+
+    return 1;
+}
+
+// Stores a scanned number in its token: an integer when asked for, a double otherwise
+static void json_number_store(json_parser_t *parser, const json_number_t *num, const char *start, const char *stop, json_token_t *token)
+{
+#ifdef JSON_NO_FLOAT
+    // Every number the scanner accepts is an integer in range
+    (void)parser;
+    (void)start;
+    (void)stop;
+    json_number_to_integer(num, token);
+#else
+
+    if(!(parser->flags & JSON_FLAG_INTEGERS) || !json_number_to_integer(num, token))
+    {
+        token->value.number = json_number_to_double(num, start, stop);
+    }
+
+#endif
+}
+
+static int json_parse_number(json_parser_t *parser)
+{
+    const char *start = parser->json + parser->pos;
+    json_number_t num;
+    const char *p = json_scan_number(start, parser->json + parser->length, &num);
+
+    if(!p)
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
+        return -1;
+    }
+
+    if(json_add_token(parser, JSON_TOKEN_NUMBER))
+    {
+        return -1;
+    }
+
+    json_token_t *token = &parser->tokens[parser->token_count - 1];
+
+    if((parser->flags & JSON_FLAG_LAZY_NUMBERS) || parser->sax_muted)
+    {
+        token->flags = JSON_TOKEN_FLAG_LAZY;
+    }
+    else
+    {
+        JSON_STATS_ADD(parser, numbers, 1);
+        json_number_store(parser, &num, start, p, token);
+    }
+
+    token->start = parser->pos;
+    parser->pos += (p - start);
+    token->end = parser->pos;
+    return 0;
+}
+
+// Converts a lazy number token in place, the same way the eager parse would have
+static json_token_t *json_token_number(json_parser_t *parser, const json_token_t *token)
+{
+    if(token->type != JSON_TOKEN_NUMBER)
+    {
+        return NULL;
+    }
+
+    json_token_t *tok = &parser->tokens[token - parser->tokens];
+
+    if(tok->flags & JSON_TOKEN_FLAG_LAZY)
+    {
+        const char *start = parser->json + tok->start;
+        const char *stop = parser->json + tok->end;
+        json_number_t num;
+        json_scan_number(start, stop, &num);
+        tok->flags = 0;
+        JSON_STATS_ADD(parser, numbers, 1);
+        json_number_store(parser, &num, start, stop, tok);
+    }
+
+    return tok;
+}
+
+#ifndef JSON_NO_FLOAT
+double json_token_get_double(json_parser_t *parser, const json_token_t *token)
+{
+    json_token_t *tok = json_token_number(parser, token);
+
+    if(!tok)
+    {
+        return 0.0;
+    }
+
+    if(tok->flags & JSON_TOKEN_FLAG_UNSIGNED)
+    {
+        return (double)tok->value.uinteger;
+    }
+
+    if(tok->flags & JSON_TOKEN_FLAG_INTEGER)
+    {
+        return (double)tok->value.integer;
+    }
+
+    return tok->value.number;
+}
+#endif
+
+// Integral doubles are accepted only while they are exact (|x| <= 2^53)
+static json_error_t json_number_get_integer(const json_token_t *tok, int64_t *value, uint64_t *uvalue)
+{
+    if(tok->flags & JSON_TOKEN_FLAG_INTEGER)
+    {
+        if(tok->flags & JSON_TOKEN_FLAG_UNSIGNED)
+        {
+            if(!uvalue)
+            {
+                return JSON_ERROR_INVALID_NUMBER;
+            }
+
+            *uvalue = tok->value.uinteger;
+        }
+        else if(value)
+        {
+            *value = tok->value.integer;
+        }
+        else if(tok->value.integer >= 0)
+        {
+            *uvalue = (uint64_t)tok->value.integer;
+        }
+        else
+        {
+            return JSON_ERROR_INVALID_NUMBER;
+        }
+
+        return JSON_ERROR_NONE;
+    }
+
+#ifdef JSON_NO_FLOAT
+    return JSON_ERROR_INVALID_NUMBER;
+#else
+    const double max_exact = 9007199254740992.0;
+    double number = tok->value.number;
+
+    if(number > max_exact || number < -max_exact || number != (double)(int64_t)number || (uvalue && number < 0))
+    {
+        return JSON_ERROR_INVALID_NUMBER;
+    }
+
+    if(value)
+    {
+        *value = (int64_t)number;
+    }
+    else
+    {
+        *uvalue = (uint64_t)number;
+    }
+
+    return JSON_ERROR_NONE;
+#endif
+}
+
+static json_error_t json_token_get_integer(json_parser_t *parser, const json_token_t *token, int64_t *value, uint64_t *uvalue)
+{
+    json_token_t *tok = json_token_number(parser, token);
+    return tok ? json_number_get_integer(tok, value, uvalue) : JSON_ERROR_INVALID_TOKEN;
+}
+
+json_error_t json_token_get_int64(json_parser_t *parser, const json_token_t *token, int64_t *value)
+{
+    return json_token_get_integer(parser, token, value, NULL);
+}
+
+json_error_t json_token_get_uint64(json_parser_t *parser, const json_token_t *token, uint64_t *value)
+{
+    return json_token_get_integer(parser, token, NULL, value);
+}
+
+static int json_parse_literal(json_parser_t *parser, const char *literal, json_token_type_t type)
+{
+    size_t len = strlen(literal);
+
+    if(parser->pos + len > parser->length || strncmp(parser->json + parser->pos, literal, len))
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
+        return -1;
+    }
+
+    size_t literal_start_pos = parser->pos;
+    parser->pos += len;
+
+    if(json_add_token(parser, type))
+    {
+        return -1;
+    }
+
+    json_token_t *token = &parser->tokens[parser->token_count - 1];
+    token->start = literal_start_pos;
+    token->end = parser->pos;
+    return 0;
+}
+
+static int json_sax_enter(json_parser_t *parser, char c, unsigned int *state);
+static int json_sax_leave(json_parser_t *parser, size_t index, unsigned int state);
+static int json_sax_key(json_parser_t *parser);
+static int json_split_stitch(json_parser_t *parser, size_t array);
+
+static int json_parse_scalar(json_parser_t *parser, char c)
+{
+    switch(c)
+    {
+        case '"':
+            return json_parse_string(parser, 0);
+
+        case 't':
+            return json_parse_literal(parser, "true", JSON_TOKEN_TRUE);
+
+        case 'f':
+            return json_parse_literal(parser, "false", JSON_TOKEN_FALSE);
+
+        case 'n':
+            return json_parse_literal(parser, "null", JSON_TOKEN_NULL);
+
+        default:
+            if(JSON_IS_CHAR(c, JSON_CHAR_NUMBER))
+            {
+                return json_parse_number(parser);
+            }
+            else
+            {
+                json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
+                return -1;
+            }
+    }
+}
+
+// Opens the container just added as token `index`; children added from now on point to it
+static size_t json_open_container(json_parser_t *parser, size_t index)
+{
+    size_t enclosing = 0;
+#ifdef JSON_PARENT_LINKS
+    enclosing = parser->parent;
+    parser->parent = (unsigned int)index;
+#else
+    (void)index;
+#endif
+    parser->depth++;
+    JSON_STATS_MAX(parser, max_depth, parser->depth);
+    return enclosing;
+}
+
+static void json_close_container(json_parser_t *parser, size_t index, size_t enclosing)
+{
+    parser->pos++;
+    parser->tokens[index].end = parser->pos;
+    parser->tokens[index].next = (unsigned int)parser->token_count;
+#ifdef JSON_PARENT_LINKS
+    parser->parent = (unsigned int)enclosing;
+#else
+    (void)enclosing;
+#endif
+    parser->depth--;
+}
+
+// One open container of the iterative parser
+struct json_frame
+{
+    unsigned int index;     // Container token
+    unsigned int enclosing; // Parent link to restore when it closes
+    unsigned int sax;       // json_sax_enter state
+};
+
+// The frame stack holds max_depth entries and is kept across parses; it is only
+// needed when max_depth exceeds JSON_INLINE_FRAMES
+static int json_reserve_frames(json_parser_t *parser)
+{
+    if(parser->frames && parser->frame_cap >= parser->max_depth)
+    {
+        return 0;
+    }
+
+    size_t bytes = (parser->max_depth + 1) * sizeof(struct json_frame);
+    struct json_frame *frames;
+
+    if(parser->arena)
+    {
+        // High allocations are byte aligned
+        char *raw = json_arena_alloc_high(parser->arena, bytes + sizeof(unsigned int) - 1);
+        frames = raw ? (struct json_frame *)(((uintptr_t)raw + sizeof(unsigned int) - 1) & ~(uintptr_t)(sizeof(unsigned int) - 1)) : NULL;
+    }
+    else
+    {
+        frames = JSON_REALLOC(parser->frames, bytes);
+    }
+
+    if(!frames)
+    {
+        json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+        return -1;
+    }
+
+    parser->frames = frames;
+    parser->frame_cap = parser->max_depth;
+    return 0;
+}
+
+typedef enum
+{
+    JSON_EXPECT_VALUE,
+    JSON_EXPECT_MEMBER,  // A key or '}'
+    JSON_EXPECT_ELEMENT, // The first array element or ']'
+    JSON_EXPECT_NEXT     // A value just ended: ',' or the closing bracket
+} json_expect_t;
+
+// Pops the innermost container, whose closing bracket is at parser->pos
+static int json_parse_close(json_parser_t *parser, struct json_frame *frames, size_t *top)
+{
+    struct json_frame *frame = &frames[--*top];
+    json_close_container(parser, frame->index, frame->enclosing);
+    return parser->sax ? json_sax_leave(parser, frame->index, frame->sax) : 0;
+}
+
+// Parses one complete value with an explicit container stack instead of recursion,
+// so nesting is limited by max_depth rather than by the C stack
+static int json_parse_document(json_parser_t *parser)
+{
+    struct json_frame inline_frames[JSON_INLINE_FRAMES];
+    struct json_frame *frames = inline_frames;
+
+    if(parser->max_depth > JSON_INLINE_FRAMES)
+    {
+        if(json_reserve_frames(parser))
+        {
+            return -1;
+        }
+
+        frames = parser->frames;
+    }
+
+    size_t top = 0;
+    json_expect_t expect = JSON_EXPECT_VALUE;
+
+    for(;;)
+    {
+        json_skip_whitespace(parser);
+
+        if(expect == JSON_EXPECT_NEXT && top == 0)
+        {
+            return 0;
+        }
+
+        if(parser->pos >= parser->length)
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            return -1;
+        }
+
+        char c = parser->json[parser->pos];
+
+        switch(expect)
+        {
+            case JSON_EXPECT_VALUE:
+            {
+                size_t index = parser->token_count;
+                unsigned int sax = 0;
+
+                if(parser->sax && json_sax_enter(parser, c, &sax))
+                {
+                    return -1;
+                }
+
+                if(c != '{' && c != '[')
+                {
+                    if(json_parse_scalar(parser, c) || (parser->sax && json_sax_leave(parser, index, sax)))
+                    {
+                        return -1;
+                    }
+
+                    expect = JSON_EXPECT_NEXT;
+                    break;
+                }
+
+                if((size_t)parser->depth >= parser->max_depth)
+                {
+                    json_set_error(parser, JSON_ERROR_NESTING_DEPTH);
+                    return -1;
+                }
+
+                if(json_add_token(parser, c == '{' ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY) < 0)
+                {
+                    return -1;
+                }
+
+                struct json_frame *frame = &frames[top++];
+                frame->index = (unsigned int)index;
+                frame->enclosing = (unsigned int)json_open_container(parser, index);
+                frame->sax = sax;
+                parser->pos++; // Skip '{' or '['
+                expect = c == '{' ? JSON_EXPECT_MEMBER : JSON_EXPECT_ELEMENT;
+
+                if(parser->split)
+                {
+                    // The elements of the designated array were parsed up front by the workers
+                    int stitched = json_split_stitch(parser, index);
+
+                    if(stitched < 0 || (stitched && json_parse_close(parser, frames, &top)))
+                    {
+                        return -1;
+                    }
+
+                    expect = stitched ? JSON_EXPECT_NEXT : expect;
+                }
+
+                break;
+            }
+
+            case JSON_EXPECT_MEMBER:
+                if(c == '}')
+                {
+                    if(json_parse_close(parser, frames, &top))
+                    {
+                        return -1;
+                    }
+
+                    expect = JSON_EXPECT_NEXT;
+                    break;
+                }
+
+                if(c != '"')
+                {
+                    json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                    return -1;
+                }
+
+                if(json_parse_string(parser, 1) || (parser->sax && json_sax_key(parser)))
+                {
+                    return -1;
+                }
+
+                json_skip_whitespace(parser);
+
+                if(parser->pos >= parser->length || parser->json[parser->pos++] != ':')
+                {
+                    json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                    return -1;
+                }
+
+                expect = JSON_EXPECT_VALUE;
+                break;
+
+            case JSON_EXPECT_ELEMENT:
+                if(c == ']')
+                {
+                    if(json_parse_close(parser, frames, &top))
+                    {
+                        return -1;
+                    }
+
+                    expect = JSON_EXPECT_NEXT;
+                    break;
+                }
+
+                expect = JSON_EXPECT_VALUE;
+                break;
+
+            case JSON_EXPECT_NEXT:
+            {
+                size_t index = frames[top - 1].index;
+                int object = parser->tokens[index].type == JSON_TOKEN_OBJECT;
+                parser->tokens[index].size++;
+
+                if(c == (object ? '}' : ']'))
+                {
+                    if(json_parse_close(parser, frames, &top))
+                    {
+                        return -1;
+                    }
+
+                    break;
+                }
+
+                if(c != ',')
+                {
+                    json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                    return -1;
+                }
+
+                parser->pos++;
+                expect = object ? JSON_EXPECT_MEMBER : JSON_EXPECT_VALUE;
+#ifndef JSON_STRICT
+
+                if(object)
+                {
+                    // A trailing comma before '}' is tolerated, as it always was
+                    break;
+                }
+
+#endif
+                json_skip_whitespace(parser);
+
+                if(parser->pos < parser->length && parser->json[parser->pos] == (object ? '}' : ']'))
+                {
+                    json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                    return -1;
+                }
+
+                break;
+            }
+        }
+    }
+}
+
+// Open-addressing key table: (key hash, key token index + 1) pairs, 0 marks an empty slot
+struct json_object_index
+{
+    uint32_t mask;
+    uint32_t slots[];
+};
+
+static uint32_t json_hash_key(const char *key, size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static int json_key_equals(json_parser_t *parser, size_t key_index, const char *key, size_t length)
+{
+    size_t key_length;
+    const char *name = json_token_string(parser, &parser->tokens[key_index], &key_length);
+    // Looking up an interned key with the pointer from the same table needs no byte compare
+    return name && key_length == length && (name == key || memcmp(name, key, length) == 0);
+}
+
+static struct json_object_index *json_build_object_index(json_parser_t *parser, size_t object)
+{
+    size_t capacity = 4;
+
+    while(capacity < (size_t)parser->tokens[object].size * 2)
+    {
+        capacity *= 2;
+    }
+
+    size_t bytes = sizeof(struct json_object_index) + capacity * 2 * sizeof(uint32_t);
+    struct json_object_index *index;
+
+    if(parser->arena)
+    {
+        // Arena strings leave the high mark unaligned
+        char *raw = json_arena_alloc_high(parser->arena, bytes + sizeof(uint32_t) - 1);
+        index = raw ? (struct json_object_index *)(((uintptr_t)raw + sizeof(uint32_t) - 1) & ~(uintptr_t)(sizeof(uint32_t) - 1)) : NULL;
+    }
+    else
+    {
+        index = JSON_MALLOC(bytes);
+    }
+
+    if(!index)
+    {
+        return NULL;
+    }
+
+    memset(index->slots, 0, capacity * 2 * sizeof(uint32_t));
+    index->mask = (uint32_t)(capacity - 1);
+    size_t key = object + 1;
+
+    for(unsigned int i = 0; i < parser->tokens[object].size; i++)
+    {
+        size_t length;
+        const char *name = json_token_string(parser, &parser->tokens[key], &length);
+
+        if(!name)
+        {
+            if(!parser->arena)
+            {
+                JSON_FREE(index);
+            }
+
+            return NULL;
+        }
+
+        uint32_t hash = parser->tokens[key].flags & JSON_TOKEN_FLAG_INTERNED ? json_intern_hash(name) : json_hash_key(name, length);
+        uint32_t slot = hash & index->mask;
+
+        // Duplicate keys keep their first occurrence, like the linear scan
+        while(index->slots[slot * 2 + 1] &&
+                !(index->slots[slot * 2] == hash && json_key_equals(parser, index->slots[slot * 2 + 1] - 1, name, length)))
+        {
+            slot = (slot + 1) & index->mask;
+        }
+
+        if(!index->slots[slot * 2 + 1])
+        {
+            index->slots[slot * 2] = hash;
+            index->slots[slot * 2 + 1] = (uint32_t)key + 1;
+        }
+
+        key = parser->tokens[key + 1].next;
+    }
+
+    if(!parser->arena)
+    {
+        parser->index_count++;
+    }
+
+    parser->tokens[object].value.index = index;
+    return index;
+}
+
+const json_token_t *json_object_find(json_parser_t *parser, const json_token_t *object, const char *key, size_t length)
+{
+    if(parser->error != JSON_ERROR_NONE || object->type != JSON_TOKEN_OBJECT)
+    {
+        return NULL;
+    }
+
+    size_t obj = object - parser->tokens;
+    struct json_object_index *index = parser->tokens[obj].value.index;
+
+    // Borrowed tokens may be read by several views at once, so they are only ever scanned
+    if(!index && object->size >= JSON_OBJECT_INDEX_THRESHOLD && !parser->borrowed)
+    {
+        index = json_build_object_index(parser, obj);
+    }
+
+    if(index)
+    {
+        uint32_t hash = json_hash_key(key, length);
+        uint32_t slot = hash & index->mask;
+
+        while(index->slots[slot * 2 + 1])
+        {
+            size_t key_index = index->slots[slot * 2 + 1] - 1;
+
+            if(index->slots[slot * 2] == hash && json_key_equals(parser, key_index, key, length))
+            {
+                return &parser->tokens[key_index + 1];
+            }
+
+            slot = (slot + 1) & index->mask;
+        }
+
+        return NULL;
+    }
+
+    // Small objects, or a table that could not be allocated: scan the keys
+    size_t key_index = obj + 1;
+
+    for(unsigned int i = 0; i < object->size; i++)
+    {
+        if(json_key_equals(parser, key_index, key, length))
+        {
+            return &parser->tokens[key_index + 1];
+        }
+
+        key_index = parser->tokens[key_index + 1].next;
+    }
+
+    return NULL;
+}
+
+json_error_t json_parser_parse(json_parser_t *parser)
+{
+    parser->error = JSON_ERROR_NONE;
+#ifdef JSON_PARENT_LINKS
+    parser->parent = JSON_TOKEN_NO_PARENT;
+#endif
+#ifdef JSON_PARSER_STATS
+    memset(&parser->stats, 0, sizeof(parser->stats));
+#endif
+    JSON_STATS_START(prescan);
+
+    if((parser->flags & JSON_FLAG_PRESCAN) &&
+            json_reserve_tokens(parser, parser->token_count + json_count_tokens(parser->json + parser->pos, parser->length - parser->pos)))
+    {
+        return parser->error;
+    }
+
+    JSON_STATS_STOP(parser, prescan_cycles, prescan);
+    JSON_STATS_START(stage1);
+    parser->use_index = (parser->flags & JSON_FLAG_STRUCTURAL_INDEX) && json_build_structural_index(parser) == 0;
+    JSON_STATS_STOP(parser, index_cycles, stage1);
+    JSON_STATS_START(stage2);
+    json_skip_whitespace(parser);
+
+    if(parser->pos >= parser->length)
+    {
+        if(parser->length == 0 || parser->pos == parser->length)
+        {
+            json_set_error(parser, JSON_ERROR_EMPTY_INPUT);
+        }
+        else
+        {
+            json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
+        }
+
+        return parser->error;
+    }
+
+    int failed = json_parse_document(parser) < 0;
+    JSON_STATS_STOP(parser, parse_cycles, stage2);
+
+    if(failed)
+    {
+        return parser->error;
+    }
+
+    json_skip_whitespace(parser);
+
+    if(parser->pos != parser->length)
+    {
+        json_set_error(parser, JSON_ERROR_TRAILING_CHARS);
+    }
+
+    JSON_STATS_START(hashing);
+
+    for(size_t i = 0; (parser->flags & JSON_FLAG_OBJECT_INDEX) && parser->error == JSON_ERROR_NONE && i < parser->token_count; i++)
+    {
+        if(parser->tokens[i].type == JSON_TOKEN_OBJECT && parser->tokens[i].size >= JSON_OBJECT_INDEX_THRESHOLD)
+        {
+            json_build_object_index(parser, i);
+        }
+    }
+
+    JSON_STATS_STOP(parser, object_index_cycles, hashing);
+    return parser->error;
+}
+
+// Validation without tokens. The grammar, limits and error positions are those of
+// json_parser_parse, but nothing is stored: strings are scanned (with the SIMD string
+// kernel) for escapes and length only, numbers are checked but not converted, and the
+// open containers are one bit each on the stack.
+// Whitespace runs are skipped 16 bytes at a time.
+static void json_validate_skip_whitespace(json_parser_t *parser)
+{
+    // Most calls land on a token right away
+    if(parser->pos < parser->length && (unsigned char)(parser->json[parser->pos] - '!') < 0x7F - '!')
+    {
+        return;
+    }
+
+    parser->pos = (size_t)(json_skip_ascii_whitespace(parser->json + parser->pos, parser->json + parser->length) - parser->json);
+}
+
+// json_parse_scalar without the token
+static int json_validate_scalar(json_parser_t *parser, char c)
+{
+    size_t decoded_length;
+    int escaped = 0;
+
+    switch(c)
+    {
+        case '"':
+            return json_scan_string(parser, &decoded_length, &escaped);
+
+        case 't':
+        case 'f':
+        case 'n':
+        {
+            const char *literal = c == 't' ? "true" : c == 'f' ? "false" : "null";
+            size_t len = strlen(literal);
+
+            if(parser->pos + len > parser->length || strncmp(parser->json + parser->pos, literal, len))
+            {
+                json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
+                return -1;
+            }
+
+            parser->pos += len;
+            return 0;
+        }
+
+        default:
+            if(JSON_IS_CHAR(c, JSON_CHAR_NUMBER))
+            {
+                json_number_t num;
+                const char *p = json_scan_number(parser->json + parser->pos, parser->json + parser->length, &num);
+
+                if(!p)
+                {
+                    json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
+                    return -1;
+                }
+
+                parser->pos = (size_t)(p - parser->json);
+                return 0;
+            }
+            else
+            {
+                json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
+                return -1;
+            }
+    }
+}
+
+static int json_validate_document(json_parser_t *parser, uint64_t *inline_bits)
+{
+    uint64_t *bits = inline_bits;
+    size_t bit_cap = JSON_VALIDATE_INLINE_DEPTH;
+    json_expect_t expect = JSON_EXPECT_VALUE;
+    size_t depth = 0;
+    int result = -1;
+
+    for(;;)
+    {
+        json_validate_skip_whitespace(parser);
+
+        if(expect == JSON_EXPECT_NEXT && depth == 0)
+        {
+            result = 0;
+            break;
+        }
+
+        if(parser->pos >= parser->length)
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            break;
+        }
+
+        char c = parser->json[parser->pos];
+
+        if(expect == JSON_EXPECT_VALUE)
+        {
+            expect = JSON_EXPECT_NEXT;
+
+            if(c == '{' || c == '[')
+            {
+                if(depth >= parser->max_depth)
+                {
+                    json_set_error(parser, JSON_ERROR_NESTING_DEPTH);
+                    break;
+                }
+
+                if(depth == bit_cap)
+                {
+                    // Deeper than the inline stack allows: move the bits to the heap
+                    uint64_t *grown = JSON_MALLOC(bit_cap / 4);
+
+                    if(!grown)
+                    {
+                        json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+                        break;
+                    }
+
+                    memcpy(grown, bits, bit_cap / 8);
+
+                    if(bits != inline_bits)
+                    {
+                        JSON_FREE(bits);
+                    }
+
+                    bits = grown;
+                    bit_cap *= 2;
+                }
+
+                uint64_t mask = (uint64_t)1 << (depth % 64);
+                bits[depth / 64] = c == '{' ? bits[depth / 64] | mask : bits[depth / 64] & ~mask;
+                depth++;
+                parser->pos++;
+                expect = c == '{' ? JSON_EXPECT_MEMBER : JSON_EXPECT_ELEMENT;
+                continue;
+            }
+
+            if(json_validate_scalar(parser, c))
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        int object = (bits[(depth - 1) / 64] >> ((depth - 1) % 64)) & 1;
+
+        if(expect == JSON_EXPECT_MEMBER || expect == JSON_EXPECT_ELEMENT)
+        {
+            if(c == (object ? '}' : ']'))
+            {
+                depth--;
+                parser->pos++;
+                expect = JSON_EXPECT_NEXT;
+                continue;
+            }
+
+            if(expect == JSON_EXPECT_ELEMENT)
+            {
+                expect = JSON_EXPECT_VALUE;
+                continue;
+            }
+
+            size_t decoded_length;
+            int escaped = 0;
+
+            if(c != '"')
+            {
+                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                break;
+            }
+
+            if(json_scan_string(parser, &decoded_length, &escaped))
+            {
+                break;
+            }
+
+            json_validate_skip_whitespace(parser);
+
+            if(parser->pos >= parser->length || parser->json[parser->pos++] != ':')
+            {
+                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                break;
+            }
+
+            expect = JSON_EXPECT_VALUE;
+            continue;
+        }
+
+        // JSON_EXPECT_NEXT inside a container
+        if(c == (object ? '}' : ']'))
+        {
+            depth--;
+            parser->pos++;
+            continue;
+        }
+
+        if(c != ',')
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            break;
+        }
+
+        parser->pos++;
+        expect = object ? JSON_EXPECT_MEMBER : JSON_EXPECT_VALUE;
+#ifndef JSON_STRICT
+
+        if(object)
+        {
+            continue;
+        }
+
+#endif
+        json_validate_skip_whitespace(parser);
+
+        if(parser->pos < parser->length && parser->json[parser->pos] == (object ? '}' : ']'))
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            break;
+        }
+    }
+
+    if(bits != inline_bits)
+    {
+        JSON_FREE(bits);
+    }
+
+    return result;
+}
+
+json_error_t json_validate(const char *json, size_t length, size_t max_depth, size_t max_string, size_t *error_pos)
+{
+    json_parser_t parser;
+    uint64_t bits[JSON_VALIDATE_INLINE_DEPTH / 64];
+    memset(&parser, 0, sizeof(parser));
+    parser.json = json;
+    parser.length = length;
+    parser.max_depth = max_depth;
+    parser.max_string = max_string;
+    json_validate_skip_whitespace(&parser);
+
+    if(parser.pos >= parser.length)
+    {
+        json_set_error(&parser, JSON_ERROR_EMPTY_INPUT);
+    }
+    else if(json_validate_document(&parser, bits) == 0)
+    {
+        json_validate_skip_whitespace(&parser);
+
+        if(parser.pos != parser.length)
+        {
+            json_set_error(&parser, JSON_ERROR_TRAILING_CHARS);
+        }
+    }
+
+    if(error_pos)
+    {
+        *error_pos = parser.error == JSON_ERROR_NONE ? 0 : parser.pos;
+    }
+
+    return parser.error;
+}
+
+// Struct binding. json_bind runs the validator's grammar over one object and, for every
+// key in the schema, converts the value straight into the target struct. Nothing is
+// tokenized; values of unknown keys are validated and skipped like json_validate does.
+json_error_t json_schema_compile(json_schema_t *schema, const json_field_t *fields, size_t count)
+{
+    memset(schema, 0, sizeof(*schema));
+    size_t capacity = 4;
+
+    while(capacity < count * 2)
+    {
+        capacity *= 2;
+    }
+
+    for(size_t i = 0; i < count; i++)
+    {
+        const json_field_t *field = &fields[i];
+        size_t size = field->size;
+        int valid;
+
+        switch(field->type)
+        {
+            case JSON_FIELD_INT:
+            case JSON_FIELD_UINT:
+            case JSON_FIELD_BOOL:
+                valid = size == 1 || size == 2 || size == 4 || size == 8;
+                break;
+#ifndef JSON_NO_FLOAT
+
+            case JSON_FIELD_DOUBLE:
+                valid = size == sizeof(float) || size == sizeof(double);
+                break;
+#endif
+
+            case JSON_FIELD_STRING:
+                valid = size > 0;
+                break;
+
+            case JSON_FIELD_OBJECT:
+                valid = field->schema && field->schema->slots;
+                break;
+
+            default:
+                valid = 0;
+                break;
+        }
+
+        if(!valid)
+        {
+            return JSON_ERROR_TYPE_MISMATCH;
+        }
+    }
+
+    uint32_t *slots = JSON_CALLOC(capacity * 3, sizeof(uint32_t));
+
+    if(!slots)
+    {
+        return JSON_ERROR_ALLOCATION_FAILED;
+    }
+
+    schema->fields = fields;
+    schema->count = count;
+    schema->slots = slots;
+    schema->mask = (uint32_t)capacity - 1;
+    schema->max_depth = JSON_DEFAULT_MAX_DEPTH;
+    schema->max_string = SIZE_MAX;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        size_t length = strlen(fields[i].key);
+        uint32_t hash = json_hash_key(fields[i].key, length);
+        uint32_t slot = hash & schema->mask;
+
+        // A duplicate key lands behind the first one and is never found
+        while(slots[slot * 3 + 1])
+        {
+            slot = (slot + 1) & schema->mask;
+        }
+
+        slots[slot * 3] = hash;
+        slots[slot * 3 + 1] = (uint32_t)i + 1;
+        slots[slot * 3 + 2] = (uint32_t)length;
+        schema->max_key = length > schema->max_key ? length : schema->max_key;
+    }
+
+    return JSON_ERROR_NONE;
+}
+
+void json_schema_free(json_schema_t *schema)
+{
+    JSON_FREE(schema->slots);
+    memset(schema, 0, sizeof(*schema));
+}
+
+static const json_field_t *json_schema_find(const json_schema_t *schema, const char *key, size_t length)
+{
+    uint32_t hash = json_hash_key(key, length);
+    uint32_t slot = hash & schema->mask;
+
+    while(schema->slots[slot * 3 + 1])
+    {
+        const json_field_t *field = &schema->fields[schema->slots[slot * 3 + 1] - 1];
+
+        if(schema->slots[slot * 3] == hash && schema->slots[slot * 3 + 2] == length && memcmp(field->key, key, length) == 0)
+        {
+            return field;
+        }
+
+        slot = (slot + 1) & schema->mask;
+    }
+
+    return NULL;
+}
+
+// Looks up the key whose body is json[start, parser->pos - 1), decoding it first if escaped
+static const json_field_t *json_bind_key(json_parser_t *parser, const json_schema_t *schema, size_t start, size_t decoded_length, int escaped)
+{
+    const char *raw = parser->json + start;
+
+    if(decoded_length > schema->max_key)
+    {
+        return NULL;
+    }
+
+    if(!escaped)
+    {
+        return json_schema_find(schema, raw, decoded_length);
+    }
+
+    char inline_key[128];
+    char *key = decoded_length < sizeof(inline_key) ? inline_key : JSON_MALLOC(decoded_length + 1);
+
+    if(!key)
+    {
+        json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+        return NULL;
+    }
+
+    json_decode_string(raw, parser->pos - 1 - start, key);
+    const json_field_t *field = json_schema_find(schema, key, decoded_length);
+
+    if(key != inline_key)
+    {
+        JSON_FREE(key);
+    }
+
+    return field;
+}
+
+static int json_bind_store_int(char *dst, size_t size, int64_t value)
+{
+    switch(size)
+    {
+        case 1:
+        {
+            int8_t v = (int8_t)value;
+
+            if(v != value)
+            {
+                return -1;
+            }
+
+            memcpy(dst, &v, 1);
+            return 0;
+        }
+
+        case 2:
+        {
+            int16_t v = (int16_t)value;
+
+            if(v != value)
+            {
+                return -1;
+            }
+
+            memcpy(dst, &v, 2);
+            return 0;
+        }
+
+        case 4:
+        {
+            int32_t v = (int32_t)value;
+
+            if(v != value)
+            {
+                return -1;
+            }
+
+            memcpy(dst, &v, 4);
+            return 0;
+        }
+
+        default:
+            memcpy(dst, &value, 8);
+            return 0;
+    }
+}
+
+static int json_bind_store_uint(char *dst, size_t size, uint64_t value)
+{
+    switch(size)
+    {
+        case 1:
+        {
+            uint8_t v = (uint8_t)value;
+
+            if(v != value)
+            {
+                return -1;
+            }
+
+            memcpy(dst, &v, 1);
+            return 0;
+        }
+
+        case 2:
+        {
+            uint16_t v = (uint16_t)value;
+
+            if(v != value)
+            {
+                return -1;
+            }
+
+            memcpy(dst, &v, 2);
+            return 0;
+        }
+
+        case 4:
+        {
+            uint32_t v = (uint32_t)value;
+
+            if(v != value)
+            {
+                return -1;
+            }
+
+            memcpy(dst, &v, 4);
+            return 0;
+        }
+
+        default:
+            memcpy(dst, &value, 8);
+            return 0;
+    }
+}
+
+static int json_bind_number(json_parser_t *parser, const json_field_t *field, char *dst)
+{
+    const char *start = parser->json + parser->pos;
+    json_number_t num;
+    const char *p = json_scan_number(start, parser->json + parser->length, &num);
+
+    if(!p)
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
+        return -1;
+    }
+
+    json_token_t number;
+    memset(&number, 0, sizeof(number));
+    json_number_store(parser, &num, start, p, &number);
+    int stored;
+
+    if(field->type == JSON_FIELD_INT)
+    {
+        int64_t value;
+        stored = json_number_get_integer(&number, &value, NULL) == JSON_ERROR_NONE && json_bind_store_int(dst, field->size, value) == 0;
+    }
+    else if(field->type == JSON_FIELD_UINT)
+    {
+        uint64_t value;
+        stored = json_number_get_integer(&number, NULL, &value) == JSON_ERROR_NONE && json_bind_store_uint(dst, field->size, value) == 0;
+    }
+    else
+    {
+#ifdef JSON_NO_FLOAT
+        stored = 0;
+#else
+        double value = number.flags & JSON_TOKEN_FLAG_UNSIGNED ? (double)number.value.uinteger :
+                       number.flags & JSON_TOKEN_FLAG_INTEGER ? (double)number.value.integer : number.value.number;
+
+        if(field->size == sizeof(float))
+        {
+            float narrow = (float)value;
+            memcpy(dst, &narrow, sizeof(narrow));
+        }
+        else
+        {
+            memcpy(dst, &value, sizeof(value));
+        }
+
+        stored = 1;
+#endif
+    }
+
+    if(!stored)
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
+        return -1;
+    }
+
+    parser->pos = (size_t)(p - parser->json);
+    return 0;
+}
+
+static int json_bind_object(json_parser_t *parser, const json_schema_t *schema, char *target, size_t depth, uint64_t *bits);
+
+// Converts the value at parser->pos into its member. A null leaves the member as it was.
+static int json_bind_value(json_parser_t *parser, const json_field_t *field, char *target, size_t depth, uint64_t *bits)
+{
+    char c = parser->json[parser->pos];
+    char *dst = target + field->offset;
+
+    if(c == 'n')
+    {
+        return json_validate_scalar(parser, c);
+    }
+
+    switch(field->type)
+    {
+        case JSON_FIELD_INT:
+        case JSON_FIELD_UINT:
+        case JSON_FIELD_DOUBLE:
+            if(JSON_IS_CHAR(c, JSON_CHAR_NUMBER))
+            {
+                return json_bind_number(parser, field, dst);
+            }
+
+            break;
+
+        case JSON_FIELD_BOOL:
+            if(c == 't' || c == 'f')
+            {
+                if(json_validate_scalar(parser, c))
+                {
+                    return -1;
+                }
+
+                json_bind_store_uint(dst, field->size, c == 't');
+                return 0;
+            }
+
+            break;
+
+        case JSON_FIELD_STRING:
+            if(c == '"')
+            {
+                // The member's buffer is the only bound on its value, NUL included
+                size_t start = parser->pos + 1;
+                size_t decoded_length;
+                int escaped = 0;
+                size_t max_string = parser->max_string;
+                parser->max_string = field->size;
+                int scanned = json_scan_string(parser, &decoded_length, &escaped);
+                parser->max_string = max_string;
+
+                if(scanned)
+                {
+                    if(parser->error == JSON_ERROR_STRING_TOO_LONG)
+                    {
+                        parser->pos = start - 1;
+                    }
+
+                    return -1;
+                }
+
+                if(escaped)
+                {
+                    json_decode_string(parser->json + start, parser->pos - 1 - start, dst);
+                }
+                else
+                {
+                    memcpy(dst, parser->json + start, decoded_length);
+                    dst[decoded_length] = '\0';
+                }
+
+                return 0;
+            }
+
+            break;
+
+        case JSON_FIELD_OBJECT:
+            if(c == '{')
+            {
+                return json_bind_object(parser, field->schema, dst, depth, bits);
+            }
+
+            break;
+    }
+
+    // Values of the wrong kind are still checked, within the nesting that is left, so a broken
+    // document is reported as such
+    size_t pos = parser->pos;
+    size_t max_depth = parser->max_depth;
+    parser->max_depth -= depth;
+    int skipped = json_validate_document(parser, bits);
+    parser->max_depth = max_depth;
+
+    if(skipped == 0)
+    {
+        parser->pos = pos;
+        json_set_error(parser, JSON_ERROR_TYPE_MISMATCH);
+    }
+
+    return -1;
+}
+
+// Binds the members of the object at parser->pos. `seen` has one bit per schema field that
+// is set once the field is bound: later duplicates are only validated, so the first one wins
+// as in json_object_find.
+static int json_bind_members(json_parser_t *parser, const json_schema_t *schema, char *target, size_t depth, uint64_t *bits, uint64_t *seen)
+{
+    parser->pos++; // Skip '{'
+    json_validate_skip_whitespace(parser);
+
+    if(parser->pos < parser->length && parser->json[parser->pos] == '}')
+    {
+        parser->pos++;
+        return 0;
+    }
+
+    for(;;)
+    {
+        if(parser->pos >= parser->length || parser->json[parser->pos] != '"')
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            return -1;
+        }
+
+        size_t start = parser->pos + 1;
+        size_t decoded_length;
+        int escaped = 0;
+
+        if(json_scan_string(parser, &decoded_length, &escaped))
+        {
+            return -1;
+        }
+
+        const json_field_t *field = json_bind_key(parser, schema, start, decoded_length, escaped);
+
+        if(parser->error != JSON_ERROR_NONE)
+        {
+            return -1;
+        }
+
+        if(field)
+        {
+            size_t index = (size_t)(field - schema->fields);
+
+            if(seen[index / 64] & ((uint64_t)1 << (index % 64)))
+            {
+                field = NULL;
+            }
+
+            seen[index / 64] |= (uint64_t)1 << (index % 64);
+        }
+
+        json_validate_skip_whitespace(parser);
+
+        if(parser->pos >= parser->length || parser->json[parser->pos++] != ':')
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            return -1;
+        }
+
+        json_validate_skip_whitespace(parser);
+
+        if(parser->pos >= parser->length)
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            return -1;
+        }
+
+        if(field)
+        {
+            if(json_bind_value(parser, field, target, depth + 1, bits))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            // Unknown or repeated member: validated within the nesting that is left, never stored
+            size_t max_depth = parser->max_depth;
+            parser->max_depth -= depth + 1;
+            int skipped = json_validate_document(parser, bits);
+            parser->max_depth = max_depth;
+
+            if(skipped)
+            {
+                return -1;
+            }
+        }
+
+        json_validate_skip_whitespace(parser);
+
+        if(parser->pos < parser->length && parser->json[parser->pos] == '}')
+        {
+            parser->pos++;
+            return 0;
+        }
+
+        if(parser->pos >= parser->length || parser->json[parser->pos] != ',')
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            return -1;
+        }
+
+        parser->pos++;
+        json_validate_skip_whitespace(parser);
+#ifndef JSON_STRICT
+
+        // A trailing comma before '}' is tolerated, as in json_parser_parse
+        if(parser->pos < parser->length && parser->json[parser->pos] == '}')
+        {
+            parser->pos++;
+            return 0;
+        }
+
+#endif
+    }
+}
+
+// Binds the object at parser->pos; `depth` containers are open around it
+static int json_bind_object(json_parser_t *parser, const json_schema_t *schema, char *target, size_t depth, uint64_t *bits)
+{
+    if(depth >= parser->max_depth)
+    {
+        json_set_error(parser, JSON_ERROR_NESTING_DEPTH);
+        return -1;
+    }
+
+    uint64_t inline_seen[4] = {0};
+    uint64_t *seen = inline_seen;
+
+    if(schema->count > sizeof(inline_seen) * 8)
+    {
+        seen = JSON_CALLOC((schema->count + 63) / 64, sizeof(uint64_t));
+
+        if(!seen)
+        {
+            json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+            return -1;
+        }
+    }
+
+    int result = json_bind_members(parser, schema, target, depth, bits, seen);
+
+    if(seen != inline_seen)
+    {
+        JSON_FREE(seen);
+    }
+
+    return result;
+}
+
+json_error_t json_bind(const json_schema_t *schema, const char *json, size_t length, void *target, size_t *error_pos)
+{
+    json_parser_t parser;
+    uint64_t bits[JSON_VALIDATE_INLINE_DEPTH / 64];
+    memset(&parser, 0, sizeof(parser));
+    parser.json = json;
+    parser.length = length;
+    parser.max_depth = schema->max_depth;
+    parser.max_string = schema->max_string;
+    parser.flags = JSON_FLAG_INTEGERS; // 64-bit members get every digit
+    json_validate_skip_whitespace(&parser);
+
+    if(parser.pos >= parser.length)
+    {
+        json_set_error(&parser, JSON_ERROR_EMPTY_INPUT);
+    }
+    else if(parser.json[parser.pos] != '{')
+    {
+        json_set_error(&parser, JSON_ERROR_TYPE_MISMATCH);
+    }
+    else if(json_bind_object(&parser, schema, target, 0, bits) == 0)
+    {
+        json_validate_skip_whitespace(&parser);
+
+        if(parser.pos != parser.length)
+        {
+            json_set_error(&parser, JSON_ERROR_TRAILING_CHARS);
+        }
+    }
+
+    if(error_pos)
+    {
+        *error_pos = parser.error == JSON_ERROR_NONE ? 0 : parser.pos;
+    }
+
+    return parser.error;
+}
+
+// Push parser state. The core parser above needs the whole document, so chunked
+// input is driven through an explicit state machine with its own container stack.
+typedef enum
+{
+    JSON_STREAM_VALUE,        // A value is expected
+    JSON_STREAM_ARRAY_FIRST,  // After '[': a value or ']'
+    JSON_STREAM_OBJECT_FIRST, // After '{': a key or '}'
+    JSON_STREAM_KEY,          // After ',' in an object: a key or '}'
+    JSON_STREAM_COLON,        // After a key
+    JSON_STREAM_AFTER_VALUE,  // ',' or the closing bracket
+    JSON_STREAM_STRING,
+    JSON_STREAM_ESCAPE,
+    JSON_STREAM_UNICODE,
+    JSON_STREAM_NUMBER,
+    JSON_STREAM_LITERAL,
+    JSON_STREAM_DONE
+} json_stream_state_t;
+
+struct json_stream
+{
+    json_stream_state_t state;
+    size_t offset;         // Stream position of the current chunk
+    size_t *stack;         // Token indices of the open containers
+    size_t top;
+    size_t stack_cap;
+    char *scratch;         // Decoded string bytes or number text carried across chunks
+    size_t scratch_length;
+    size_t scratch_cap;
+    char escape[10];       // "XXXX" of a \u escape, then "\uXXXX" for a low surrogate
+    size_t escape_length;
+    const char *literal;
+    json_token_type_t literal_type;
+    size_t value_start;
+    int key;               // The string being read is an object key
+};
+
+static void json_stream_release(json_parser_t *parser)
+{
+    if(parser->stream)
+    {
+        JSON_FREE(parser->stream->stack);
+        JSON_FREE(parser->stream->scratch);
+        JSON_FREE(parser->stream);
+        parser->stream = NULL;
+    }
+}
+
+static int json_stream_append(json_parser_t *parser, const char *bytes, size_t length)
+{
+    struct json_stream *s = parser->stream;
+
+    if(s->state != JSON_STREAM_NUMBER && s->scratch_length + length > parser->max_string - 1)
+    {
+        json_set_error(parser, JSON_ERROR_STRING_TOO_LONG);
+        return -1;
+    }
+
+    if(s->scratch_length + length > s->scratch_cap)
+    {
+        size_t cap = s->scratch_cap ? s->scratch_cap : 64;
+
+        while(cap < s->scratch_length + length)
+        {
+            cap *= 2;
+        }
+
+        char *scratch = JSON_REALLOC(s->scratch, cap);
+
+        if(!scratch)
+        {
+            json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+            return -1;
+        }
+
+        s->scratch = scratch;
+        s->scratch_cap = cap;
+    }
+
+    memcpy(s->scratch + s->scratch_length, bytes, length);
+    s->scratch_length += length;
+    return 0;
+}
+
+static void json_stream_value_done(json_parser_t *parser)
+{
+    struct json_stream *s = parser->stream;
+
+    if(s->top == 0)
+    {
+        s->state = JSON_STREAM_DONE;
+        return;
+    }
+
+    parser->tokens[s->stack[s->top - 1]].size++;
+    s->state = JSON_STREAM_AFTER_VALUE;
+}
+
+static int json_stream_open(json_parser_t *parser, json_token_type_t type)
+{
+    struct json_stream *s = parser->stream;
+
+    if((size_t)parser->depth >= parser->max_depth || s->top >= s->stack_cap)
+    {
+        json_set_error(parser, JSON_ERROR_NESTING_DEPTH);
+        return -1;
+    }
+
+    if(json_add_token(parser, type))
+    {
+        return -1;
+    }
+
+    s->stack[s->top++] = parser->token_count - 1;
+    json_open_container(parser, parser->token_count - 1);
+    s->state = type == JSON_TOKEN_OBJECT ? JSON_STREAM_OBJECT_FIRST : JSON_STREAM_ARRAY_FIRST;
+    return 0;
+}
+
+static void json_stream_close(json_parser_t *parser)
+{
+    struct json_stream *s = parser->stream;
+    size_t index = s->stack[--s->top];
+    json_close_container(parser, index, s->top ? s->stack[s->top - 1] : JSON_TOKEN_NO_PARENT);
+    json_stream_value_done(parser);
+}
+
+static int json_stream_string_done(json_parser_t *parser)
+{
+    struct json_stream *s = parser->stream;
+    json_token_t *token = &parser->tokens[parser->token_count - 1];
+    // The scratch buffer is only allocated once a byte is appended, "" may arrive first
+    const char *bytes = s->scratch_length ? s->scratch : "";
+
+    if(s->key && (parser->flags & JSON_FLAG_INTERN_KEYS))
+    {
+        if(json_intern_token(parser, token, bytes, s->scratch_length))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        char *buffer = json_alloc_string(parser, s->scratch_length);
+
+        if(!buffer)
+        {
+            json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
+            return -1;
+        }
+
+        memcpy(buffer, bytes, s->scratch_length);
+        buffer[s->scratch_length] = '\0';
+        token->value.string = buffer;
+    }
+
+    token->end = parser->pos;
+
+    if(s->key)
+    {
+        s->state = JSON_STREAM_COLON;
+    }
+    else
+    {
+        json_stream_value_done(parser);
+    }
+
+    return 0;
+}
+
+static int json_stream_number_done(json_parser_t *parser)
+{
+    struct json_stream *s = parser->stream;
+    const char *start = s->scratch;
+    const char *stop = s->scratch + s->scratch_length;
+    json_number_t num;
+    const char *p = json_scan_number(start, stop, &num);
+
+    if(!p)
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
+        return -1;
+    }
+
+    if(p != stop)
+    {
+        // Same outcome as the contiguous parser, which stops the number early
+        json_set_error(parser, s->top ? JSON_ERROR_UNEXPECTED_CHAR : JSON_ERROR_TRAILING_CHARS);
+        return -1;
+    }
+
+    if(json_add_token(parser, JSON_TOKEN_NUMBER))
+    {
+        return -1;
+    }
+
+    json_token_t *token = &parser->tokens[parser->token_count - 1];
+    json_number_store(parser, &num, start, stop, token);
+    token->start = s->value_start;
+    token->end = s->value_start + s->scratch_length;
+    json_stream_value_done(parser);
+    return 0;
+}
+
+static int json_stream_unicode(json_parser_t *parser, char c)
+{
+#ifdef JSON_NO_UNICODE_ESCAPES
+    (void)c;
+    json_set_error(parser, JSON_ERROR_INVALID_UNICODE);
+    return -1;
+#else
+    struct json_stream *s = parser->stream;
+    unsigned int codepoint;
+    s->escape[s->escape_length++] = c;
+
+    if(s->escape_length == 4)
+    {
+        if(json_read_hex4(s->escape, &codepoint))
+        {
+            json_set_error(parser, JSON_ERROR_INVALID_UNICODE);
+            return -1;
+        }
+
+        if(codepoint >= 0xD800 && codepoint <= 0xDBFF)
+        {
+            return 0; // Wait for the low surrogate
+        }
+    }
+    else if((s->escape_length == 5 && c != '\\') || (s->escape_length == 6 && c != 'u'))
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_UNICODE);
+        return -1;
+    }
+    else if(s->escape_length < 10)
+    {
+        return 0;
+    }
+
+    char utf8[4];
+
+    if(json_parse_unicode_escape(s->escape, s->escape_length, &codepoint) < 0)
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_UNICODE);
+        return -1;
+    }
+
+    s->state = JSON_STREAM_STRING;
+    return json_stream_append(parser, utf8, json_utf8_encode(codepoint, utf8));
+#endif
+}
+
+static int json_stream_begin_value(json_parser_t *parser, char c)
+{
+    struct json_stream *s = parser->stream;
+    s->value_start = parser->pos;
+
+    switch(c)
+    {
+        case '{':
+            return json_stream_open(parser, JSON_TOKEN_OBJECT);
+
+        case '[':
+            return json_stream_open(parser, JSON_TOKEN_ARRAY);
+
+        case '"':
+            if(json_add_token(parser, JSON_TOKEN_STRING))
+            {
+                return -1;
+            }
+
+            parser->tokens[parser->token_count - 1].start = parser->pos + 1;
+            s->scratch_length = 0;
+            s->key = s->state == JSON_STREAM_OBJECT_FIRST || s->state == JSON_STREAM_KEY;
+            s->state = JSON_STREAM_STRING;
+            return 0;
+
+        case 't':
+            s->literal = "true";
+            s->literal_type = JSON_TOKEN_TRUE;
+            break;
+
+        case 'f':
+            s->literal = "false";
+            s->literal_type = JSON_TOKEN_FALSE;
+            break;
+
+        case 'n':
+            s->literal = "null";
+            s->literal_type = JSON_TOKEN_NULL;
+            break;
+
+        default:
+            if(JSON_IS_CHAR(c, JSON_CHAR_NUMBER))
+            {
+                s->scratch_length = 0;
+                s->state = JSON_STREAM_NUMBER;
+                return json_stream_append(parser, &c, 1);
+            }
+
+            json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
+            return -1;
+    }
+
+    s->literal++;
+    s->state = JSON_STREAM_LITERAL;
+    return 0;
+}
+
+// Consumes one byte, or a run of plain string bytes, starting at chunk[*i]
+static int json_stream_step(json_parser_t *parser, const char *chunk, size_t length, size_t *i)
+{
+    struct json_stream *s = parser->stream;
+    char c = chunk[*i];
+    parser->pos = s->offset + *i;
+
+    switch(s->state)
+    {
+        case JSON_STREAM_STRING:
+        {
+            const char *run = chunk + *i;
+            size_t run_length = (size_t)(json_find_string_special(run, chunk + length) - run);
+
+            if(run_length)
+            {
+                *i += run_length;
+                return json_stream_append(parser, run, run_length);
+            }
+
+            if((unsigned char)c < 0x20)
+            {
+                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                return -1;
+            }
+
+            (*i)++;
+
+            if(c == '\\')
+            {
+                s->state = JSON_STREAM_ESCAPE;
+                return 0;
+            }
+
+            return json_stream_string_done(parser);
+        }
+
+        case JSON_STREAM_ESCAPE:
+            (*i)++;
+
+            switch(c)
+            {
+                case '"':
+                case '\\':
+                case '/':
+                    break;
+
+                case 'b':
+                    c = '\b';
+                    break;
+
+                case 'f':
+                    c = '\f';
+                    break;
+
+                case 'n':
+                    c = '\n';
+                    break;
+
+                case 'r':
+                    c = '\r';
+                    break;
+
+                case 't':
+                    c = '\t';
+                    break;
+
+                case 'u':
+                    s->escape_length = 0;
+                    s->state = JSON_STREAM_UNICODE;
+                    return 0;
+
+                default:
+                    json_set_error(parser, JSON_ERROR_INVALID_ESCAPE);
+                    return -1;
+            }
+
+            s->state = JSON_STREAM_STRING;
+            return json_stream_append(parser, &c, 1);
+
+        case JSON_STREAM_UNICODE:
+            (*i)++;
+            return json_stream_unicode(parser, c);
+
+        case JSON_STREAM_NUMBER:
+            // A hexadecimal prefix is kept so that "0x" fails as a number, as in the core parser
+            if(JSON_IS_CHAR(c, JSON_CHAR_NUMBER) || c == '+' || c == 'e' || c == 'E' || c == 'x' || c == 'X')
+            {
+                (*i)++;
+                return json_stream_append(parser, &c, 1);
+            }
+
+            return json_stream_number_done(parser); // The delimiter is handled by the next state
+
+        case JSON_STREAM_LITERAL:
+            if(c != *s->literal)
+            {
+                json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
+                return -1;
+            }
+
+            (*i)++;
+
+            if(*++s->literal == '\0')
+            {
+                if(json_add_token(parser, s->literal_type))
+                {
+                    return -1;
+                }
+
+                parser->tokens[parser->token_count - 1].start = s->value_start;
+                parser->tokens[parser->token_count - 1].end = parser->pos + 1;
+                json_stream_value_done(parser);
+            }
+
+            return 0;
+
+        default:
+            break;
+    }
+
+    if(JSON_IS_WHITESPACE(c))
+    {
+        (*i)++;
+        return 0;
+    }
+
+    int in_object = s->top && parser->tokens[s->stack[s->top - 1]].type == JSON_TOKEN_OBJECT;
+
+    switch(s->state)
+    {
+        case JSON_STREAM_ARRAY_FIRST:
+        case JSON_STREAM_VALUE:
+            if(c == ']' && s->state == JSON_STREAM_ARRAY_FIRST)
+            {
+                (*i)++;
+                json_stream_close(parser);
+                return 0;
+            }
+
+            if(c == ']' && s->top && !in_object)
+            {
+                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                return -1;
+            }
+
+            (*i)++;
+            return json_stream_begin_value(parser, c);
+
+        case JSON_STREAM_OBJECT_FIRST:
+        case JSON_STREAM_KEY:
+#ifdef JSON_STRICT
+            if(c == '}' && s->state == JSON_STREAM_KEY)
+            {
+                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                return -1;
+            }
+
+#endif
+            (*i)++;
+
+            if(c == '}')
+            {
+                json_stream_close(parser);
+                return 0;
+            }
+
+            if(c != '"')
+            {
+                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                return -1;
+            }
+
+            return json_stream_begin_value(parser, c);
+
+        case JSON_STREAM_COLON:
+            (*i)++;
+
+            if(c != ':')
+            {
+                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                return -1;
+            }
+
+            s->state = JSON_STREAM_VALUE;
+            return 0;
+
+        case JSON_STREAM_AFTER_VALUE:
+            (*i)++;
+
+            if(c == ',')
+            {
+                s->state = in_object ? JSON_STREAM_KEY : JSON_STREAM_VALUE;
+                return 0;
+            }
+
+            if(c != (in_object ? '}' : ']'))
+            {
+                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+                return -1;
+            }
+
+            json_stream_close(parser);
+            return 0;
+
+        default:
+            json_set_error(parser, JSON_ERROR_TRAILING_CHARS);
+            return -1;
+    }
+}
+
+json_error_t json_parser_feed(json_parser_t *parser, const char *chunk, size_t length)
+{
+    if(parser->error != JSON_ERROR_NONE && parser->error != JSON_ERROR_NEED_MORE)
+    {
+        return parser->error;
+    }
+
+    parser->error = JSON_ERROR_NONE;
+
+    if(!parser->stream)
+    {
+        // Tokens are positioned in the stream, there is no contiguous input to point into
+        parser->stream = JSON_CALLOC(1, sizeof(struct json_stream));
+
+        if(parser->stream)
+        {
+            parser->stream->stack_cap = parser->max_depth;
+            parser->stream->stack = JSON_MALLOC((parser->max_depth + 1) * sizeof(size_t));
+        }
+
+        if(!parser->stream || !parser->stream->stack)
+        {
+            json_stream_release(parser);
+            parser->error = JSON_ERROR_ALLOCATION_FAILED;
+            return parser->error;
+        }
+
+        parser->json = NULL;
+        parser->length = 0;
+#ifdef JSON_PARENT_LINKS
+        parser->parent = JSON_TOKEN_NO_PARENT;
+#endif
+    }
+
+    size_t i = 0;
+
+    while(i < length)
+    {
+        if(json_stream_step(parser, chunk, length, &i))
+        {
+            return parser->error;
+        }
+    }
+
+    parser->stream->offset += length;
+    parser->pos = parser->stream->offset;
+    parser->error = parser->stream->state == JSON_STREAM_DONE ? JSON_ERROR_NONE : JSON_ERROR_NEED_MORE;
+    return parser->error;
+}
+
+json_error_t json_parser_finish(json_parser_t *parser)
+{
+    if(parser->error != JSON_ERROR_NONE && parser->error != JSON_ERROR_NEED_MORE)
+    {
+        return parser->error;
+    }
+
+    parser->error = JSON_ERROR_NONE;
+    struct json_stream *s = parser->stream;
+
+    if(!s || (s->state == JSON_STREAM_VALUE && parser->token_count == 0))
+    {
+        parser->error = JSON_ERROR_EMPTY_INPUT;
+        return parser->error;
+    }
+
+    // A root number only ends with the input, a truncated one inside a container still has
+    // to be checked to fail the way the core parser does
+    if(s->state == JSON_STREAM_NUMBER && json_stream_number_done(parser))
+    {
+        return parser->error;
+    }
+
+    // Input that ends inside an escape or a literal fails like the malformed value it is
+    if(s->state == JSON_STREAM_UNICODE)
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_UNICODE);
+    }
+    else if(s->state == JSON_STREAM_LITERAL)
+    {
+        json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
+    }
+    else if(s->state != JSON_STREAM_DONE)
+    {
+        json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+    }
+
+    return parser->error;
+}
+
+// Maps a callback result to the parser: 1 skips the coming value, -1 stops
+static int json_sax_action(json_parser_t *parser, json_sax_action_t action)
+{
+    if(action == JSON_SAX_STOP)
+    {
+        json_set_error(parser, JSON_ERROR_ABORTED);
+        return -1;
+    }
+
+    return action == JSON_SAX_SKIP;
+}
+
+// Decoded view of the string token at `index`; escaped strings go through the scratch buffer
+static const char *json_sax_string(json_parser_t *parser, size_t index, size_t *length)
+{
+    json_token_t *token = &parser->tokens[index];
+    *length = token->flags & JSON_TOKEN_FLAG_INTERNED ? json_intern_length(token->value.string) : token->end - token->start;
+
+    if(!(token->flags & JSON_TOKEN_FLAG_ESCAPED))
+    {
+        return token->value.string;
+    }
+
+    if(!json_reserve_scratch(parser, *length + 1))
+    {
+        return NULL;
+    }
+
+    *length = json_decode_string(token->value.string, *length, parser->scratch);
+    return parser->scratch;
+}
+
+static int json_sax_key(json_parser_t *parser)
+{
+    const json_sax_handler_t *sax = parser->sax;
+    int result = 0;
+    parser->token_count--;
+
+    if(!parser->sax_muted && sax->on_key)
+    {
+        size_t length;
+        const char *key = json_sax_string(parser, parser->token_count, &length);
+        result = key ? json_sax_action(parser, sax->on_key(parser->sax_user, key, length)) : -1;
+    }
+
+    parser->sax_skip_next = result > 0;
+    return result < 0 ? -1 : 0;
+}
+
+// Reports the value that was just parsed as token `index`
+static int json_sax_emit(json_parser_t *parser, size_t index)
+{
+    const json_sax_handler_t *sax = parser->sax;
+    const json_token_t *token = &parser->tokens[index];
+    json_sax_action_t action = JSON_SAX_CONTINUE;
+
+    switch(token->type)
+    {
+        case JSON_TOKEN_OBJECT:
+            action = sax->on_object_end ? sax->on_object_end(parser->sax_user) : action;
+            break;
+
+        case JSON_TOKEN_ARRAY:
+            action = sax->on_array_end ? sax->on_array_end(parser->sax_user) : action;
+            break;
+
+        case JSON_TOKEN_STRING:
+            if(sax->on_string)
+            {
+                size_t length;
+                const char *value = json_sax_string(parser, index, &length);
+
+                if(!value)
+                {
+                    return -1;
+                }
+
+                action = sax->on_string(parser->sax_user, value, length);
+            }
+
+            break;
+
+        case JSON_TOKEN_NUMBER:
+            action = sax->on_number ? sax->on_number(parser->sax_user, token) : action;
+            break;
+
+        case JSON_TOKEN_TRUE:
+        case JSON_TOKEN_FALSE:
+            action = sax->on_boolean ? sax->on_boolean(parser->sax_user, token->type == JSON_TOKEN_TRUE) : action;
+            break;
+
+        case JSON_TOKEN_NULL:
+            action = sax->on_null ? sax->on_null(parser->sax_user) : action;
+            break;
+
+        default:
+            break;
+    }
+
+    return json_sax_action(parser, action) < 0 ? -1 : 0;
+}
+
+// Decides before a value is parsed whether its events are reported. The returned state
+// tells json_sax_leave whether the value was muted by an enclosing skip or skipped itself.
+static int json_sax_enter(json_parser_t *parser, char c, unsigned int *state)
+{
+    const json_sax_handler_t *sax = parser->sax;
+    int muted = parser->sax_muted;
+    int skip = parser->sax_skip_next;
+    parser->sax_skip_next = 0;
+
+    if(!muted && !skip)
+    {
+        if(c == '{' && sax->on_object_begin)
+        {
+            skip = json_sax_action(parser, sax->on_object_begin(parser->sax_user));
+        }
+        else if(c == '[' && sax->on_array_begin)
+        {
+            skip = json_sax_action(parser, sax->on_array_begin(parser->sax_user));
+        }
+
+        if(skip < 0)
+        {
+            return -1;
+        }
+    }
+
+    *state = (muted ? 1u : 0u) | (skip ? 2u : 0u);
+    parser->sax_muted = muted || skip;
+    return 0;
+}
+
+// Reports the value that was parsed as token `index`, then drops its tokens:
+// they only live while their value is open, so the array never holds more than the current path
+static int json_sax_leave(json_parser_t *parser, size_t index, unsigned int state)
+{
+    parser->sax_muted = state & 1u;
+    int result = state ? 0 : json_sax_emit(parser, index);
+    parser->token_count = index;
+    return result;
+}
+
+json_error_t json_parser_parse_sax(json_parser_t *parser, const json_sax_handler_t *handler, void *user)
+{
+    // Strings are reported straight from the input and numbers are converted eagerly;
+    // a pre-scan would size the token array for the whole document, which SAX never needs
+    unsigned int flags = parser->flags;
+    parser->flags = (flags & ~(JSON_FLAG_PRESCAN | JSON_FLAG_LAZY_NUMBERS | JSON_FLAG_OBJECT_INDEX)) | JSON_FLAG_ZERO_COPY;
+    parser->sax = handler;
+    parser->sax_user = user;
+    parser->sax_muted = 0;
+    parser->sax_skip_next = 0;
+    json_error_t error = json_parser_parse(parser);
+    parser->sax = NULL;
+    parser->sax_user = NULL;
+    parser->flags = flags;
+
+    if(error == JSON_ERROR_NONE && handler->on_end)
+    {
+        handler->on_end(user);
+    }
+
+    return error;
+}
+
+// Reference tokens "0" or "[1-9][0-9]*" address array elements
+static size_t json_path_array_index(const char *name, size_t length)
+{
+    size_t index = 0;
+
+    if(length == 0 || (length > 1 && name[0] == '0'))
+    {
+        return SIZE_MAX;
+    }
+
+    for(size_t i = 0; i < length; i++)
+    {
+        if(!JSON_IS_CHAR(name[i], JSON_CHAR_DIGIT) || index > (SIZE_MAX - 10) / 10)
+        {
+            return SIZE_MAX;
+        }
+
+        index = index * 10 + (size_t)(name[i] - '0');
+    }
+
+    return index;
+}
+
+json_error_t json_path_compile(json_path_t *path, const char *pointer, size_t length)
+{
+    memset(path, 0, sizeof(*path));
+
+    if(length > 0 && pointer[0] != '/')
+    {
+        return JSON_ERROR_INVALID_TOKEN;
+    }
+
+    size_t count = 0;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        count += pointer[i] == '/';
+    }
+
+    // Segments and their decoded names share one block
+    char *block = JSON_MALLOC(count * sizeof(json_path_segment_t) + length + 1);
+
+    if(!block)
+    {
+        return JSON_ERROR_ALLOCATION_FAILED;
+    }
+
+    path->segments = (json_path_segment_t *)block;
+    char *names = block + count * sizeof(json_path_segment_t);
+    size_t i = 0;
+
+    while(i < length)
+    {
+        json_path_segment_t *segment = &path->segments[path->count++];
+        segment->name = names;
+        i++; // Skip '/'
+
+        while(i < length && pointer[i] != '/')
+        {
+            char c = pointer[i++];
+
+            if(c == '~')
+            {
+                if(i >= length || (pointer[i] != '0' && pointer[i] != '1'))
+                {
+                    json_path_free(path);
+                    return JSON_ERROR_INVALID_ESCAPE;
+                }
+
+                c = pointer[i++] == '0' ? '~' : '/';
+            }
+
+            *names++ = c;
+        }
+
+        segment->length = names - segment->name;
+        segment->index = json_path_array_index(segment->name, segment->length);
+        segment->wildcard = segment->length == 1 && segment->name[0] == '*';
+        path->wildcard |= segment->wildcard;
+    }
+
+    return JSON_ERROR_NONE;
+}
+
+void json_path_free(json_path_t *path)
+{
+    JSON_FREE(path->segments);
+    memset(path, 0, sizeof(*path));
+}
+
+typedef struct
+{
+    const char *json;
+    size_t length;
+    size_t pos;
+    const json_path_t *path;
+    json_path_match_t *matches;
+    size_t max_matches;
+    size_t count;
+    json_error_t error;
+    int open_only; // Stop at the first byte of the first match without skipping it
+} json_query_t;
+
+// Compares a raw (still escaped) key from the input with a decoded reference token
+static int json_path_key_equals(const char *raw, size_t raw_length, const char *name, size_t length)
+{
+    if(!memchr(raw, '\\', raw_length))
+    {
+        return raw_length == length && memcmp(raw, name, length) == 0;
+    }
+
+    size_t i = 0;
+    size_t j = 0;
+
+    while(i < raw_length)
+    {
+        char decoded[4];
+        size_t n = 1;
+        decoded[0] = raw[i++];
+
+        if(decoded[0] == '\\' && i < raw_length)
+        {
+            char c = raw[i++];
+
+            switch(c)
+            {
+                case 'b':
+                    c = '\b';
+                    break;
+
+                case 'f':
+                    c = '\f';
+                    break;
+
+                case 'n':
+                    c = '\n';
+                    break;
+
+                case 'r':
+                    c = '\r';
+                    break;
+
+                case 't':
+                    c = '\t';
+                    break;
+
+                case 'u':
+                {
+#ifdef JSON_NO_UNICODE_ESCAPES
+                    return 0;
+#else
+                    unsigned int codepoint;
+                    int used = json_parse_unicode_escape(raw + i, raw_length - i, &codepoint);
+
+                    if(used < 0)
+                    {
+                        return 0;
+                    }
+
+                    i += used;
+                    n = json_utf8_encode(codepoint, decoded);
+                    c = decoded[0];
+                    break;
+#endif
+                }
+
+                default:
+                    break;
+            }
+
+            decoded[0] = c;
+        }
+
+        if(j + n > length || memcmp(name + j, decoded, n) != 0)
+        {
+            return 0;
+        }
+
+        j += n;
+    }
+
+    return j == length;
+}
+
+static void json_query_skip_whitespace(json_query_t *q)
+{
+    while(q->pos < q->length && JSON_IS_WHITESPACE(q->json[q->pos]))
+    {
+        q->pos++;
+    }
+}
+
+static int json_query_fail(json_query_t *q)
+{
+    q->error = JSON_ERROR_UNEXPECTED_CHAR;
+    return -1;
+}
+
+// Moves past the string opening at q->pos; quotes preceded by an odd backslash run are escaped
+static int json_query_skip_string(json_query_t *q)
+{
+    size_t pos = q->pos + 1;
+
+    for(;;)
+    {
+        const char *quote = pos < q->length ? memchr(q->json + pos, '"', q->length - pos) : NULL;
+
+        if(!quote)
+        {
+            return json_query_fail(q);
+        }
+
+        size_t end = quote - q->json;
+        size_t backslashes = 0;
+
+        while(end - backslashes > pos && q->json[end - backslashes - 1] == '\\')
+        {
+            backslashes++;
+        }
+
+        pos = end + 1;
+
+        if(!(backslashes & 1))
+        {
+            q->pos = pos;
+            return 0;
+        }
+    }
+}
+
+// Skips one value without validating its contents
+static int json_query_skip_value(json_query_t *q)
+{
+    // 1: bytes that matter inside a container, 2: bytes that end a scalar
+    static const unsigned char classes[256] =
+    {
+        ['"'] = 1, ['{'] = 1, ['['] = 1, ['}'] = 3, [']'] = 3,
+        [','] = 2, [' '] = 2, ['\t'] = 2, ['\n'] = 2, ['\r'] = 2
+    };
+    char c = q->json[q->pos];
+
+    if(c == '"')
+    {
+        return json_query_skip_string(q);
+    }
+
+    if(c != '{' && c != '[')
+    {
+        size_t start = q->pos;
+
+        while(q->pos < q->length && !(classes[(unsigned char)q->json[q->pos]] & 2))
+        {
+            q->pos++;
+        }
+
+        return q->pos == start ? json_query_fail(q) : 0;
+    }
+
+    size_t depth = 0;
+
+    while(q->pos < q->length)
+    {
+        while(q->pos < q->length && !(classes[(unsigned char)q->json[q->pos]] & 1))
+        {
+            q->pos++;
+        }
+
+        if(q->pos >= q->length)
+        {
+            break;
+        }
+
+        c = q->json[q->pos];
+
+        if(c == '"')
+        {
+            if(json_query_skip_string(q))
+            {
+                return -1;
+            }
+
+            continue;
+        }
+
+        q->pos++;
+
+        if(c == '{' || c == '[')
+        {
+            depth++;
+        }
+        else if(--depth == 0)
+        {
+            return 0;
+        }
+    }
+
+    return json_query_fail(q);
+}
+
+// Returns 0 to keep scanning, 1 once enough matches were found and -1 on malformed input
+static int json_query_value(json_query_t *q, size_t depth)
+{
+    json_query_skip_whitespace(q);
+
+    if(q->pos >= q->length)
+    {
+        return json_query_fail(q);
+    }
+
+    if(depth == q->path->count)
+    {
+        size_t start = q->pos;
+
+        if(q->open_only)
+        {
+            q->matches[q->count++].start = start;
+            return 1;
+        }
+
+        if(json_query_skip_value(q))
+        {
+            return -1;
+        }
+
+        q->matches[q->count].start = start;
+        q->matches[q->count].end = q->pos;
+        return ++q->count == q->max_matches;
+    }
+
+    const json_path_segment_t *segment = &q->path->segments[depth];
+    char open = q->json[q->pos];
+
+    if(open != '{' && open != '[')
+    {
+        return json_query_skip_value(q); // A scalar cannot hold the rest of the path
+    }
+
+    char close = open == '{' ? '}' : ']';
+    size_t index = 0;
+    q->pos++;
+    json_query_skip_whitespace(q);
+
+    if(q->pos < q->length && q->json[q->pos] == close)
+    {
+        q->pos++;
+        return 0;
+    }
+
+    while(q->pos < q->length)
+    {
+        int match = segment->wildcard;
+
+        if(open == '{')
+        {
+            if(q->json[q->pos] != '"')
+            {
+                return json_query_fail(q);
+            }
+
+            size_t key = q->pos + 1;
+
+            if(json_query_skip_string(q))
+            {
+                return -1;
+            }
+
+            match = match || json_path_key_equals(q->json + key, q->pos - 1 - key, segment->name, segment->length);
+            json_query_skip_whitespace(q);
+
+            if(q->pos >= q->length || q->json[q->pos++] != ':')
+            {
+                return json_query_fail(q);
+            }
+
+            json_query_skip_whitespace(q);
+        }
+        else
+        {
+            match = match || index == segment->index;
+            index++;
+        }
+
+        if(q->pos >= q->length)
+        {
+            return json_query_fail(q);
+        }
+
+        int result = match ? json_query_value(q, depth + 1) : json_query_skip_value(q);
+
+        if(result != 0)
+        {
+            return result;
+        }
+
+        json_query_skip_whitespace(q);
+
+        if(q->pos >= q->length)
+        {
+            break;
+        }
+
+        char c = q->json[q->pos++];
+
+        if(c == close)
+        {
+            return 0;
+        }
+
+        if(c != ',')
+        {
+            return json_query_fail(q);
+        }
+
+        json_query_skip_whitespace(q);
+    }
+
+    return json_query_fail(q);
+}
+
+json_error_t json_path_query(const json_path_t *path, const char *json, size_t length,
+                             json_path_match_t *matches, size_t max_matches, size_t *count)
+{
+    json_query_t q;
+    memset(&q, 0, sizeof(q));
+    q.json = json;
+    q.length = length;
+    q.path = path;
+    q.matches = matches;
+    // Without a wildcard there is at most one match, so the scan stops at the first
+    q.max_matches = path->wildcard ? max_matches : (max_matches ? 1 : 0);
+    q.error = JSON_ERROR_NONE;
+    *count = 0;
+
+    if(max_matches == 0)
+    {
+        return JSON_ERROR_NONE;
+    }
+
+    json_query_skip_whitespace(&q);
+
+    if(q.pos >= length)
+    {
+        return JSON_ERROR_EMPTY_INPUT;
+    }
+
+    int result = json_query_value(&q, 0);
+    *count = q.count;
+
+    if(result < 0)
+    {
+        return q.error;
+    }
+
+    json_query_skip_whitespace(&q);
+
+    if(result == 0 && q.pos != length)
+    {
+        return JSON_ERROR_TRAILING_CHARS;
+    }
+
+    return JSON_ERROR_NONE;
+}
+
+// Offset of the first value the path matches, without reading past its first byte
+static int json_path_locate(const json_path_t *path, const char *json, size_t length, size_t *start)
+{
+    json_path_match_t match;
+    json_query_t q;
+    memset(&q, 0, sizeof(q));
+    q.json = json;
+    q.length = length;
+    q.path = path;
+    q.matches = &match;
+    q.max_matches = 1;
+    q.open_only = 1;
+
+    if(json_query_value(&q, 0) != 1)
+    {
+        return -1;
+    }
+
+    *start = match.start;
+    return 0;
+}
+
+/*
+    Newline-delimited batches
+
+    A raw newline cannot occur inside a valid JSON string, so every '\n' is a record
+    boundary and the split is a memchr loop. Records are handed out to workers in
+    contiguous ranges of roughly equal byte size. Each worker parses its records one after
+    another into a single token array with its own parser, so a worker allocates about as
+    often as one parse of its whole range would.
+*/
+
+struct json_batch_worker
+{
+    json_batch_t *batch;
+    const char *json;
+    size_t first; // Records [first, last)
+    size_t last;
+    json_token_t *tokens;
+    size_t token_count;
+    size_t error_count;
+    json_error_t error; // Set when some record ran out of memory
+#ifdef JSON_THREADS
+    pthread_t thread;
+    int started;
+#endif
+};
+
+void json_batch_init(json_batch_t *batch)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->max_depth = JSON_DEFAULT_MAX_DEPTH;
+    batch->max_string = JSON_DEFAULT_MAX_STRING;
+    batch->threads = 1;
+}
+
+void json_batch_free(json_batch_t *batch)
+{
+    for(unsigned int w = 0; w < batch->worker_count; w++)
+    {
+        struct json_batch_worker *worker = &batch->workers[w];
+
+        for(size_t i = 0; i < worker->token_count; i++)
+        {
+            if(json_token_owns_string(&worker->tokens[i]))
+            {
+                json_free_string(worker->tokens[i].value.string);
+            }
+        }
+
+        JSON_FREE(worker->tokens);
+    }
+
+    JSON_FREE(batch->workers);
+    JSON_FREE(batch->records);
+    batch->json = NULL;
+    batch->length = 0;
+    batch->workers = NULL;
+    batch->worker_count = 0;
+    batch->records = NULL;
+    batch->record_count = 0;
+    batch->error_count = 0;
+}
+
+// Drops the tokens of a failed record, together with the strings they own
+static void json_batch_discard(json_parser_t *parser, size_t first)
+{
+    for(size_t i = first; i < parser->token_count; i++)
+    {
+        if(json_token_owns_string(&parser->tokens[i]))
+        {
+            json_free_string(parser->tokens[i].value.string);
+        }
+    }
+
+    parser->token_count = first;
+}
+
+// Makes the tokens of a parsed record self-contained: offsets become absolute in the
+// batch input, links become relative to the record, and escaped zero-copy strings are
+// decoded now because their parser is gone by the time the caller reads them
+static int json_batch_settle(json_parser_t *parser, size_t first, size_t offset)
+{
+    for(size_t i = first; i < parser->token_count; i++)
+    {
+        json_token_t *tok = &parser->tokens[i];
+
+        if(tok->flags & JSON_TOKEN_FLAG_ESCAPED)
+        {
+            if(!json_token_string(parser, tok, NULL))
+            {
+                return -1;
+            }
+        }
+
+        tok->start += offset;
+        tok->end += offset;
+        tok->next -= (unsigned int)first;
+#ifdef JSON_PARENT_LINKS
+        if(tok->parent != JSON_TOKEN_NO_PARENT)
+        {
+            tok->parent -= (unsigned int)first;
+        }
+#endif
+    }
+
+    return 0;
+}
+
+static void json_batch_run(struct json_batch_worker *worker)
+{
+    json_batch_t *batch = worker->batch;
+    json_parser_t parser;
+    json_parser_init(&parser, NULL, 0);
+    // Record tokens outlive this parser, so their keys cannot point into its intern table
+    parser.flags = batch->flags & ~(JSON_FLAG_LAZY_NUMBERS | JSON_FLAG_OBJECT_INDEX | JSON_FLAG_INTERN_KEYS);
+    parser.max_depth = batch->max_depth;
+    parser.max_string = batch->max_string;
+
+    // A failed record never stops the worker, its error is only recorded
+    for(size_t r = worker->first; r < worker->last; r++)
+    {
+        json_record_t *record = &batch->records[r];
+        size_t first = parser.token_count;
+        json_parser_rewind(&parser, worker->json + record->start, record->end - record->start);
+        record->error = json_parser_parse(&parser);
+
+        if(record->error == JSON_ERROR_NONE && json_batch_settle(&parser, first, record->start))
+        {
+            record->error = parser.error;
+        }
+
+        if(record->error == JSON_ERROR_ALLOCATION_FAILED)
+        {
+            worker->error = record->error;
+        }
+
+        if(record->error != JSON_ERROR_NONE)
+        {
+            record->error_pos = record->start + parser.pos;
+            json_batch_discard(&parser, first);
+            worker->error_count++;
+            continue;
+        }
+
+        record->token_count = parser.token_count - first;
+    }
+
+    // The worker takes over the token array and every string in it
+    worker->tokens = parser.tokens;
+    worker->token_count = parser.token_count;
+    parser.tokens = NULL;
+    parser.token_count = 0;
+    parser.string_count = 0;
+    json_parser_free(&parser);
+}
+
+#ifdef JSON_THREADS
+static void *json_batch_thread(void *arg)
+{
+    json_batch_run(arg);
+    return NULL;
+}
+#endif
+
+// Splits the input into records, skipping blank lines
+static int json_batch_split(json_batch_t *batch, const char *json, size_t length)
+{
+    size_t cap = 0;
+    size_t pos = 0;
+
+    while(pos < length)
+    {
+        const char *newline = memchr(json + pos, '\n', length - pos);
+        size_t end = newline ? (size_t)(newline - json) : length;
+        size_t p = pos;
+
+        while(p < end && JSON_IS_WHITESPACE(json[p]))
+        {
+            p++;
+        }
+
+        if(p < end)
+        {
+            if(batch->record_count == cap)
+            {
+                size_t new_cap = cap ? cap * 2 : JSON_BATCH_INITIAL_RECORDS;
+                json_record_t *records = JSON_REALLOC(batch->records, new_cap * sizeof(json_record_t));
+
+                if(!records)
+                {
+                    return -1;
+                }
+
+                batch->records = records;
+                cap = new_cap;
+            }
+
+            json_record_t *record = &batch->records[batch->record_count++];
+            memset(record, 0, sizeof(*record));
+            record->start = pos;
+            record->end = end;
+        }
+
+        pos = end + 1;
+    }
+
+    return 0;
+}
+
+json_error_t json_batch_parse(json_batch_t *batch, const char *json, size_t length)
+{
+    json_batch_free(batch);
+
+    if(json_batch_split(batch, json, length))
+    {
+        json_batch_free(batch);
+        return JSON_ERROR_ALLOCATION_FAILED;
+    }
+
+    batch->json = json;
+    batch->length = length;
+
+    unsigned int count = 1;
+#ifdef JSON_THREADS
+    count = batch->threads ? batch->threads : 1;
+#endif
+
+    if(count > batch->record_count)
+    {
+        count = batch->record_count ? (unsigned int)batch->record_count : 1;
+    }
+
+    batch->workers = JSON_CALLOC(count, sizeof(struct json_batch_worker));
+
+    if(!batch->workers)
+    {
+        json_batch_free(batch);
+        return JSON_ERROR_ALLOCATION_FAILED;
+    }
+
+    batch->worker_count = count;
+    size_t r = 0;
+
+    for(unsigned int w = 0; w < count; w++)
+    {
+        // Each worker's range ends at the first record past its share of the bytes
+        size_t limit = length / count * (w + 1);
+        struct json_batch_worker *worker = &batch->workers[w];
+        worker->batch = batch;
+        worker->json = json;
+        worker->first = r;
+
+        while(r < batch->record_count && (w + 1 == count || batch->records[r].start < limit))
+        {
+            r++;
+        }
+
+        worker->last = r;
+    }
+
+#ifdef JSON_THREADS
+    // Worker 0 runs on the calling thread; a worker whose thread cannot start runs there too
+    for(unsigned int w = 1; w < count; w++)
+    {
+        batch->workers[w].started = pthread_create(&batch->workers[w].thread, NULL, json_batch_thread, &batch->workers[w]) == 0;
+    }
+#endif
+
+    json_error_t error = JSON_ERROR_NONE;
+
+    for(unsigned int w = 0; w < count; w++)
+    {
+        struct json_batch_worker *worker = &batch->workers[w];
+#ifdef JSON_THREADS
+        if(worker->started)
+        {
+            pthread_join(worker->thread, NULL);
+        }
+        else
+#endif
+        {
+            json_batch_run(worker);
+        }
+    }
+
+    for(unsigned int w = 0; w < count; w++)
+    {
+        struct json_batch_worker *worker = &batch->workers[w];
+        size_t offset = 0;
+
+        // The token array no longer moves, so records can point into it
+        for(size_t i = worker->first; i < worker->last; i++)
+        {
+            batch->records[i].tokens = batch->records[i].token_count ? worker->tokens + offset : NULL;
+            offset += batch->records[i].token_count;
+        }
+
+        batch->error_count += worker->error_count;
+
+        if(worker->error != JSON_ERROR_NONE)
+        {
+            error = worker->error;
+        }
+    }
+
+    return error;
+}
+
+// Sets up `view` as a parser over the tokens of one record, so that json_token_string,
+// json_token_get_*, json_object_find and json::value work on them. The view allocates
+// nothing; its tokens stay owned by the batch and are valid until json_batch_free.
+json_error_t json_record_view(const json_batch_t *batch, const json_record_t *record, json_parser_t *view)
+{
+    memset(view, 0, sizeof(*view));
+    view->json = batch->json;
+    view->length = batch->length;
+    view->tokens = (json_token_t *)record->tokens;
+    view->token_count = record->token_count;
+    view->token_cap = record->token_count;
+    view->max_depth = batch->max_depth;
+    view->max_string = batch->max_string;
+    view->flags = batch->flags & ~(JSON_FLAG_LAZY_NUMBERS | JSON_FLAG_OBJECT_INDEX | JSON_FLAG_INTERN_KEYS);
+    view->borrowed = 1;
+    view->error = record->error;
+#ifdef JSON_PARENT_LINKS
+    view->parent = JSON_TOKEN_NO_PARENT;
+#endif
+    return record->error;
+}
+
+/*
+    Parallel parsing of one large array
+
+    A pre-pass over the designated array tracks only strings and bracket depth to cut its
+    elements into slices at top-level commas, several slices per thread so that uneven
+    elements balance out: workers claim the next unparsed slice until none are left. Each
+    worker parses its slices with its own parser straight from the input, so token offsets
+    are already absolute. The main parser then parses the document as usual and, on
+    reaching the array, copies the slices' tokens in order and fixes up their links.
+    If any slice fails, the array is parsed again sequentially so the error is exactly
+    the one json_parser_parse reports.
+*/
+
+#define JSON_SPLIT_SLICES_PER_THREAD 4
+
+struct json_split_slice
+{
+    size_t start; // Elements in [start, end), separated by commas
+    size_t end;
+    unsigned int worker;
+    unsigned int elements;
+    size_t first; // Tokens [first, first + count) of the worker's parser
+    size_t count;
+};
+
+struct json_split_worker
+{
+    struct json_split *split;
+    unsigned int id;
+    json_parser_t parser;
+#ifdef JSON_THREADS
+    pthread_t thread;
+    int started;
+#endif
+};
+
+struct json_split
+{
+    const char *json;
+    size_t open;  // Offset of the array's '['
+    size_t close; // Offset of its ']'
+    struct json_split_slice *slices;
+    size_t slice_count;
+    size_t next_slice;
+    int failed;
+    int stitched;
+    struct json_split_worker *workers;
+    unsigned int worker_count;
+#ifdef JSON_THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+// Finds the ']' closing the array opened at split->open and cuts its elements into at
+// most `count` slices of similar size. Strings and brackets are tracked with the stage-1
+// classifier, so only structural characters are visited one by one.
+static int json_split_slices(struct json_split *split, size_t length, size_t count)
+{
+    const unsigned char *input = (const unsigned char *)split->json;
+    size_t begin = split->open + 1;
+
+    // Top-level commas are remembered every `step` bytes; the array's size is only known
+    // at its end, and the final cuts are then picked from these candidates
+    size_t fine = count * 8;
+    size_t step = (length - begin) / fine + 1;
+    size_t *cuts = JSON_MALLOC((fine + 1) * sizeof(size_t));
+
+    if(!cuts)
+    {
+        return -1;
+    }
+
+    const char *name;
+    json_classify_fn classify = json_select_classifier(&name);
+    size_t cut_count = 0;
+    size_t target = begin + step;
+    uint64_t prev_odd_run = 0;
+    uint64_t prev_in_string = 0;
+    int depth = 0;
+    int closed = 0;
+
+    for(size_t base = begin; !closed && base < length; base += 64)
+    {
+        json_block_masks_t masks;
+        size_t remaining = length - base;
+
+        if(remaining >= 64)
+        {
+            classify(input + base, &masks);
+        }
+        else
+        {
+            unsigned char tail[64];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, input + base, remaining);
+            json_classify_scalar(tail, &masks);
+        }
+
+        uint64_t escaped = json_find_escaped(masks.backslash, &prev_odd_run);
+        uint64_t quotes = masks.quote & ~escaped;
+        uint64_t in_string = json_prefix_xor(quotes) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+        for(uint64_t bits = masks.op & ~in_string; bits; bits &= bits - 1)
+        {
+            size_t pos = base + json_ctz64(bits);
+            unsigned char c = input[pos];
+
+            if(c == '[' || c == '{')
+            {
+                depth++;
+            }
+            else if(c == ']' || c == '}')
+            {
+                if(depth-- == 0)
+                {
+                    split->close = pos;
+                    closed = 1;
+                    break;
+                }
+            }
+            else if(c == ',' && depth == 0 && pos >= target && cut_count < fine)
+            {
+                cuts[cut_count++] = pos;
+                target = pos + step;
+            }
+        }
+    }
+
+    size_t p = begin;
+
+    while(closed && p < split->close && JSON_IS_WHITESPACE(input[p]))
+    {
+        p++;
+    }
+
+    // Unbalanced input is left to the sequential parse, which reports the error
+    if(!closed || p == split->close || !(split->slices = JSON_MALLOC(count * sizeof(struct json_split_slice))))
+    {
+        JSON_FREE(cuts);
+        return -1;
+    }
+
+    size_t size = split->close - begin;
+    size_t start = begin;
+
+    for(size_t k = 0; k < cut_count; k++)
+    {
+        if(split->slice_count + 1 < count && cuts[k] - begin >= size / count * (split->slice_count + 1))
+        {
+            struct json_split_slice *slice = &split->slices[split->slice_count++];
+            memset(slice, 0, sizeof(*slice));
+            slice->start = start;
+            slice->end = cuts[k];
+            start = cuts[k] + 1;
+        }
+    }
+
+    struct json_split_slice *slice = &split->slices[split->slice_count++];
+    memset(slice, 0, sizeof(*slice));
+    slice->start = start;
+    slice->end = split->close;
+    JSON_FREE(cuts);
+    return 0;
+}
+
+static struct json_split_slice *json_split_claim(struct json_split *split)
+{
+    struct json_split_slice *slice = NULL;
+#ifdef JSON_THREADS
+    pthread_mutex_lock(&split->lock);
+#endif
+
+    if(!split->failed && split->next_slice < split->slice_count)
+    {
+        slice = &split->slices[split->next_slice++];
+    }
+
+#ifdef JSON_THREADS
+    pthread_mutex_unlock(&split->lock);
+#endif
+    return slice;
+}
+
+static void json_split_fail(struct json_split *split)
+{
+#ifdef JSON_THREADS
+    pthread_mutex_lock(&split->lock);
+#endif
+    split->failed = 1;
+#ifdef JSON_THREADS
+    pthread_mutex_unlock(&split->lock);
+#endif
+}
+
+// Parses the comma-separated elements of one slice
+static int json_split_parse_slice(json_parser_t *parser, struct json_split_slice *slice)
+{
+    json_parser_rewind(parser, parser->json, slice->end);
+    parser->pos = slice->start;
+#ifdef JSON_PARENT_LINKS
+    parser->parent = JSON_TOKEN_NO_PARENT;
+#endif
+
+    if((parser->flags & JSON_FLAG_PRESCAN) &&
+            json_reserve_tokens(parser, parser->token_count + json_count_tokens(parser->json + slice->start, slice->end - slice->start)))
+    {
+        return -1;
+    }
+
+    for(;;)
+    {
+        if(json_parse_document(parser))
+        {
+            return -1;
+        }
+
+        slice->elements++;
+        json_skip_whitespace(parser);
+
+        if(parser->pos == parser->length)
+        {
+            return 0;
+        }
+
+        if(parser->json[parser->pos] != ',')
+        {
+            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
+            return -1;
+        }
+
+        parser->pos++;
+    }
+}
+
+static void json_split_run(struct json_split_worker *worker)
+{
+    struct json_split_slice *slice;
+
+    while((slice = json_split_claim(worker->split)))
+    {
+        slice->worker = worker->id;
+        slice->first = worker->parser.token_count;
+
+        if(json_split_parse_slice(&worker->parser, slice))
+        {
+            json_split_fail(worker->split);
+            return;
+        }
+
+        slice->count = worker->parser.token_count - slice->first;
+    }
+}
+
+#ifdef JSON_THREADS
+static void *json_split_thread(void *arg)
+{
+    json_split_run(arg);
+    return NULL;
+}
+#endif
+
+// Called by the core right after it opened token `array`. Returns 1 when the workers'
+// tokens were appended and the array's ']' is next, 0 to parse the array normally.
+static int json_split_stitch(json_parser_t *parser, size_t array)
+{
+    struct json_split *split = parser->split;
+
+    if(parser->pos != split->open + 1)
+    {
+        return 0;
+    }
+
+    size_t total = 0;
+    unsigned int elements = 0;
+
+    for(size_t s = 0; s < split->slice_count; s++)
+    {
+        total += split->slices[s].count;
+        elements += split->slices[s].elements;
+    }
+
+    if(parser->token_count + total >= JSON_TOKEN_NO_PARENT)
+    {
+        json_set_error(parser, JSON_ERROR_MAX_TOKENS);
+        return -1;
+    }
+
+    if(json_reserve_tokens(parser, parser->token_count + total))
+    {
+        return -1;
+    }
+
+    for(size_t s = 0; s < split->slice_count; s++)
+    {
+        const struct json_split_slice *slice = &split->slices[s];
+        json_token_t *dest = parser->tokens + parser->token_count;
+        memcpy(dest, split->workers[slice->worker].parser.tokens + slice->first, slice->count * sizeof(json_token_t));
+
+        // Links were relative to the worker's array
+        unsigned int shift = (unsigned int)(parser->token_count - slice->first);
+
+        for(size_t i = 0; i < slice->count; i++)
+        {
+            dest[i].next += shift;
+#ifdef JSON_PARENT_LINKS
+            dest[i].parent = dest[i].parent == JSON_TOKEN_NO_PARENT ? (unsigned int)array : dest[i].parent + shift;
+#endif
+        }
+
+        parser->token_count += slice->count;
+    }
+
+    // The main parser takes over every string the workers copied
+    for(unsigned int w = 0; w < split->worker_count; w++)
+    {
+        parser->string_count += split->workers[w].parser.string_count;
+#ifdef JSON_PARSER_STATS
+        const json_parse_stats_t *stats = &split->workers[w].parser.stats;
+        JSON_STATS_ADD(parser, string_bytes, stats->string_bytes);
+        JSON_STATS_ADD(parser, escapes, stats->escapes);
+        JSON_STATS_ADD(parser, numbers, stats->numbers);
+        JSON_STATS_MAX(parser, max_depth, (size_t)parser->depth + stats->max_depth);
+#endif
+    }
+
+    JSON_STATS_ADD(parser, tokens, total);
+
+    parser->tokens[array].size = elements;
+    parser->pos = split->close;
+    split->stitched = 1;
+    return 1;
+}
+
+static void json_split_free(struct json_split *split)
+{
+    for(unsigned int w = 0; w < split->worker_count; w++)
+    {
+        json_parser_t *worker = &split->workers[w].parser;
+
+        if(split->stitched)
+        {
+            // Strings now belong to the main parser
+            worker->token_count = 0;
+            worker->string_count = 0;
+        }
+
+        json_parser_free(worker);
+    }
+
+#ifdef JSON_THREADS
+    if(split->workers)
+    {
+        pthread_mutex_destroy(&split->lock);
+    }
+#endif
+    JSON_FREE(split->workers);
+    JSON_FREE(split->slices);
+}
+
+// Finds the array and parses its elements on the workers; -1 leaves the parse to the caller
+static int json_split_prepare(json_parser_t *parser, struct json_split *split, const json_path_t *array, unsigned int threads)
+{
+    size_t start;
+
+    if(array->wildcard || array->count + 1 >= parser->max_depth ||
+            json_path_locate(array, parser->json, parser->length, &start) || parser->json[start] != '[')
+    {
+        return -1;
+    }
+
+    split->json = parser->json;
+    split->open = start;
+
+    if(json_split_slices(split, parser->length, (size_t)threads * JSON_SPLIT_SLICES_PER_THREAD))
+    {
+        return -1;
+    }
+
+    split->workers = JSON_CALLOC(threads, sizeof(struct json_split_worker));
+
+    if(!split->workers)
+    {
+        return -1;
+    }
+
+#ifdef JSON_THREADS
+    pthread_mutex_init(&split->lock, NULL);
+#endif
+    split->worker_count = threads;
+
+    for(unsigned int w = 0; w < threads; w++)
+    {
+        struct json_split_worker *worker = &split->workers[w];
+        worker->split = split;
+        worker->id = w;
+        json_parser_init(&worker->parser, parser->json, parser->length);
+        // Elements start below the array, so they get the rest of the depth budget. Their
+        // tokens are moved into `parser`, so keys are copied rather than interned per worker.
+        worker->parser.flags = parser->flags & ~(JSON_FLAG_STRUCTURAL_INDEX | JSON_FLAG_OBJECT_INDEX | JSON_FLAG_INTERN_KEYS);
+        worker->parser.max_depth = parser->max_depth - array->count - 1;
+        worker->parser.max_string = parser->max_string;
+    }
+
+#ifdef JSON_THREADS
+    for(unsigned int w = 1; w < threads; w++)
+    {
+        split->workers[w].started = pthread_create(&split->workers[w].thread, NULL, json_split_thread, &split->workers[w]) == 0;
+    }
+#endif
+
+    // The calling thread is worker 0; it also picks up the slices of threads that did not start
+    json_split_run(&split->workers[0]);
+
+#ifdef JSON_THREADS
+    for(unsigned int w = 1; w < threads; w++)
+    {
+        if(split->workers[w].started)
+        {
+            pthread_join(split->workers[w].thread, NULL);
+        }
+    }
+#endif
+
+    return split->failed ? -1 : 0;
+}
+
+json_error_t json_parser_parse_parallel(json_parser_t *parser, const json_path_t *array, unsigned int threads)
+{
+#ifndef JSON_THREADS
+    threads = 1;
+#endif
+
+    // Worker strings are heap copies, which an arena-backed parser cannot own
+    if(threads < 2 || parser->arena)
+    {
+        return json_parser_parse(parser);
+    }
+
+    struct json_split split;
+    memset(&split, 0, sizeof(split));
+    unsigned int flags = parser->flags;
+
+    if(json_split_prepare(parser, &split, array, threads) == 0)
+    {
+        // Only the text around the array is left for this parser, so its index would not pay off
+        parser->split = &split;
+        parser->flags &= ~JSON_FLAG_STRUCTURAL_INDEX;
+    }
+
+    json_error_t error = json_parser_parse(parser);
+    parser->split = NULL;
+    parser->flags = flags;
+    json_split_free(&split);
+    return error;
+}
+
+/*
+    Writer.
+
+    Values are appended to one buffer, with commas and colons placed from two flags instead
+    of a nesting stack: a value completed at the current level needs a comma before the next
+    one, and a key makes the next value its member value.
+    Strings are copied in runs between the bytes that need escaping, found with the SIMD
+    string kernel of the parser. Doubles are formatted with Grisu2, which yields the shortest
+    digits in almost every case and always digits that read back to the same double.
+*/
+
+void json_writer_init(json_writer_t *writer, char *buffer, size_t capacity)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+
+    if(!buffer)
+    {
+        writer->owned = 1;
+        writer->capacity = capacity ? capacity : JSON_WRITER_INITIAL_CAPACITY;
+        writer->buffer = JSON_MALLOC(writer->capacity);
+
+        if(!writer->buffer)
+        {
+            writer->capacity = 0;
+            writer->error = JSON_ERROR_ALLOCATION_FAILED;
+        }
+    }
+}
+
+void json_writer_reset(json_writer_t *writer)
+{
+    writer->length = 0;
+    writer->depth = 0;
+    writer->needs_comma = 0;
+    writer->after_key = 0;
+    writer->error = writer->buffer ? JSON_ERROR_NONE : JSON_ERROR_ALLOCATION_FAILED;
+}
+
+void json_writer_free(json_writer_t *writer)
+{
+    if(writer->owned)
+    {
+        JSON_FREE(writer->buffer);
+    }
+
+    memset(writer, 0, sizeof(*writer));
+}
+
+static int json_writer_reserve(json_writer_t *writer, size_t extra)
+{
+    if(writer->error != JSON_ERROR_NONE)
+    {
+        return -1;
+    }
+
+    if(extra <= writer->capacity - writer->length)
+    {
+        return 0;
+    }
+
+    if(!writer->owned)
+    {
+        writer->error = JSON_ERROR_BUFFER_FULL;
+        return -1;
+    }
+
+    size_t capacity = writer->capacity ? writer->capacity : JSON_WRITER_INITIAL_CAPACITY;
+
+    while(capacity - writer->length < extra)
+    {
+        capacity *= 2;
+    }
+
+    char *buffer = JSON_REALLOC(writer->buffer, capacity);
+
+    if(!buffer)
+    {
+        writer->error = JSON_ERROR_ALLOCATION_FAILED;
+        return -1;
+    }
+
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    return 0;
+}
+
+// Reserves room for `extra` bytes of the next value and writes the comma it needs
+static int json_writer_begin_value(json_writer_t *writer, size_t extra)
+{
+    if(json_writer_reserve(writer, extra + 1))
+    {
+        return -1;
+    }
+
+    if(writer->needs_comma && !writer->after_key)
+    {
+        writer->buffer[writer->length++] = ',';
+    }
+
+    writer->after_key = 0;
+    return 0;
+}
+
+static json_error_t json_writer_bytes(json_writer_t *writer, const char *bytes, size_t length)
+{
+    if(json_writer_begin_value(writer, length))
+    {
+        return writer->error;
+    }
+
+    memcpy(writer->buffer + writer->length, bytes, length);
+    writer->length += length;
+    writer->needs_comma = 1;
+    return JSON_ERROR_NONE;
+}
+
+static json_error_t json_writer_open(json_writer_t *writer, char bracket)
+{
+    if(json_writer_begin_value(writer, 1))
+    {
+        return writer->error;
+    }
+
+    writer->buffer[writer->length++] = bracket;
+    writer->depth++;
+    writer->needs_comma = 0;
+    return JSON_ERROR_NONE;
+}
+
+static json_error_t json_writer_close(json_writer_t *writer, char bracket)
+{
+    if(writer->error == JSON_ERROR_NONE && (writer->depth == 0 || writer->after_key))
+    {
+        writer->error = JSON_ERROR_UNEXPECTED_CHAR;
+    }
+
+    if(json_writer_reserve(writer, 1))
+    {
+        return writer->error;
+    }
+
+    writer->buffer[writer->length++] = bracket;
+    writer->depth--;
+    writer->needs_comma = 1;
+    return JSON_ERROR_NONE;
+}
+
+json_error_t json_write_object_begin(json_writer_t *writer)
+{
+    return json_writer_open(writer, '{');
+}
+
+json_error_t json_write_object_end(json_writer_t *writer)
+{
+    return json_writer_close(writer, '}');
+}
+
+json_error_t json_write_array_begin(json_writer_t *writer)
+{
+    return json_writer_open(writer, '[');
+}
+
+json_error_t json_write_array_end(json_writer_t *writer)
+{
+    return json_writer_close(writer, ']');
+}
+
+// Appends `string` quoted and escaped; the comma, if any, has been written already
+static int json_writer_quote(json_writer_t *writer, const char *string, size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *p = string;
+    const char *end = string + length;
+
+    if(json_writer_reserve(writer, 1))
+    {
+        return -1;
+    }
+
+    writer->buffer[writer->length++] = '"';
+
+    for(;;)
+    {
+        const char *special = json_find_string_special(p, end);
+        size_t run = (size_t)(special - p);
+
+        if(json_writer_reserve(writer, run + 6))
+        {
+            return -1;
+        }
+
+        memcpy(writer->buffer + writer->length, p, run);
+        writer->length += run;
+        p = special;
+
+        if(p == end)
+        {
+            break;
+        }
+
+        unsigned char c = (unsigned char)*p++;
+        char *out = writer->buffer + writer->length;
+        out[0] = '\\';
+        writer->length += 2;
+
+        switch(c)
+        {
+            case '"':
+            case '\\':
+                out[1] = (char)c;
+                break;
+
+            case '\b':
+                out[1] = 'b';
+                break;
+
+            case '\f':
+                out[1] = 'f';
+                break;
+
+            case '\n':
+                out[1] = 'n';
+                break;
+
+            case '\r':
+                out[1] = 'r';
+                break;
+
+            case '\t':
+                out[1] = 't';
+                break;
+
+            default:
+                memcpy(out + 1, "u00", 3);
+                out[4] = hex[c >> 4];
+                out[5] = hex[c & 0xF];
+                writer->length += 4;
+                break;
+        }
+    }
+
+    writer->buffer[writer->length++] = '"';
+    return 0;
+}
+
+json_error_t json_write_key(json_writer_t *writer, const char *key, size_t length)
+{
+    if(json_writer_begin_value(writer, 0) || json_writer_quote(writer, key, length) || json_writer_reserve(writer, 1))
+    {
+        return writer->error;
+    }
+
+    writer->buffer[writer->length++] = ':';
+    writer->needs_comma = 0;
+    writer->after_key = 1;
+    return JSON_ERROR_NONE;
+}
+
+json_error_t json_write_string(json_writer_t *writer, const char *string, size_t length)
+{
+    if(json_writer_begin_value(writer, 0) || json_writer_quote(writer, string, length))
+    {
+        return writer->error;
+    }
+
+    writer->needs_comma = 1;
+    return JSON_ERROR_NONE;
+}
+
+static const char json_digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Writes the decimal digits of value ending just before `end`, returns the first digit
+static char *json_format_uint64(uint64_t value, char *end)
+{
+    while(value >= 100)
+    {
+        end -= 2;
+        memcpy(end, json_digit_pairs + (value % 100) * 2, 2);
+        value /= 100;
+    }
+
+    if(value >= 10)
+    {
+        end -= 2;
+        memcpy(end, json_digit_pairs + value * 2, 2);
+    }
+    else
+    {
+        *--end = (char)('0' + value);
+    }
+
+    return end;
+}
+
+json_error_t json_write_uint64(json_writer_t *writer, uint64_t value)
+{
+    char buffer[20];
+    char *digits = json_format_uint64(value, buffer + sizeof(buffer));
+    return json_writer_bytes(writer, digits, (size_t)(buffer + sizeof(buffer) - digits));
+}
+
+json_error_t json_write_int64(json_writer_t *writer, int64_t value)
+{
+    char buffer[21];
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    char *digits = json_format_uint64(magnitude, buffer + sizeof(buffer));
+
+    if(value < 0)
+    {
+        *--digits = '-';
+    }
+
+    return json_writer_bytes(writer, digits, (size_t)(buffer + sizeof(buffer) - digits));
+}
+
+#ifndef JSON_NO_FLOAT
+// Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers").
+// A double is a 64-bit significand and a binary exponent, scaled into a fixed exponent
+// window by one of the cached powers of ten below, 10^-348 to 10^340 in steps of 8.
+typedef struct
+{
+    uint64_t f;
+    int e;
+} json_diy_fp_t;
+
+static const json_diy_fp_t json_cached_powers[] =
+{
+    {0xFA8FD5A0081C0288, -1220}, {0xBAAEE17FA23EBF76, -1193}, {0x8B16FB203055AC76, -1166}, {0xCF42894A5DCE35EA, -1140},
+    {0x9A6BB0AA55653B2D, -1113}, {0xE61ACF033D1A45DF, -1087}, {0xAB70FE17C79AC6CA, -1060}, {0xFF77B1FCBEBCDC4F, -1034},
+    {0xBE5691EF416BD60C, -1007}, {0x8DD01FAD907FFC3C, -980}, {0xD3515C2831559A83, -954}, {0x9D71AC8FADA6C9B5, -927},
+    {0xEA9C227723EE8BCB, -901}, {0xAECC49914078536D, -874}, {0x823C12795DB6CE57, -847}, {0xC21094364DFB5637, -821},
+    {0x9096EA6F3848984F, -794}, {0xD77485CB25823AC7, -768}, {0xA086CFCD97BF97F4, -741}, {0xEF340A98172AACE5, -715},
+    {0xB23867FB2A35B28E, -688}, {0x84C8D4DFD2C63F3B, -661}, {0xC5DD44271AD3CDBA, -635}, {0x936B9FCEBB25C996, -608},
+    {0xDBAC6C247D62A584, -582}, {0xA3AB66580D5FDAF6, -555}, {0xF3E2F893DEC3F126, -529}, {0xB5B5ADA8AAFF80B8, -502},
+    {0x87625F056C7C4A8B, -475}, {0xC9BCFF6034C13053, -449}, {0x964E858C91BA2655, -422}, {0xDFF9772470297EBD, -396},
+    {0xA6DFBD9FB8E5B88F, -369}, {0xF8A95FCF88747D94, -343}, {0xB94470938FA89BCF, -316}, {0x8A08F0F8BF0F156B, -289},
+    {0xCDB02555653131B6, -263}, {0x993FE2C6D07B7FAC, -236}, {0xE45C10C42A2B3B06, -210}, {0xAA242499697392D3, -183},
+    {0xFD87B5F28300CA0E, -157}, {0xBCE5086492111AEB, -130}, {0x8CBCCC096F5088CC, -103}, {0xD1B71758E219652C, -77},
+    {0x9C40000000000000, -50}, {0xE8D4A51000000000, -24}, {0xAD78EBC5AC620000, 3}, {0x813F3978F8940984, 30},
+    {0xC097CE7BC90715B3, 56}, {0x8F7E32CE7BEA5C70, 83}, {0xD5D238A4ABE98068, 109}, {0x9F4F2726179A2245, 136},
+    {0xED63A231D4C4FB27, 162}, {0xB0DE65388CC8ADA8, 189}, {0x83C7088E1AAB65DB, 216}, {0xC45D1DF942711D9A, 242},
+    {0x924D692CA61BE758, 269}, {0xDA01EE641A708DEA, 295}, {0xA26DA3999AEF774A, 322}, {0xF209787BB47D6B85, 348},
+    {0xB454E4A179DD1877, 375}, {0x865B86925B9BC5C2, 402}, {0xC83553C5C8965D3D, 428}, {0x952AB45CFA97A0B3, 455},
+    {0xDE469FBD99A05FE3, 481}, {0xA59BC234DB398C25, 508}, {0xF6C69A72A3989F5C, 534}, {0xB7DCBF5354E9BECE, 561},
+    {0x88FCF317F22241E2, 588}, {0xCC20CE9BD35C78A5, 614}, {0x98165AF37B2153DF, 641}, {0xE2A0B5DC971F303A, 667},
+    {0xA8D9D1535CE3B396, 694}, {0xFB9B7CD9A4A7443C, 720}, {0xBB764C4CA7A44410, 747}, {0x8BAB8EEFB6409C1A, 774},
+    {0xD01FEF10A657842C, 800}, {0x9B10A4E5E9913129, 827}, {0xE7109BFBA19C0C9D, 853}, {0xAC2820D9623BF429, 880},
+    {0x80444B5E7AA7CF85, 907}, {0xBF21E44003ACDD2D, 933}, {0x8E679C2F5E44FF8F, 960}, {0xD433179D9C8CB841, 986},
+    {0x9E19DB92B4E31BA9, 1013}, {0xEB96BF6EBADF77D9, 1039}, {0xAF87023B9BF0EE6B, 1066}
+};
+
+static json_diy_fp_t json_diy_fp_multiply(json_diy_fp_t x, json_diy_fp_t y)
+{
+    // Upper 64 bits of the 128-bit product, rounded
+    const uint64_t mask = 0xFFFFFFFFu;
+    uint64_t a = x.f >> 32, b = x.f & mask, c = y.f >> 32, d = y.f & mask;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t middle = (bd >> 32) + (ad & mask) + (bc & mask) + (1u << 31);
+    json_diy_fp_t r = {ac + (ad >> 32) + (bc >> 32) + (middle >> 32), x.e + y.e + 64};
+    return r;
+}
+
+static json_diy_fp_t json_diy_fp_normalize(json_diy_fp_t x)
+{
+    while(!(x.f & (1ULL << 63)))
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+
+    return x;
+}
+
+// Moves the last digit down towards w while the result stays inside the boundaries
+static void json_grisu_round(char *digits, size_t length, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while(rest < wp_w && delta - rest >= ten_kappa &&
+            (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))
+    {
+        digits[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+// Emits the digits of the upper boundary, stopping as soon as they identify a number
+// inside (upper - delta, upper)
+static size_t json_grisu_digits(json_diy_fp_t w, json_diy_fp_t upper, uint64_t delta, char *digits, int *k)
+{
+    static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+    const int shift = -upper.e;
+    const uint64_t one = 1ULL << shift;
+    const uint64_t wp_w = upper.f - w.f;
+    uint32_t p1 = (uint32_t)(upper.f >> shift);
+    uint64_t p2 = upper.f & (one - 1);
+    int kappa = 1;
+    size_t length = 0;
+
+    while(kappa < 10 && p1 >= pow10[kappa])
+    {
+        kappa++;
+    }
+
+    while(kappa > 0)
+    {
+        uint32_t d = p1 / pow10[kappa - 1];
+        p1 %= pow10[kappa - 1];
+
+        if(d || length)
         {
-            return -1; // Missing low surrogate
+            digits[length++] = (char)('0' + d);
         }
 
-        parser->pos += 2; // Skip "\u"
-        unsigned int low_surrogate = 0;
+        kappa--;
+        uint64_t rest = ((uint64_t)p1 << shift) + p2;
 
-        for(int i = 0; i < 4; i++)
+        if(rest <= delta)
         {
-            char c = parser->json[parser->pos++];
-            low_surrogate <<= 4;
+            *k += kappa;
+            json_grisu_round(digits, length, delta, rest, (uint64_t)pow10[kappa] << shift, wp_w);
+            return length;
+        }
+    }
 
-            if(c >= '0' && c <= '9')
-            {
-                low_surrogate += c - '0';
-            }
-            else if(c >= 'a' && c <= 'f')
-            {
-                low_surrogate += c - 'a' + 10;
-            }
-            else if(c >= 'A' && c <= 'F')
-            {
-                low_surrogate += c - 'A' + 10;
-            }
-            else
-            {
-                return -1;
-            }
+    for(;;)
+    {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> shift);
+
+        if(d || length)
+        {
+            digits[length++] = (char)('0' + d);
         }
 
-        if(low_surrogate < 0xDC00 || low_surrogate > 0xDFFF)
+        p2 &= one - 1;
+        kappa--;
+
+        if(p2 < delta)
         {
-            return -1; // Invalid low surrogate
+            *k += kappa;
+            json_grisu_round(digits, length, delta, p2, one, -kappa < 10 ? wp_w * pow10[-kappa] : 0);
+            return length;
         }
+    }
+}
 
-        // Combine into 32-bit codepoint
-        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low_surrogate - 0xDC00);
+// Shortest digits of a positive finite double: value = digits * 10^k
+static size_t json_grisu2(double value, char *digits, int *k)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int biased = (int)((bits >> 52) & 0x7FF);
+    json_diy_fp_t v = {bits & ((1ULL << 52) - 1), biased ? biased - 1075 : -1074};
+
+    if(biased)
+    {
+        v.f |= 1ULL << 52;
     }
-    else if(codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+
+    // Boundaries halfway to the neighbouring doubles, the lower one closer at powers of two
+    json_diy_fp_t upper = {(v.f << 1) + 1, v.e - 1};
+
+    while(!(upper.f & (1ULL << 53)))
     {
-        return -1; // Unpaired low surrogate
+        upper.f <<= 1;
+        upper.e--;
     }
 
-    // UTF-8 encoding for codepoints > 0xFFFF
-    if(codepoint <= 0x7F)
+    upper.f <<= 10;
+    upper.e -= 10;
+    json_diy_fp_t lower = {(v.f << 1) - 1, v.e - 1};
+
+    if(v.f == (1ULL << 52))
     {
-        if(*idx >= parser->max_string - 1)
-        {
-            return -1;
-        }
+        lower.f = (v.f << 2) - 1;
+        lower.e = v.e - 2;
+    }
 
-        buf[(*idx)++] = codepoint;
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+
+    // Pick the cached power that brings the upper boundary's exponent into [-60, -32]
+    double dk = (-61 - upper.e) * 0.30102999566398114 + 347;
+    int index = (int)dk;
+
+    if(dk - index > 0.0)
+    {
+        index++;
     }
-    else if(codepoint <= 0x7FF)
+
+    index = (index >> 3) + 1;
+    *k = -(-348 + index * 8);
+    json_diy_fp_t power = json_cached_powers[index];
+
+    json_diy_fp_t w = json_diy_fp_multiply(json_diy_fp_normalize(v), power);
+    json_diy_fp_t w_upper = json_diy_fp_multiply(upper, power);
+    json_diy_fp_t w_lower = json_diy_fp_multiply(lower, power);
+    w_lower.f++;
+    w_upper.f--;
+    return json_grisu_digits(w, w_upper, w_upper.f - w_lower.f, digits, k);
+}
+
+// Formats a finite double as the shortest JSON number that reads back as the same value.
+// Needs up to 25 bytes: plain notation for decimal exponents from -6 to 21, exponent beyond.
+static size_t json_format_double(double value, char *buffer)
+{
+    char *out = buffer;
+
+    if(signbit(value))
     {
-        if(*idx >= parser->max_string - 2)
-        {
-            return -1;
-        }
+        *out++ = '-';
+        value = -value;
+    }
 
-        buf[(*idx)++] = 0xC0 | (codepoint >> 6);
-        buf[(*idx)++] = 0x80 | (codepoint & 0x3F);
+    if(value == 0.0)
+    {
+        *out++ = '0';
+        return (size_t)(out - buffer);
     }
-    else if(codepoint <= 0xFFFF)
+
+    char digits[18];
+    int k;
+    int length = (int)json_grisu2(value, digits, &k);
+    int point = length + k; // Position of the decimal point relative to the first digit
+
+    if(k >= 0 && point <= 21)
+    {
+        // Integer: 1234e2 -> 123400
+        memcpy(out, digits, (size_t)length);
+        memset(out + length, '0', (size_t)k);
+        out += point;
+    }
+    else if(point > 0 && point <= 21)
     {
-        if(*idx >= parser->max_string - 3)
+        // 1234e-2 -> 12.34
+        memcpy(out, digits, (size_t)point);
+        out[point] = '.';
+        memcpy(out + point + 1, digits + point, (size_t)(length - point));
+        out += length + 1;
+    }
+    else if(point > -6 && point <= 0)
+    {
+        // 1234e-6 -> 0.001234
+        memcpy(out, "0.", 2);
+        memset(out + 2, '0', (size_t)-point);
+        memcpy(out + 2 - point, digits, (size_t)length);
+        out += 2 - point + length;
+    }
+    else
+    {
+        // 1234e30 -> 1.234e33
+        *out++ = digits[0];
+
+        if(length > 1)
         {
-            return -1;
+            *out++ = '.';
+            memcpy(out, digits + 1, (size_t)(length - 1));
+            out += length - 1;
+        }
+
+        *out++ = 'e';
+        int exponent = point - 1;
+
+        if(exponent < 0)
+        {
+            *out++ = '-';
+            exponent = -exponent;
         }
 
-        buf[(*idx)++] = 0xE0 | (codepoint >> 12);
-        buf[(*idx)++] = 0x80 | ((codepoint >> 6) & 0x3F);
-        buf[(*idx)++] = 0x80 | (codepoint & 0x3F);
+        char *end = out + 3;
+        char *first = json_format_uint64((uint64_t)exponent, end);
+        memmove(out, first, (size_t)(end - first));
+        out += end - first;
     }
-    else
+
+    return (size_t)(out - buffer);
+}
+
+json_error_t json_write_double(json_writer_t *writer, double value)
+{
+    if(!isfinite(value))
     {
-        if(*idx >= parser->max_string - 4)
+        // NaN and infinities have no JSON representation
+        if(writer->error == JSON_ERROR_NONE)
         {
-            return -1;
+            writer->error = JSON_ERROR_INVALID_NUMBER;
         }
 
-        buf[(*idx)++] = 0xF0 | (codepoint >> 18);
-        buf[(*idx)++] = 0x80 | ((codepoint >> 12) & 0x3F);
-        buf[(*idx)++] = 0x80 | ((codepoint >> 6) & 0x3F);
-        buf[(*idx)++] = 0x80 | (codepoint & 0x3F);
+        return writer->error;
     }
 
-    return 0;
+    char buffer[32];
+    return json_writer_bytes(writer, buffer, json_format_double(value, buffer));
 }
+#endif
 
-static int json_parse_string(json_parser_t *parser)
+json_error_t json_write_bool(json_writer_t *writer, int value)
 {
-    if(json_add_token(parser, JSON_TOKEN_STRING))
+    return value ? json_writer_bytes(writer, "true", 4) : json_writer_bytes(writer, "false", 5);
+}
+
+json_error_t json_write_null(json_writer_t *writer)
+{
+    return json_writer_bytes(writer, "null", 4);
+}
+
+json_error_t json_write_raw(json_writer_t *writer, const char *json, size_t length)
+{
+    return json_writer_bytes(writer, json, length);
+}
+
+// The input span of a token, with the quotes of a string
+static const char *json_token_span(const json_parser_t *parser, const json_token_t *token, size_t *length)
+{
+    int quoted = token->type == JSON_TOKEN_STRING;
+    *length = token->end - token->start + (quoted ? 2 : 0);
+    return parser->json + token->start - (quoted ? 1 : 0);
+}
+
+json_error_t json_write_token(json_writer_t *writer, const json_parser_t *parser, const json_token_t *token)
+{
+    size_t length;
+    const char *span = json_token_span(parser, token, &length);
+    return json_writer_bytes(writer, span, length);
+}
+
+json_error_t json_write_key_token(json_writer_t *writer, const json_parser_t *parser, const json_token_t *key)
+{
+    size_t length;
+    const char *span = json_token_span(parser, key, &length);
+
+    if(json_writer_begin_value(writer, length + 1))
     {
-        return -1;
+        return writer->error;
     }
 
-    json_token_t *token = &parser->tokens[parser->token_count - 1];
-    token->start = parser->pos + 1;
-    char *buffer = malloc(parser->max_string);
+    memcpy(writer->buffer + writer->length, span, length);
+    writer->length += length;
+    writer->buffer[writer->length++] = ':';
+    writer->needs_comma = 0;
+    writer->after_key = 1;
+    return JSON_ERROR_NONE;
+}
 
-    if(!buffer)
+/*
+    Frozen documents and parser pools
+
+    A frozen document is laid out as header, tokens, numbers, key tables and strings in one block,
+    with 32-bit offsets instead of pointers, so it can be read by any thread without
+    synchronization and copied as plain bytes. Tokens are 16 bytes, half a json_token_t, so a scan
+    over them touches half the memory. The pool keeps its free parsers on a Treiber stack whose head packs
+    an index and a change count into one 64-bit word, so a stale compare-and-swap cannot succeed.
+*/
+
+#define JSON_FROZEN_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+// Key table slots of an indexed object with `size` members
+static size_t json_frozen_capacity(uint32_t size)
+{
+    size_t capacity = 4;
+
+    while(capacity < (size_t)size * 2)
     {
-        json_set_error(parser, JSON_ERROR_ALLOCATION_FAILED);
-        return -1;
+        capacity *= 2;
     }
 
-    size_t idx = 0;
-    parser->pos++; // Skip opening quote
+    return capacity;
+}
 
-    while(parser->pos < parser->length)
+// Key table slots for an object, 0 when it is scanned linearly
+static size_t json_frozen_slots(const json_token_t *token)
+{
+    if(token->type != JSON_TOKEN_OBJECT || token->size < JSON_OBJECT_INDEX_THRESHOLD)
     {
-        char c = parser->json[parser->pos++];
+        return 0;
+    }
 
-        if(c == '"')
-        {
-            token->end = parser->pos - 1;
-            buffer[idx] = '\0';
-            token->value.string = buffer;
-            return 0;
-        }
+    return json_frozen_capacity(token->size);
+}
 
-        if(c == '\\')
+// Fills the key table at `slots` for the frozen object `object`, whose keys are already written
+static void json_frozen_index(json_frozen_t *frozen, size_t object, uint32_t *slots, size_t capacity)
+{
+    const json_frozen_token_t *tokens = JSON_FROZEN_TOKENS(frozen);
+    uint32_t mask = (uint32_t)(capacity - 1);
+    size_t key = object + 1;
+    memset(slots, 0, capacity * 2 * sizeof(uint32_t));
+
+    for(uint32_t i = 0; i < tokens[object].size; i++)
+    {
+        const char *name = (const char *)frozen + tokens[key].offset;
+        uint32_t hash = json_hash_key(name, tokens[key].size);
+        uint32_t slot = hash & mask;
+
+        // Duplicate keys keep their first occurrence, like json_object_find
+        while(slots[slot * 2 + 1])
         {
-            if(parser->pos >= parser->length)
+            const json_frozen_token_t *other = &tokens[slots[slot * 2 + 1] - 1];
+
+            if(slots[slot * 2] == hash && other->size == tokens[key].size &&
+                    memcmp((const char *)frozen + other->offset, name, other->size) == 0)
             {
                 break;
             }
 
-            c = parser->json[parser->pos++];
+            slot = (slot + 1) & mask;
+        }
 
-            switch(c)
-            {
-                case '"':
-                    c = '"';
-                    break;
+        if(!slots[slot * 2 + 1])
+        {
+            slots[slot * 2] = hash;
+            slots[slot * 2 + 1] = (uint32_t)key + 1;
+        }
 
-                case '\\':
-                    c = '\\';
-                    break;
+        key = tokens[key + 1].next;
+    }
+}
 
-                case '/':
-                    c = '/';
-                    break;
+json_error_t json_freeze(json_parser_t *parser, void *buffer, size_t capacity, size_t *size)
+{
+    if(parser->error != JSON_ERROR_NONE)
+    {
+        return parser->error;
+    }
 
-                case 'b':
-                    c = '\b';
-                    break;
+    if(parser->token_count == 0 || parser->token_count >= UINT32_MAX)
+    {
+        return JSON_ERROR_MAX_TOKENS;
+    }
 
-                case 'f':
-                    c = '\f';
-                    break;
+    size_t numbers = sizeof(json_frozen_t) + parser->token_count * sizeof(json_frozen_token_t);
+    size_t tables = numbers;
+    size_t table_bytes = 0;
+    size_t string_bytes = 0;
 
-                case 'n':
-                    c = '\n';
-                    break;
+    for(size_t i = 0; i < parser->token_count; i++)
+    {
+        if(parser->tokens[i].type == JSON_TOKEN_STRING)
+        {
+            size_t length;
 
-                case 'r':
-                    c = '\r';
-                    break;
+            if(!json_token_string(parser, &parser->tokens[i], &length))
+            {
+                return parser->error;
+            }
 
-                case 't':
-                    c = '\t';
-                    break;
+            string_bytes += length + 1;
+        }
+        else if(parser->tokens[i].type == JSON_TOKEN_NUMBER)
+        {
+            tables += sizeof(json_frozen_value_t);
+        }
 
-                case 'u':
-                    if(json_parse_unicode_escape(parser, buffer, &idx))
-                    {
-                        free(buffer);
-                        json_set_error(parser, JSON_ERROR_INVALID_UNICODE);
-                        return -1;
-                    }
+        table_bytes += json_frozen_slots(&parser->tokens[i]) * 2 * sizeof(uint32_t);
+    }
 
-                    continue;
+    size_t strings = tables + table_bytes;
+    size_t total = JSON_FROZEN_ALIGN(strings + string_bytes);
 
-                default:
-                    free(buffer);
-                    json_set_error(parser, JSON_ERROR_INVALID_ESCAPE);
-                    return -1;
-            }
-        }
+    // Offsets are 32-bit, which bounds the whole block
+    if((uint64_t)total > UINT32_MAX)
+    {
+        return JSON_ERROR_TOO_LARGE;
+    }
 
-        if(idx >= parser->max_string - 1)
+    if(size)
+    {
+        *size = total;
+    }
+
+    if(!buffer)
+    {
+        return JSON_ERROR_NONE;
+    }
+
+    if(capacity < total)
+    {
+        return JSON_ERROR_BUFFER_FULL;
+    }
+
+    char *base = buffer;
+    json_frozen_t *frozen = buffer;
+    json_frozen_token_t *out = (json_frozen_token_t *)(frozen + 1);
+    frozen->magic = JSON_FROZEN_MAGIC;
+    frozen->version = JSON_FROZEN_VERSION;
+    frozen->size = total;
+    frozen->token_count = parser->token_count;
+
+    for(size_t i = 0; i < parser->token_count; i++)
+    {
+        json_token_t *tok = &parser->tokens[i];
+        out[i].type = (uint16_t)tok->type;
+        out[i].flags = 0;
+        out[i].size = tok->size;
+        out[i].next = tok->next;
+        out[i].offset = 0;
+
+        if(tok->type == JSON_TOKEN_STRING)
         {
-            free(buffer);
-            json_set_error(parser, JSON_ERROR_STRING_TOO_LONG);
-            return -1;
+            size_t length;
+            const char *string = json_token_string(parser, tok, &length);
+            memcpy(base + strings, string, length);
+            base[strings + length] = '\0';
+            out[i].size = (uint32_t)length;
+            out[i].offset = (uint32_t)strings;
+            strings += length + 1;
+        }
+        else if(tok->type == JSON_TOKEN_NUMBER)
+        {
+            json_token_number(parser, tok);
+            json_frozen_value_t *value = (json_frozen_value_t *)(base + numbers);
+            value->uinteger = tok->value.uinteger;
+            out[i].flags = (uint16_t)(tok->flags & (JSON_TOKEN_FLAG_INTEGER | JSON_TOKEN_FLAG_UNSIGNED));
+            out[i].offset = (uint32_t)numbers;
+            numbers += sizeof(json_frozen_value_t);
         }
+    }
 
-        buffer[idx++] = c;
+    // Key tables go in once every key string is in place
+    for(size_t i = 0; i < parser->token_count; i++)
+    {
+        size_t slots = json_frozen_slots(&parser->tokens[i]);
+
+        if(slots)
+        {
+            out[i].offset = (uint32_t)tables;
+            json_frozen_index(frozen, i, (uint32_t *)(base + tables), slots);
+            tables += slots * 2 * sizeof(uint32_t);
+        }
     }
 
-    free(buffer);
-    json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
-    return -1;
+    memset(base + strings, 0, total - strings);
+    return JSON_ERROR_NONE;
 }
 
-static int json_parse_number(json_parser_t *parser)
+json_error_t json_freeze_alloc(json_parser_t *parser, json_frozen_t **frozen)
 {
-    const char *start = parser->json + parser->pos;
-    const char *p = start;
-    int has_sign = 0;
-    int has_integer = 0;
-    int has_fraction = 0;
-    int has_exponent = 0;
+    size_t size;
+    json_error_t error = json_freeze(parser, NULL, 0, &size);
+    *frozen = NULL;
 
-    // Check optional sign
-    if(*p == '-')
+    if(error != JSON_ERROR_NONE)
     {
-        has_sign = 1;
-        p++;
+        return error;
     }
 
-    // Validate integer part
-    if(*p == '0')
+    // malloc returns memory aligned for any type, which covers the 8 bytes numbers need
+    json_frozen_t *blob = JSON_MALLOC(size);
+
+    if(!blob)
     {
-        p++;
-        has_integer = 1;
+        return JSON_ERROR_ALLOCATION_FAILED;
     }
-    else if(isdigit(*p))
-    {
-        has_integer = 1;
-        p++;
 
-        while(isdigit(*p))
-        {
-            p++;
-        }
+    error = json_freeze(parser, blob, size, NULL);
+
+    if(error != JSON_ERROR_NONE)
+    {
+        JSON_FREE(blob);
+        return error;
     }
-    else
+
+    *frozen = blob;
+    return JSON_ERROR_NONE;
+}
+
+void json_frozen_free(json_frozen_t *frozen)
+{
+    JSON_FREE(frozen);
+}
+
+const char *json_frozen_string(const json_frozen_t *frozen, const json_frozen_token_t *token, size_t *length)
+{
+    if(token->type != JSON_TOKEN_STRING)
     {
-        json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
-        return -1;
+        return NULL;
     }
 
-    // Validate fractional part
-    if(*p == '.')
+    if(length)
     {
-        p++;
+        *length = token->size;
+    }
 
-        if(!isdigit(*p))
-        {
-            json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
-            return -1;
-        }
+    return (const char *)frozen + token->offset;
+}
 
-        has_fraction = 1;
-        p++;
+const json_frozen_value_t *json_frozen_value(const json_frozen_t *frozen, const json_frozen_token_t *token)
+{
+    if(token->type != JSON_TOKEN_NUMBER)
+    {
+        return NULL;
+    }
 
-        while(isdigit(*p))
-        {
-            p++;
-        }
+    return (const json_frozen_value_t *)((const char *)frozen + token->offset);
+}
+
+const json_frozen_token_t *json_frozen_find(const json_frozen_t *frozen, const json_frozen_token_t *object, const char *key, size_t length)
+{
+    if(object->type != JSON_TOKEN_OBJECT)
+    {
+        return NULL;
     }
 
-    // Validate exponent part
-    if(*p == 'e' || *p == 'E')
+    const json_frozen_token_t *tokens = JSON_FROZEN_TOKENS(frozen);
+
+    if(object->offset)
     {
-        p++;
+        const uint32_t *slots = (const uint32_t *)((const char *)frozen + object->offset);
+        uint32_t mask = (uint32_t)json_frozen_capacity(object->size) - 1;
+        uint32_t hash = json_hash_key(key, length);
 
-        if(*p == '+' || *p == '-')
+        for(uint32_t slot = hash & mask; slots[slot * 2 + 1]; slot = (slot + 1) & mask)
         {
-            p++;
-        }
+            const json_frozen_token_t *name = &tokens[slots[slot * 2 + 1] - 1];
 
-        if(!isdigit(*p))
-        {
-            json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
-            return -1;
+            if(slots[slot * 2] == hash && name->size == length && memcmp((const char *)frozen + name->offset, key, length) == 0)
+            {
+                return name + 1;
+            }
         }
 
-        has_exponent = 1;
-        p++;
-
-        while(isdigit(*p))
-        {
-            p++;
-        }
+        return NULL;
     }
 
-    // Verify the entire number was parsed correctly
-    char *end;
-    double num = strtod(start, &end);
+    const json_frozen_token_t *name = object + 1;
 
-    if(end != p)
+    for(uint32_t i = 0; i < object->size; i++)
     {
-        json_set_error(parser, JSON_ERROR_INVALID_NUMBER);
-        return -1;
-    }
+        if(name->size == length && memcmp((const char *)frozen + name->offset, key, length) == 0)
+        {
+            return name + 1;
+        }
 
-    if(json_add_token(parser, JSON_TOKEN_NUMBER))
-    {
-        return -1;
+        name = tokens + name[1].next;
     }
 
-    json_token_t *token = &parser->tokens[parser->token_count - 1];
-    token->value.number = num;
-    token->start = parser->pos;
-    parser->pos += (p - start);
-    token->end = parser->pos;
-    return 0;
+    return NULL;
 }
 
-static int json_parse_literal(json_parser_t *parser, const char *literal, json_token_type_t type)
+// Compare-and-swap on the pool head, with the compiler's atomics or C11 <stdatomic.h>. A pool
+// that silently lost its thread safety would be worse than none, so other compilers stop here.
+#if defined(__GNUC__)
+#define JSON_POOL_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define JSON_POOL_CAS(p, expected, desired) __atomic_compare_exchange_n(p, expected, desired, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define JSON_POOL_LINK_LOAD(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#define JSON_POOL_LINK_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define JSON_POOL_LOAD(p) atomic_load_explicit((_Atomic uint64_t *)(p), memory_order_acquire)
+#define JSON_POOL_CAS(p, expected, desired) atomic_compare_exchange_weak_explicit((_Atomic uint64_t *)(p), expected, desired, memory_order_acq_rel, memory_order_acquire)
+#define JSON_POOL_LINK_LOAD(p) atomic_load_explicit((_Atomic uint32_t *)(p), memory_order_relaxed)
+#define JSON_POOL_LINK_STORE(p, v) atomic_store_explicit((_Atomic uint32_t *)(p), v, memory_order_relaxed)
+#else
+#error "json_parser_pool_t needs GCC-style __atomic builtins or C11 <stdatomic.h>"
+#endif
+
+json_error_t json_parser_pool_init(json_parser_pool_t *pool, size_t count)
 {
-    size_t len = strlen(literal);
+    memset(pool, 0, sizeof(*pool));
 
-    if(parser->pos + len > parser->length)
+    if(count == 0)
     {
-        return -1;
+        return JSON_ERROR_NONE;
     }
 
-    if(strncmp(parser->json + parser->pos, literal, len))
+    // Indexes are stored in 32 bits
+    if(count >= UINT32_MAX)
     {
-        return -1;
+        return JSON_ERROR_ALLOCATION_FAILED;
     }
 
-    size_t literal_start_pos = parser->pos;
-    parser->pos += len;
+    pool->parsers = JSON_MALLOC(count * sizeof(json_parser_t));
+    pool->links = JSON_MALLOC(count * sizeof(uint32_t));
 
-    if(json_add_token(parser, type))
+    if(!pool->parsers || !pool->links)
     {
-        return -1;
+        JSON_FREE(pool->parsers);
+        JSON_FREE(pool->links);
+        memset(pool, 0, sizeof(*pool));
+        return JSON_ERROR_ALLOCATION_FAILED;
     }
 
-    json_token_t *token = &parser->tokens[parser->token_count - 1];
-    token->start = literal_start_pos;
-    token->end = parser->pos;
-    return 0;
-}
-
-static int json_parse_array(json_parser_t *parser);
-static int json_parse_object(json_parser_t *parser);
-
-static int json_parse_value(json_parser_t *parser)
-{
-    json_skip_whitespace(parser);
-
-    if(parser->pos >= parser->length)
+    for(size_t i = 0; i < count; i++)
     {
-        return -1;
+        json_parser_init(&pool->parsers[i], NULL, 0);
+        pool->links[i] = i + 1 < count ? (uint32_t)(i + 2) : 0;
     }
 
-    char c = parser->json[parser->pos];
+    pool->count = count;
+    pool->head = 1;
+    return JSON_ERROR_NONE;
+}
 
-    switch(c)
+json_parser_t *json_parser_pool_acquire(json_parser_pool_t *pool, const char *json, size_t length)
+{
+    uint64_t head = JSON_POOL_LOAD(&pool->head);
+    uint32_t top;
+
+    do
     {
-        case '{':
-            return json_parse_object(parser);
+        top = (uint32_t)head;
 
-        case '[':
-            return json_parse_array(parser);
+        if(!top)
+        {
+            return NULL;
+        }
 
-        case '"':
-            return json_parse_string(parser);
+        // The link may be rewritten by a thread that popped and pushed `top` meanwhile; the
+        // change count in the head makes this CAS fail in that case
+    }
+    while(!JSON_POOL_CAS(&pool->head, &head, ((head >> 32) + 1) << 32 | JSON_POOL_LINK_LOAD(&pool->links[top - 1])));
 
-        case 't':
-            return json_parse_literal(parser, "true", JSON_TOKEN_TRUE);
+    json_parser_t *parser = &pool->parsers[top - 1];
+    json_parser_reset(parser, json, length);
+    return parser;
+}
 
-        case 'f':
-            return json_parse_literal(parser, "false", JSON_TOKEN_FALSE);
+void json_parser_pool_release(json_parser_pool_t *pool, json_parser_t *parser)
+{
+    uint32_t index = (uint32_t)(parser - pool->parsers);
+    uint64_t head = JSON_POOL_LOAD(&pool->head);
 
-        case 'n':
-            return json_parse_literal(parser, "null", JSON_TOKEN_NULL);
+    // Copied strings are released now; the token array stays for the next user
+    json_parser_reset(parser, NULL, 0);
 
-        default:
-            if(c == '-' || isdigit(c) || c == '.')
-            {
-                return json_parse_number(parser);
-            }
-            else
-            {
-                json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
-                return -1;
-            }
+    do
+    {
+        JSON_POOL_LINK_STORE(&pool->links[index], (uint32_t)head);
     }
+    while(!JSON_POOL_CAS(&pool->head, &head, ((head >> 32) + 1) << 32 | (index + 1)));
 }
 
-static int json_parse_object(json_parser_t *parser)
+void json_parser_pool_free(json_parser_pool_t *pool)
 {
-    if(parser->depth >= parser->max_depth)
+    for(size_t i = 0; i < pool->count; i++)
     {
-        json_set_error(parser, JSON_ERROR_NESTING_DEPTH);
-        return -1;
+        json_parser_free(&pool->parsers[i]);
     }
 
-    size_t start_pos = parser->pos;
-    parser->depth++;
+    JSON_FREE(pool->parsers);
+    JSON_FREE(pool->links);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Checks everything the accessors rely on: sizes, tree links, string and key table bounds,
+// so that a damaged or foreign blob is rejected instead of being read out of bounds
+json_error_t json_frozen_check(const void *blob, size_t size)
+{
+    const json_frozen_t *frozen = blob;
 
-    if(json_add_token(parser, JSON_TOKEN_OBJECT) < 0)
+    if(((uintptr_t)blob & 7) || size < sizeof(json_frozen_t) || frozen->magic != JSON_FROZEN_MAGIC ||
+            frozen->version != JSON_FROZEN_VERSION || frozen->size != size || frozen->token_count == 0 ||
+            frozen->token_count > (size - sizeof(json_frozen_t)) / sizeof(json_frozen_token_t))
     {
-        return -1;
+        return JSON_ERROR_CORRUPT;
     }
 
-    json_token_t *obj_token = &parser->tokens[parser->token_count - 1];
-    obj_token->start = start_pos;
-    obj_token->end = 0;
-    parser->pos++; // Skip '{'
-    json_skip_whitespace(parser);
+    const json_frozen_token_t *tokens = JSON_FROZEN_TOKENS(frozen);
+    size_t count = (size_t)frozen->token_count;
+    size_t data = sizeof(json_frozen_t) + count * sizeof(json_frozen_token_t);
 
-    if(parser->json[parser->pos] == '}')
+    if(tokens[0].next != count)
     {
-        parser->pos++;
-        obj_token->end = parser->pos;
-        parser->depth--;
-        return 0;
+        return JSON_ERROR_CORRUPT;
     }
 
-    while(parser->pos < parser->length)
+    for(size_t i = 0; i < count; i++)
     {
-        json_skip_whitespace(parser);
+        const json_frozen_token_t *tok = &tokens[i];
+        int container = tok->type == JSON_TOKEN_OBJECT || tok->type == JSON_TOKEN_ARRAY;
 
-        if(parser->pos >= parser->length)
+        if(tok->type == JSON_TOKEN_INVALID || tok->type > JSON_TOKEN_NULL || tok->next <= i || tok->next > count ||
+                (!container && (tok->next != i + 1 || (tok->size && tok->type != JSON_TOKEN_STRING))))
         {
-            break;
+            return JSON_ERROR_CORRUPT;
         }
 
-        if(parser->json[parser->pos] == '}')
+        if(tok->type == JSON_TOKEN_STRING &&
+                (tok->offset < data || tok->offset >= size || size - tok->offset <= tok->size ||
+                 ((const char *)blob)[tok->offset + tok->size] != '\0'))
         {
-            parser->pos++;
-            obj_token->end = parser->pos;
-            parser->depth--;
-            return 0;
+            return JSON_ERROR_CORRUPT;
         }
 
-        if(parser->json[parser->pos] != '"')
+        if(tok->type == JSON_TOKEN_NUMBER &&
+                ((tok->offset & 7) || tok->offset < data || size - sizeof(json_frozen_value_t) < tok->offset))
         {
-            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
-            return -1;
+            return JSON_ERROR_CORRUPT;
         }
 
-        if(json_parse_string(parser))
+        if(!container)
         {
-            return -1;
+            continue;
         }
 
-        json_skip_whitespace(parser);
+        // The children must tile the subtree exactly, keys first in objects. They are checked
+        // themselves later, so each step is made to move forward here.
+        size_t child = i + 1;
+        size_t members = 0;
 
-        if(parser->json[parser->pos++] != ':')
+        while(child < tok->next)
         {
-            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
-            return -1;
-        }
+            if(tok->type == JSON_TOKEN_OBJECT)
+            {
+                if(tokens[child].type != JSON_TOKEN_STRING || child + 1 >= tok->next)
+                {
+                    return JSON_ERROR_CORRUPT;
+                }
 
-        json_skip_whitespace(parser);
+                child++;
+            }
 
-        if(json_parse_value(parser))
-        {
-            return -1;
-        }
+            if(tokens[child].next <= child)
+            {
+                return JSON_ERROR_CORRUPT;
+            }
 
-        json_skip_whitespace(parser);
+            child = tokens[child].next;
+            members++;
+        }
 
-        if(parser->json[parser->pos] == '}')
+        if(child != tok->next || members != tok->size)
         {
-            continue;
+            return JSON_ERROR_CORRUPT;
         }
 
-        if(parser->json[parser->pos++] != ',')
+        if(tok->type == JSON_TOKEN_OBJECT && tok->offset)
         {
-            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
-            return -1;
+            size_t slots = json_frozen_capacity(tok->size);
+
+            if((tok->offset & 3) || tok->offset < data || tok->offset > size || (size - tok->offset) / 8 < slots)
+            {
+                return JSON_ERROR_CORRUPT;
+            }
+
+            // Every entry must name a string inside this object. Slots are at least twice the
+            // members, so no more entries than members leaves a free slot to end each probe.
+            const uint32_t *table = (const uint32_t *)((const char *)blob + tok->offset);
+            uint32_t used = 0;
+
+            for(size_t slot = 0; slot < slots; slot++)
+            {
+                uint32_t key = table[slot * 2 + 1];
+
+                if(key && (key - 1 <= i || key >= tok->next || tokens[key - 1].type != JSON_TOKEN_STRING))
+                {
+                    return JSON_ERROR_CORRUPT;
+                }
+
+                used += key != 0;
+            }
+
+            if(used > tok->size)
+            {
+                return JSON_ERROR_CORRUPT;
+            }
         }
     }
 
-    json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
-    return -1;
+    return JSON_ERROR_NONE;
 }
 
-static int json_parse_array(json_parser_t *parser)
+/*
+    Tape files
+
+    A tape file is a 48-byte header followed by a frozen document. The header records the byte
+    order, the version of both layouts, the size and modification time of the source file and
+    a checksum of the document, so a tape from another machine, an older release or an edited
+    source is never used. Tapes are written to a temporary file and renamed into place.
+*/
+
+#define JSON_TAPE_MAGIC 0x5041544Au // "JTAP" read as little-endian bytes
+#define JSON_TAPE_VERSION 1
+#define JSON_TAPE_BYTE_ORDER 0x01020304u
+
+struct json_tape_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t reserved;
+    uint64_t source_size;  // Source file when the tape was written, both 0 without a source
+    int64_t source_mtime;  // Seconds
+    uint64_t size;         // Bytes of the frozen document that follows
+    uint64_t checksum;
+};
+
+// 64-bit multiply-rotate hash over the 8-byte words of a frozen document
+static uint64_t json_tape_checksum(const void *data, size_t size)
 {
-    if(parser->depth >= parser->max_depth)
+    const unsigned char *bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ull ^ size;
+
+    for(size_t i = 0; i + 8 <= size; i += 8)
     {
-        json_set_error(parser, JSON_ERROR_NESTING_DEPTH);
-        return -1;
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = ((hash << 27 | hash >> 37) ^ word) * 0x100000001b3ull;
     }
 
-    size_t start_pos = parser->pos; // Position of '['
-    parser->depth++;
+    return hash ^ hash >> 32;
+}
+
+static int json_tape_stamp(const char *source_path, uint64_t *size, int64_t *mtime)
+{
+    *size = 0;
+    *mtime = 0;
 
-    if(json_add_token(parser, JSON_TOKEN_ARRAY) < 0)
+    if(!source_path)
     {
-        return -1;
+        return 0;
     }
 
-    json_token_t *arr_token = &parser->tokens[parser->token_count - 1];
-    arr_token->start = start_pos; // Start at '['
-    arr_token->end = 0;
-    parser->pos++; // Skip '['
-    json_skip_whitespace(parser);
+#ifdef JSON_HAVE_MMAP
+    struct stat st;
 
-    if(parser->json[parser->pos] == ']')
+    if(stat(source_path, &st) == 0)
     {
-        parser->pos++;
-        arr_token->end = parser->pos;
-        parser->depth--;
+        *size = (uint64_t)st.st_size;
+        *mtime = (int64_t)st.st_mtime;
         return 0;
     }
+#endif
+    // Without stat a source can never be shown to be unchanged
+    return -1;
+}
 
-    while(parser->pos < parser->length)
+// Writes `frozen` with the stamp its source had before it was read
+static json_error_t json_tape_write(const json_frozen_t *frozen, const char *path, uint64_t source_size, int64_t source_mtime)
+{
+    struct json_tape_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = JSON_TAPE_MAGIC;
+    header.version = JSON_TAPE_VERSION;
+    header.byte_order = JSON_TAPE_BYTE_ORDER;
+    header.size = frozen->size;
+    header.checksum = json_tape_checksum(frozen, (size_t)frozen->size);
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    size_t length = strlen(path);
+    char *temporary = JSON_MALLOC(length + 5);
+
+    if(!temporary)
     {
-        json_skip_whitespace(parser);
+        return JSON_ERROR_ALLOCATION_FAILED;
+    }
 
-        if(parser->pos >= parser->length)
-        {
-            break;
-        }
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".tmp", 5);
+    FILE *file = fopen(temporary, "wb");
+    int failed = !file;
 
-        if(parser->json[parser->pos] == ']')
-        {
-            parser->pos++;
-            arr_token->end = parser->pos;
-            parser->depth--;
-            return 0;
-        }
+    if(file)
+    {
+        failed = fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(frozen, (size_t)frozen->size, 1, file) != 1;
+        failed |= fclose(file) != 0;
+    }
 
-        if(json_parse_value(parser))
-        {
-            return -1;
-        }
+    // Readers see either the old tape or the complete new one
+    failed = failed || rename(temporary, path) != 0;
 
-        json_skip_whitespace(parser);
+    if(failed)
+    {
+        remove(temporary);
+    }
 
-        if(parser->json[parser->pos] == ']')
-        {
-            continue;
-        }
-        else if(parser->json[parser->pos] == ',')
-        {
-            parser->pos++;
-            json_skip_whitespace(parser);
+    JSON_FREE(temporary);
+    return failed ? JSON_ERROR_IO : JSON_ERROR_NONE;
+}
 
-            if(parser->json[parser->pos] == ']')
-            {
-                json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
-                return -1;
-            }
-        }
-        else
-        {
-            json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
-            return -1;
-        }
+json_error_t json_tape_save(json_parser_t *parser, const char *path, const char *source_path)
+{
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    if(json_tape_stamp(source_path, &source_size, &source_mtime))
+    {
+        return JSON_ERROR_IO;
     }
 
-    json_set_error(parser, JSON_ERROR_UNEXPECTED_CHAR);
-    return -1;
+    json_frozen_t *frozen;
+    json_error_t error = json_freeze_alloc(parser, &frozen);
+
+    if(error == JSON_ERROR_NONE)
+    {
+        error = json_tape_write(frozen, path, source_size, source_mtime);
+        json_frozen_free(frozen);
+    }
+
+    return error;
 }
 
-json_error_t json_parser_parse(json_parser_t *parser)
+static json_error_t json_tape_check(const char *file, size_t file_size, const char *source_path)
 {
-    parser->error = JSON_ERROR_NONE;
-    json_skip_whitespace(parser);
+    struct json_tape_header header;
 
-    if(parser->pos >= parser->length)
+    if(file_size < sizeof(header))
     {
-        if(parser->length == 0 || parser->pos == parser->length)
-        {
-            json_set_error(parser, JSON_ERROR_EMPTY_INPUT);
-        }
-        else
-        {
-            json_set_error(parser, JSON_ERROR_INVALID_TOKEN);
-        }
+        return JSON_ERROR_CORRUPT;
+    }
 
-        return parser->error;
+    memcpy(&header, file, sizeof(header));
+
+    if(header.magic != JSON_TAPE_MAGIC || header.version != JSON_TAPE_VERSION || header.byte_order != JSON_TAPE_BYTE_ORDER ||
+            header.size != file_size - sizeof(header))
+    {
+        return JSON_ERROR_CORRUPT;
     }
 
-    if(json_parse_value(parser) < 0)
+    // Staleness first, a tape that is out of date is not worth checksumming
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    if(source_path && (json_tape_stamp(source_path, &source_size, &source_mtime) || source_size != header.source_size ||
+                       source_mtime != header.source_mtime))
     {
-        return parser->error;
+        return JSON_ERROR_STALE;
     }
 
-    json_skip_whitespace(parser);
+    const char *blob = file + sizeof(header);
 
-    if(parser->pos != parser->length)
+    if(json_tape_checksum(blob, (size_t)header.size) != header.checksum)
     {
-        json_set_error(parser, JSON_ERROR_TRAILING_CHARS);
+        return JSON_ERROR_CORRUPT;
     }
 
-    return parser->error;
+    return json_frozen_check(blob, (size_t)header.size);
+}
+
+json_error_t json_tape_load(json_tape_t *tape, const char *path, const char *source_path)
+{
+    memset(tape, 0, sizeof(*tape));
+
+    if(json_load_file(path, &tape->file, &tape->file_size, &tape->file_mapped))
+    {
+        return JSON_ERROR_IO;
+    }
+
+    json_error_t error = json_tape_check(tape->file, tape->file_size, source_path);
+
+    if(error != JSON_ERROR_NONE)
+    {
+        json_tape_free(tape);
+        return error;
+    }
+
+    tape->frozen = (const json_frozen_t *)(tape->file + sizeof(struct json_tape_header));
+    return JSON_ERROR_NONE;
+}
+
+json_error_t json_tape_open(json_tape_t *tape, const char *path, const char *source_path, unsigned int flags)
+{
+    json_error_t error = json_tape_load(tape, path, source_path);
+
+    if(error == JSON_ERROR_NONE || !source_path)
+    {
+        return error;
+    }
+
+    // Stamped before reading: a source edited during the reparse leaves a tape that is already
+    // stale, never one that claims contents it does not have
+    uint64_t source_size;
+    int64_t source_mtime;
+    int stamped = json_tape_stamp(source_path, &source_size, &source_mtime) == 0;
+    json_parser_t parser;
+    error = json_parser_init_file(&parser, source_path);
+
+    if(error == JSON_ERROR_NONE)
+    {
+        parser.flags = flags;
+        error = json_parser_parse(&parser);
+    }
+
+    if(error == JSON_ERROR_NONE)
+    {
+        error = json_freeze_alloc(&parser, &tape->owned);
+    }
+
+    json_parser_free(&parser);
+
+    if(error != JSON_ERROR_NONE)
+    {
+        return error;
+    }
+
+    tape->frozen = tape->owned;
+    tape->reparsed = 1;
+
+    // A tape that cannot be written only means the next open parses again
+    if(stamped)
+    {
+        json_tape_write(tape->owned, path, source_size, source_mtime);
+    }
+
+    return JSON_ERROR_NONE;
+}
+
+void json_tape_free(json_tape_t *tape)
+{
+    if(tape->file)
+    {
+        json_unload_file(tape->file, tape->file_size, tape->file_mapped);
+    }
+
+    json_frozen_free(tape->owned);
+    memset(tape, 0, sizeof(*tape));
 }
 
 #endif /* JSON_PARSER_IMPLEMENTATION */
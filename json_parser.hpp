@@ -0,0 +1,450 @@
+/**
+    @brief JSON Parser Library, C++17 interface
+
+    Header-only views over the C parser: json::document owns a json_parser_t, and json::value
+    is a (parser, token) pair with string_view access, child iteration and key lookup. Views
+    allocate nothing of their own: calls are inline forwards to the C API or walks over the
+    token array. The parser may still allocate on their behalf, when as_string decodes a lazy
+    zero-copy string or operator[] builds the key index of a large object, and json::schema
+    allocates its key table.
+
+    @date 2025-05-03
+    @version 1.0
+    @author Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license MIT License
+*/
+#ifndef JSON_PARSER_HPP
+#define JSON_PARSER_HPP
+
+#include "json_parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+
+namespace json
+{
+class value;
+struct member;
+
+// Forward iterator over the elements of an array. Elements are found by following `next`,
+// so stepping over a nested container does not visit its descendants.
+class element_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = json::value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = json::value;
+
+    element_iterator() noexcept = default;
+    element_iterator(json_parser_t *parser, const json_token_t *token) noexcept : parser_(parser), token_(token) {}
+
+    json::value operator*() const noexcept;
+
+    element_iterator &operator++() noexcept
+    {
+        token_ = parser_->tokens + token_->next;
+        return *this;
+    }
+
+    element_iterator operator++(int) noexcept
+    {
+        element_iterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const element_iterator &other) const noexcept
+    {
+        return token_ == other.token_;
+    }
+
+    bool operator!=(const element_iterator &other) const noexcept
+    {
+        return token_ != other.token_;
+    }
+
+private:
+    json_parser_t *parser_ = nullptr;
+    const json_token_t *token_ = nullptr;
+};
+
+// Forward iterator over the members of an object, positioned on the key tokens
+class member_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = json::member;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = json::member;
+
+    member_iterator() noexcept = default;
+    member_iterator(json_parser_t *parser, const json_token_t *token) noexcept : parser_(parser), token_(token) {}
+
+    json::member operator*() const noexcept;
+
+    member_iterator &operator++() noexcept
+    {
+        token_ = parser_->tokens + token_[1].next;
+        return *this;
+    }
+
+    member_iterator operator++(int) noexcept
+    {
+        member_iterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const member_iterator &other) const noexcept
+    {
+        return token_ == other.token_;
+    }
+
+    bool operator!=(const member_iterator &other) const noexcept
+    {
+        return token_ != other.token_;
+    }
+
+private:
+    json_parser_t *parser_ = nullptr;
+    const json_token_t *token_ = nullptr;
+};
+
+template <typename Iterator>
+class range
+{
+public:
+    range(Iterator first, Iterator last) noexcept : first_(first), last_(last) {}
+
+    Iterator begin() const noexcept
+    {
+        return first_;
+    }
+
+    Iterator end() const noexcept
+    {
+        return last_;
+    }
+
+    bool empty() const noexcept
+    {
+        return first_ == last_;
+    }
+
+private:
+    Iterator first_;
+    Iterator last_;
+};
+
+// View of one parsed value. A default-constructed value stands for a missing one: lookups
+// on it return missing values again and accessors return their fallback, so chains like
+// doc["a"]["b"][0] need no checks in between. Views stay valid until the document is
+// reset, freed or moved.
+class value
+{
+public:
+    value() noexcept = default;
+    value(json_parser_t *parser, const json_token_t *token) noexcept : parser_(parser), token_(token) {}
+
+    explicit operator bool() const noexcept
+    {
+        return token_ != nullptr;
+    }
+
+    json_token_type_t type() const noexcept
+    {
+        return token_ ? token_->type : JSON_TOKEN_INVALID;
+    }
+
+    bool is_object() const noexcept
+    {
+        return type() == JSON_TOKEN_OBJECT;
+    }
+
+    bool is_array() const noexcept
+    {
+        return type() == JSON_TOKEN_ARRAY;
+    }
+
+    bool is_string() const noexcept
+    {
+        return type() == JSON_TOKEN_STRING;
+    }
+
+    bool is_number() const noexcept
+    {
+        return type() == JSON_TOKEN_NUMBER;
+    }
+
+    bool is_bool() const noexcept
+    {
+        return type() == JSON_TOKEN_TRUE || type() == JSON_TOKEN_FALSE;
+    }
+
+    bool is_null() const noexcept
+    {
+        return type() == JSON_TOKEN_NULL;
+    }
+
+    // Members of an object or elements of an array, 0 otherwise
+    size_t size() const noexcept
+    {
+        return token_ ? token_->size : 0;
+    }
+
+    // Decoded string. Escaped zero-copy strings are decoded on first access, as with
+    // json_token_string; an empty view is returned for other types.
+    std::string_view as_string() const noexcept
+    {
+        size_t length = 0;
+        const char *string = token_ ? json_token_string(parser_, token_, &length) : nullptr;
+        return string ? std::string_view(string, length) : std::string_view();
+    }
+
+#ifndef JSON_NO_FLOAT
+    double as_double(double fallback = 0.0) const noexcept
+    {
+        return is_number() ? json_token_get_double(parser_, token_) : fallback;
+    }
+#endif
+
+    int64_t as_int64(int64_t fallback = 0) const noexcept
+    {
+        int64_t result;
+        return is_number() && json_token_get_int64(parser_, token_, &result) == JSON_ERROR_NONE ? result : fallback;
+    }
+
+    uint64_t as_uint64(uint64_t fallback = 0) const noexcept
+    {
+        uint64_t result;
+        return is_number() && json_token_get_uint64(parser_, token_, &result) == JSON_ERROR_NONE ? result : fallback;
+    }
+
+    bool as_bool(bool fallback = false) const noexcept
+    {
+        return is_bool() ? token_->type == JSON_TOKEN_TRUE : fallback;
+    }
+
+    // The value's text in the input. For strings that is the part between the quotes, with
+    // escapes left as they are.
+    std::string_view raw() const noexcept
+    {
+        return token_ ? std::string_view(parser_->json + token_->start, token_->end - token_->start) : std::string_view();
+    }
+
+    // Member lookup through json_object_find, which hashes the keys of large objects
+    value operator[](std::string_view key) const noexcept
+    {
+        const json_token_t *found = is_object() ? json_object_find(parser_, token_, key.data(), key.size()) : nullptr;
+        return found ? value(parser_, found) : value();
+    }
+
+    // Array element lookup, linear in `index` since elements are reached through `next`
+    value operator[](size_t index) const noexcept
+    {
+        if(!is_array() || index >= token_->size)
+        {
+            return value();
+        }
+
+        const json_token_t *element = token_ + 1;
+
+        while(index--)
+        {
+            element = parser_->tokens + element->next;
+        }
+
+        return value(parser_, element);
+    }
+
+    // Array elements; empty for every other type
+    element_iterator begin() const noexcept
+    {
+        return element_iterator(parser_, is_array() ? token_ + 1 : end_token());
+    }
+
+    element_iterator end() const noexcept
+    {
+        return element_iterator(parser_, end_token());
+    }
+
+    // Object members; empty for every other type
+    range<member_iterator> items() const noexcept
+    {
+        const json_token_t *last = end_token();
+        return range<member_iterator>(member_iterator(parser_, is_object() ? token_ + 1 : last), member_iterator(parser_, last));
+    }
+
+    const json_token_t *token() const noexcept
+    {
+        return token_;
+    }
+
+    json_parser_t *parser() const noexcept
+    {
+        return parser_;
+    }
+
+private:
+    const json_token_t *end_token() const noexcept
+    {
+        return token_ ? parser_->tokens + token_->next : nullptr;
+    }
+
+    json_parser_t *parser_ = nullptr;
+    const json_token_t *token_ = nullptr;
+};
+
+// Key and value of one object member, e.g. for(auto [key, value] : object.items())
+struct member
+{
+    std::string_view key;
+    json::value value;
+};
+
+inline json::value element_iterator::operator*() const noexcept
+{
+    return json::value(parser_, token_);
+}
+
+inline json::member member_iterator::operator*() const noexcept
+{
+    size_t length = 0;
+    const char *key = json_token_string(parser_, token_, &length);
+    return json::member{key ? std::string_view(key, length) : std::string_view(), json::value(parser_, token_ + 1)};
+}
+
+// Owns a compiled json_schema_t. Schemas are referenced by address from the fields of other
+// schemas, so they neither copy nor move.
+class schema
+{
+public:
+    template <size_t N>
+    explicit schema(const json_field_t (&fields)[N]) noexcept : error_(json_schema_compile(&schema_, fields, N)) {}
+
+    schema(const schema &) = delete;
+    schema &operator=(const schema &) = delete;
+
+    ~schema()
+    {
+        json_schema_free(&schema_);
+    }
+
+    json_error_t error() const noexcept
+    {
+        return error_;
+    }
+
+    // For JSON_BIND_OBJECT
+    const json_schema_t *get() const noexcept
+    {
+        return &schema_;
+    }
+
+    // For setting max_depth and max_string
+    json_schema_t *get() noexcept
+    {
+        return &schema_;
+    }
+
+private:
+    json_schema_t schema_;
+    json_error_t error_;
+};
+
+// Decodes the object in `json` straight into `target`, see json_bind
+template <typename T>
+json_error_t bind(const schema &fields, std::string_view json, T &target, size_t *error_pos = nullptr) noexcept
+{
+    static_assert(std::is_trivially_copyable<T>::value, "json_bind writes members byte-wise");
+    return json_bind(fields.get(), json.data(), json.size(), &target, error_pos);
+}
+
+// Owns a parser and releases it once. The input is referenced, not copied, and must outlive
+// the document. Documents move but do not copy; a moved-from document may only be destroyed
+// or assigned to.
+class document
+{
+public:
+    document() noexcept
+    {
+        json_parser_init(&parser_, nullptr, 0);
+    }
+
+    explicit document(json_arena_t *arena) noexcept
+    {
+        json_parser_init_arena(&parser_, nullptr, 0, arena);
+    }
+
+    document(const document &) = delete;
+    document &operator=(const document &) = delete;
+
+    document(document &&other) noexcept : parser_(other.parser_)
+    {
+        std::memset(&other.parser_, 0, sizeof(other.parser_));
+    }
+
+    document &operator=(document &&other) noexcept
+    {
+        if(this != &other)
+        {
+            json_parser_free(&parser_);
+            parser_ = other.parser_;
+            std::memset(&other.parser_, 0, sizeof(other.parser_));
+        }
+
+        return *this;
+    }
+
+    ~document()
+    {
+        json_parser_free(&parser_);
+    }
+
+    // Parses `json`, reusing the token array and settings of the previous parse
+    json_error_t parse(std::string_view json) noexcept
+    {
+        json_parser_reset(&parser_, json.data(), json.size());
+        return json_parser_parse(&parser_);
+    }
+
+    json_error_t error() const noexcept
+    {
+        return parser_.error;
+    }
+
+    // The root value, missing unless the last parse succeeded
+    json::value root() noexcept
+    {
+        return parser_.error == JSON_ERROR_NONE && parser_.token_count ? json::value(&parser_, parser_.tokens) : json::value();
+    }
+
+    json::value operator[](std::string_view key) noexcept
+    {
+        return root()[key];
+    }
+
+    json::value operator[](size_t index) noexcept
+    {
+        return root()[index];
+    }
+
+    // The underlying parser, e.g. to set flags or limits before parse()
+    json_parser_t *get() noexcept
+    {
+        return &parser_;
+    }
+
+private:
+    json_parser_t parser_;
+};
+}
+
+#endif /* JSON_PARSER_HPP */
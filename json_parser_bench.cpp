@@ -0,0 +1,238 @@
+/**
+    @brief JSON Parser Library
+
+    A lightweight, single-header C library for parsing JSON data. Designed for simplicity and portability, this parser provides a low-footprint solution to decode JSON-formatted strings into structured tokens while adhering to core JSON specifications.
+
+    @date 2025-05-03
+    @version 1.0
+    @author Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license MIT License
+*/
+
+#include <benchmark/benchmark.h>
+#include "json_parser.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+
+// Heap allocations made by the library, counted in json_parser_bench_hooks.c
+extern "C" size_t json_bench_allocations;
+
+// Corpus generators. Each one appends records until the document reaches `size` bytes,
+// so every shape can be measured at several sizes with the same content mix.
+static std::string Numbers(size_t size)
+{
+    std::mt19937_64 rng(1);
+    std::uniform_real_distribution<double> real(-1e6, 1e6);
+    std::string json = "[";
+    char buffer[32];
+
+    for(int i = 0; json.size() < size; ++i)
+    {
+        if(i % 2)
+        {
+            snprintf(buffer, sizeof(buffer), "%.17g", real(rng));
+        }
+        else
+        {
+            snprintf(buffer, sizeof(buffer), "%lld", (long long)(rng() >> 4));
+        }
+
+        json += i ? "," : "";
+        json += buffer;
+    }
+
+    return json + "]";
+}
+
+static std::string Strings(size_t size)
+{
+    std::string json = "[";
+
+    for(int i = 0; json.size() < size; ++i)
+    {
+        json += i ? "," : "";
+        json += "{\"title\":\"" + std::string(40 + i % 200, 'a' + i % 26) + "\",\"body\":\"" +
+                std::string(200 + i % 800, 'k') + " lorem ipsum dolor sit amet\"}";
+    }
+
+    return json + "]";
+}
+
+static std::string Nested(size_t size)
+{
+    std::string json = "[";
+
+    for(int i = 0; json.size() < size; ++i)
+    {
+        json += i ? "," : "";
+
+        for(int d = 0; d < 24; ++d)
+        {
+            json += d % 2 ? "[" : "{\"k\":";
+        }
+
+        json += std::to_string(i);
+
+        for(int d = 23; d >= 0; --d)
+        {
+            json += d % 2 ? "]" : "}";
+        }
+    }
+
+    return json + "]";
+}
+
+static std::string Escapes(size_t size)
+{
+    std::string json = "[";
+
+    for(int i = 0; json.size() < size; ++i)
+    {
+        json += i ? "," : "";
+        json += "\"line\\none\\ttab \\\"quoted\\\" back\\\\slash \\u00e9\\u4e2d\\ud83d\\ude00 end\"";
+    }
+
+    return json + "]";
+}
+
+// Shaped after the twitter.json status feed: nested user objects, many short keys, text
+static std::string Twitter(size_t size)
+{
+    std::string json = "{\"statuses\":[";
+
+    for(int i = 0; json.size() < size; ++i)
+    {
+        std::string id = std::to_string(505874924095815681LL + i);
+        json += i ? "," : "";
+        json += "{\"created_at\":\"Sun Aug 31 00:29:15 +0000 2014\",\"id\":" + id + ",\"id_str\":\"" + id +
+                "\",\"text\":\"@aym0566x \\u540d\\u524d:\\u524d\\u7530\\u3042\\u3086\\u307f http://t.co/x\","
+                "\"truncated\":false,\"in_reply_to_status_id\":null,\"user\":{\"id\":1186275104,"
+                "\"name\":\"AYUMI\",\"screen_name\":\"ayuu0123\",\"followers_count\":262,\"friends_count\":252,"
+                "\"verified\":false,\"profile_image_url\":\"http://pbs.twimg.com/profile_images/1.jpeg\"},"
+                "\"entities\":{\"hashtags\":[],\"urls\":[],\"user_mentions\":[{\"screen_name\":\"aym0566x\","
+                "\"indices\":[0,9]}]},\"retweet_count\":0,\"favorited\":false,\"lang\":\"ja\"}";
+    }
+
+    return json + "],\"search_metadata\":{\"count\":100}}";
+}
+
+// Shaped after canada.json: GeoJSON polygons, i.e. long arrays of coordinate pairs
+static std::string Canada(size_t size)
+{
+    std::mt19937_64 rng(2);
+    std::uniform_real_distribution<double> lon(-141.0, -52.0);
+    std::uniform_real_distribution<double> lat(41.0, 83.0);
+    std::string json = "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"geometry\":"
+                       "{\"type\":\"Polygon\",\"coordinates\":[[";
+    char buffer[64];
+
+    for(int i = 0; json.size() < size; ++i)
+    {
+        snprintf(buffer, sizeof(buffer), "%s[%.15f,%.15f]", i ? "," : "", lon(rng), lat(rng));
+        json += buffer;
+    }
+
+    return json + "]]}}]}";
+}
+
+// Shaped after citm_catalog.json: maps keyed by numeric ids, integer arrays, sparse nulls
+static std::string Citm(size_t size)
+{
+    std::string json = "{\"events\":{";
+
+    for(int i = 0; json.size() < size; ++i)
+    {
+        std::string id = std::to_string(138586341 + i);
+        json += i ? "," : "";
+        json += "\"" + id + "\":{\"description\":null,\"id\":" + id + ",\"logo\":null,\"name\":\"Concert " +
+                std::to_string(i) + "\",\"subTopicIds\":[337184269,337184283],\"subjectCode\":null,"
+                "\"subtitle\":null,\"topicIds\":[324846099,107888604]}";
+    }
+
+    return json + "}}";
+}
+
+static std::string LargeFile(size_t)
+{
+    std::ifstream file(JSON_BENCH_DATA_DIR "/large_json_file.json", std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static const std::string &Corpus(std::string (*generate)(size_t), size_t size)
+{
+    // Generated once per shape and size, benchmark runs each case more than once
+    static std::map<std::pair<uintptr_t, size_t>, std::string> cache;
+    std::string &json = cache[std::make_pair(reinterpret_cast<uintptr_t>(generate), size)];
+
+    if(json.empty())
+    {
+        json = generate(size);
+    }
+
+    return json;
+}
+
+static void BM_Parse(benchmark::State &state, std::string (*generate)(size_t), unsigned int flags)
+{
+    const std::string &json = Corpus(generate, (size_t)state.range(0));
+
+    if(json.empty())
+    {
+        state.SkipWithError("corpus not found");
+        return;
+    }
+
+    size_t tokens = 0;
+    size_t allocs = json_bench_allocations;
+
+    for(auto _ : state)
+    {
+        json_parser_t parser;
+        json_parser_init(&parser, json.data(), json.size());
+        parser.flags = flags;
+        parser.max_depth = 64;
+        parser.max_string = json.size();
+
+        if(json_parser_parse(&parser) != JSON_ERROR_NONE)
+        {
+            state.SkipWithError(json_error_string(parser.error));
+            json_parser_free(&parser);
+            break;
+        }
+
+        tokens = parser.token_count;
+        benchmark::DoNotOptimize(parser.tokens);
+        json_parser_free(&parser);
+    }
+
+    state.SetBytesProcessed((int64_t)(state.iterations() * json.size()));
+    state.counters["bytes"] = (double)json.size();
+    state.counters["tokens"] = (double)tokens;
+    state.counters["ns/token"] = benchmark::Counter((double)tokens, benchmark::Counter::kIsIterationInvariantRate |
+                                 benchmark::Counter::kInvert);
+    state.counters["allocs/parse"] = benchmark::Counter((double)(json_bench_allocations - allocs), benchmark::Counter::kAvgIterations);
+}
+
+#define JSON_BENCH_SIZES ->Arg(16 << 10)->Arg(256 << 10)->Arg(4 << 20)
+
+#define JSON_BENCH_CORPUS(name, generate)                                                          \
+    BENCHMARK_CAPTURE(BM_Parse, name, generate, 0u) JSON_BENCH_SIZES;                              \
+    BENCHMARK_CAPTURE(BM_Parse, name##_zero_copy, generate, (unsigned int)JSON_FLAG_ZERO_COPY) JSON_BENCH_SIZES
+
+BENCHMARK_CAPTURE(BM_Parse, large_json_file, LargeFile, 0u)->Arg(0);
+BENCHMARK_CAPTURE(BM_Parse, large_json_file_zero_copy, LargeFile, (unsigned int)JSON_FLAG_ZERO_COPY)->Arg(0);
+JSON_BENCH_CORPUS(numbers, Numbers);
+JSON_BENCH_CORPUS(strings, Strings);
+JSON_BENCH_CORPUS(nested, Nested);
+JSON_BENCH_CORPUS(escapes, Escapes);
+JSON_BENCH_CORPUS(twitter, Twitter);
+JSON_BENCH_CORPUS(canada, Canada);
+JSON_BENCH_CORPUS(citm, Citm);
+
+BENCHMARK_MAIN();
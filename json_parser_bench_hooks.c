@@ -0,0 +1,42 @@
+/**
+    @brief JSON Parser Library
+
+    A lightweight, single-header C library for parsing JSON data. Designed for simplicity and portability, this parser provides a low-footprint solution to decode JSON-formatted strings into structured tokens while adhering to core JSON specifications.
+
+    @date 2025-05-03
+    @version 1.0
+    @author Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license MIT License
+*/
+
+// The implementation for json_parser_bench, with every heap allocation counted
+#include <stdlib.h>
+
+size_t json_bench_allocations = 0;
+
+static void *json_bench_malloc(size_t size)
+{
+    json_bench_allocations++;
+    return malloc(size);
+}
+
+static void *json_bench_calloc(size_t count, size_t size)
+{
+    json_bench_allocations++;
+    return calloc(count, size);
+}
+
+static void *json_bench_realloc(void *ptr, size_t size)
+{
+    json_bench_allocations++;
+    return realloc(ptr, size);
+}
+
+#define JSON_MALLOC(size) json_bench_malloc(size)
+#define JSON_CALLOC(count, size) json_bench_calloc(count, size)
+#define JSON_REALLOC(ptr, size) json_bench_realloc(ptr, size)
+#define JSON_FREE(ptr) free(ptr)
+
+#define JSON_PARSER_IMPLEMENTATION
+#include "json_parser.h"
@@ -12,8 +12,17 @@
 
 #include <gtest/gtest.h>
 #include "json_parser.h"
+#include "json_parser.hpp"
 #include <string>
 #include <vector>
+#include <random>
+#include <clocale>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include <thread>
 
 class JsonParserTest : public ::testing::Test
 {
@@ -338,6 +347,2444 @@ TEST_F(JsonParserTest, ValidComplexStructure)
     ASSERT_GE(count, 10); // Verify token count matches structure
 }
 
+// Test: Zero-copy strings reference the input and decode escapes on demand
+TEST_F(JsonParserTest, ZeroCopyStrings)
+{
+    const char *json = R"({"plain": "value", "escaped": "a\nb\u00D0"})";
+    json_parser_init(&parser, json, strlen(json));
+    parser.flags |= JSON_FLAG_ZERO_COPY;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    size_t count;
+    const json_token_t *tokens = json_get_tokens(&parser, &count);
+    ASSERT_EQ(count, 5);
+    EXPECT_EQ(parser.string_count, 0);
+    EXPECT_EQ(tokens[2].flags, JSON_TOKEN_FLAG_RAW);
+    EXPECT_EQ(tokens[2].value.string, json + tokens[2].start);
+    size_t length;
+    const char *value = json_token_string(&parser, &tokens[2], &length);
+    EXPECT_EQ(std::string(value, length), "value");
+    EXPECT_EQ(tokens[4].flags, JSON_TOKEN_FLAG_RAW | JSON_TOKEN_FLAG_ESCAPED);
+    value = json_token_string(&parser, &tokens[4], &length);
+    EXPECT_EQ(std::string(value, length), "a\nb\xC3\x90");
+    EXPECT_EQ(tokens[4].flags, 0);
+    EXPECT_EQ(parser.string_count, 1);
+    EXPECT_EQ(json_token_string(&parser, &tokens[0], &length), nullptr);
+}
+
+// Test: Zero-copy mode applies the same string validation and limits
+TEST_F(JsonParserTest, ZeroCopyStringErrors)
+{
+    std::string long_str(JSON_DEFAULT_MAX_STRING, 'a');
+    std::string json = "[\"" + long_str + "\"]";
+    json_parser_init(&parser, json.c_str(), json.size());
+    parser.flags |= JSON_FLAG_ZERO_COPY;
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_STRING_TOO_LONG);
+    json_parser_free(&parser);
+    const char *invalid = "[\"\\x\"]";
+    json_parser_init(&parser, invalid, strlen(invalid));
+    parser.flags |= JSON_FLAG_ZERO_COPY;
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_INVALID_ESCAPE);
+}
+
+// Test: Tokens and strings are served from a caller-provided arena
+TEST_F(JsonParserTest, ArenaUserBuffer)
+{
+    alignas(16) static char buffer[64 * 1024];
+    json_arena_t arena;
+    ASSERT_EQ(json_arena_init(&arena, buffer, sizeof(buffer)), JSON_ERROR_NONE);
+    const char *json = R"({"name": "John\u00D0e", "tags": ["a", "b"], "age": 30})";
+    json_parser_init_arena(&parser, json, strlen(json), &arena);
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    size_t count;
+    const json_token_t *tokens = json_get_tokens(&parser, &count);
+    ASSERT_EQ(count, 9);
+    EXPECT_GE((const char *)tokens, buffer);
+    EXPECT_LT((const char *)tokens, buffer + sizeof(buffer));
+    EXPECT_STREQ(tokens[2].value.string, "JohnÐe");
+    EXPECT_GE(tokens[2].value.string, buffer);
+    EXPECT_LT(tokens[2].value.string, buffer + sizeof(buffer));
+    EXPECT_EQ(parser.string_count, 0);
+    json_parser_free(&parser);
+    EXPECT_EQ(arena.low, 0);
+    EXPECT_EQ(arena.high, sizeof(buffer));
+    json_arena_free(&arena);
+}
+
+// Test: Token growth stays inside the arena and reports exhaustion
+TEST_F(JsonParserTest, ArenaGrowthAndExhaustion)
+{
+    std::string json = "[";
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        json += (i ? ",1" : "1");
+    }
+
+    json += "]";
+    json_arena_t arena;
+    ASSERT_EQ(json_arena_init(&arena, NULL, 1001 * sizeof(json_token_t) + JSON_ARENA_ALIGNMENT), JSON_ERROR_NONE);
+    json_parser_init_arena(&parser, json.c_str(), json.size(), &arena);
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.token_count, 1001);
+    json_parser_free(&parser);
+    json += ",2]";
+    json.erase(json.size() - 4, 1);
+    json_parser_init_arena(&parser, json.c_str(), json.size(), &arena);
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_MAX_TOKENS);
+    json_parser_free(&parser);
+    json_arena_free(&arena);
+}
+
+// Test: Reset reuses the token buffer and options for the next document
+TEST_F(JsonParserTest, ResetKeepsCapacity)
+{
+    std::string big = "[";
+
+    for(int i = 0; i < 10000; ++i)
+    {
+        big += (i ? ",\"x\"" : "\"x\"");
+    }
+
+    big += "]";
+    json_parser_init(&parser, big.c_str(), big.size());
+    parser.max_depth = 4;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    const json_token_t *tokens_before = parser.tokens;
+    size_t cap_before = parser.token_cap;
+    ASSERT_GE(cap_before, 10001);
+    const char *json = R"({"a": ["b", 1]})";
+    json_parser_reset(&parser, json, strlen(json));
+    EXPECT_EQ(parser.max_depth, 4);
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.tokens, tokens_before);
+    EXPECT_EQ(parser.token_cap, cap_before);
+    EXPECT_EQ(parser.token_count, 5);
+    EXPECT_STREQ(parser.tokens[3].value.string, "b");
+    json_parser_reset(&parser, "{\"a\":", 5);
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_UNEXPECTED_CHAR);
+    json_parser_reset(&parser, "[[[[[]]]]]", 10);
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_NESTING_DEPTH);
+}
+
+// Test: Reset rewinds arena strings but keeps the arena token array
+TEST_F(JsonParserTest, ResetWithArena)
+{
+    std::vector<char> buffer(16 * 1024);
+    json_arena_t arena;
+    ASSERT_EQ(json_arena_init(&arena, buffer.data(), buffer.size()), JSON_ERROR_NONE);
+    const char *json = R"(["one", "two", "three"])";
+    json_parser_init_arena(&parser, json, strlen(json), &arena);
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    size_t high = arena.high;
+
+    for(int i = 0; i < 100; ++i)
+    {
+        json_parser_reset(&parser, json, strlen(json));
+        ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    }
+
+    EXPECT_EQ(arena.high, high);
+    EXPECT_EQ(parser.token_cap, 4);
+    EXPECT_STREQ(parser.tokens[3].value.string, "three");
+    json_parser_free(&parser);
+    json_arena_free(&arena);
+}
+
+// Test: The token pre-scan matches the parser's token count for valid input
+TEST_F(JsonParserTest, CountTokens)
+{
+    std::vector<std::string> test_cases =
+    {
+        "{}", "[]", "123", "\"str\"", "[true, false, null]",
+        R"({"a": [1, {"b": true}], "c": "x\"y\\", "d": -1.5e3})",
+        R"( [ "\\\"", {"k":"v"} , [ [ ] ] ] )"
+    };
+
+    for(const auto &json : test_cases)
+    {
+        json_parser_init(&parser, json.c_str(), json.size());
+        ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE) << "Failed for: " << json;
+        EXPECT_EQ(json_count_tokens(json.c_str(), json.size()), parser.token_count) << "Failed for: " << json;
+        json_parser_free(&parser);
+    }
+}
+
+// Test: Pre-scan sizes the token array exactly once
+TEST_F(JsonParserTest, PrescanAllocatesExactly)
+{
+    std::string json = "[";
+
+    for(int i = 0; i < 3000; ++i)
+    {
+        json += (i ? ",{\"id\":1}" : "{\"id\":1}");
+    }
+
+    json += "]";
+    json_parser_init(&parser, json.c_str(), json.size());
+    parser.flags |= JSON_FLAG_PRESCAN;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.token_count, 9001);
+    EXPECT_EQ(parser.token_cap, 9001);
+    json_parser_reset(&parser, json.c_str(), json.size());
+    ASSERT_EQ(json_parser_reserve(&parser, 100), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.token_cap, 9001);
+}
+
+// Parses json with the given flags and renders tokens and the error as text for comparison
+static std::string ParseToText(json_parser_t &p, const std::string &json, unsigned int flags)
+{
+    json_parser_init(&p, json.data(), json.size());
+    p.flags |= flags;
+    std::string out = json_error_string(json_parser_parse(&p));
+
+    for(size_t i = 0; i < p.token_count; i++)
+    {
+        const json_token_t &t = p.tokens[i];
+        out += "|" + std::to_string(t.type) + ":" + std::to_string(t.start) + "-" + std::to_string(t.end);
+
+        if(t.type == JSON_TOKEN_STRING && t.value.string)
+        {
+            out += "=" + std::string(t.value.string);
+        }
+    }
+
+    json_parser_free(&p);
+    return out;
+}
+
+// Test: The structural index produces the same tokens and errors as the scalar path
+TEST_F(JsonParserTest, StructuralIndexMatchesScalar)
+{
+    std::vector<std::string> test_cases =
+    {
+        "", "   ", "{}", " [ 1 , 2 ] ", "123abc", "[1x]", "{\"a\" : [true,false,null] }",
+        "\"unclosed", "[\"a\\\\\", \"b\\\"c\"]", "[1,]", "{\"k\":\"v\",}", "[\"\\x\"]",
+        "[\"" + std::string(300, 'a') + "\"]"
+    };
+
+    // Backslash runs and quotes straddling 64-byte block boundaries
+    for(int pad = 50; pad < 80; ++pad)
+    {
+        for(int run = 0; run < 5; ++run)
+        {
+            std::string doc = "[\"" + std::string(pad, 'x') + std::string(run, '\\') + "\"";
+
+            if(run % 2)
+            {
+                doc += "\"";
+            }
+
+            doc += "\t,\n  {\"key\":   12.5   }  ,\"tail\"]";
+            test_cases.push_back(doc);
+        }
+    }
+
+    for(const auto &json : test_cases)
+    {
+        EXPECT_EQ(ParseToText(parser, json, JSON_FLAG_STRUCTURAL_INDEX), ParseToText(parser, json, 0)) << "Failed for: " << json;
+    }
+
+    EXPECT_NE(json_structural_backend(), nullptr);
+}
+
+// Test: Reject unescaped control characters inside strings
+TEST_F(JsonParserTest, InvalidStringControlCharacter)
+{
+    std::vector<std::string> test_cases =
+    {
+        "\"a\tb\"", "\"line\nbreak\"", std::string("\"nul\0\"", 6), "[\"" + std::string(40, 'x') + "\x01\"]"
+    };
+
+    for(const auto &json : test_cases)
+    {
+        json_parser_init(&parser, json.data(), json.size());
+        EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_UNEXPECTED_CHAR);
+        json_parser_free(&parser);
+        json_parser_init(&parser, json.data(), json.size());
+        parser.flags |= JSON_FLAG_STRUCTURAL_INDEX;
+        EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_UNEXPECTED_CHAR);
+        json_parser_free(&parser);
+    }
+}
+
+// Test: Long runs between escapes are copied intact at every alignment
+TEST_F(JsonParserTest, LongStringsWithEscapes)
+{
+    for(size_t run = 0; run < 40; ++run)
+    {
+        std::string body(run, 'r');
+        std::string json = "\"" + body + "\\n" + body + "\\u00e9" + body + "\"";
+        std::string expected = body + "\n" + body + "\xC3\xA9" + body;
+        json_parser_init(&parser, json.data(), json.size());
+        ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE) << "Failed for run " << run;
+        EXPECT_EQ(std::string(parser.tokens[0].value.string), expected);
+        EXPECT_EQ(parser.tokens[0].end - parser.tokens[0].start, json.size() - 2);
+        json_parser_free(&parser);
+    }
+}
+
+// Parses a single number and returns its bit pattern
+static uint64_t ParseNumberBits(json_parser_t &p, const std::string &json)
+{
+    json_parser_init(&p, json.data(), json.size());
+    EXPECT_EQ(json_parser_parse(&p), JSON_ERROR_NONE) << "Failed for: " << json;
+    uint64_t bits = 0;
+
+    if(p.token_count == 1)
+    {
+        memcpy(&bits, &p.tokens[0].value.number, sizeof(bits));
+    }
+
+    json_parser_free(&p);
+    return bits;
+}
+
+static uint64_t StrtodBits(const std::string &json)
+{
+    double value = strtod(json.c_str(), nullptr);
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Test: The built-in decoder rounds exactly like a correctly rounded strtod
+TEST_F(JsonParserTest, NumberDecodingMatchesStrtod)
+{
+    std::vector<std::string> test_cases =
+    {
+        "0", "-0", "0.0", "1", "-1", "0.1", "0.3", "790.6", "1e22", "1e23", "-1.5e-7",
+        "9007199254740992", "9007199254740993", "9007199254740993.0000000001", "18446744073709551615",
+        "18446744073709551616", "123456789012345678901234567890", "2.2250738585072011e-308",
+        "2.2250738585072014e-308", "4.9e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+        "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308", "1e309", "1e-400",
+        "0.1000000000000000055511151231257827021181583404541015625", "7.2057594037927933e16",
+        "3.0e-1", "1e0000000000000000000022", "0e999999999", "123456789e-30", "8.98846567431158e307"
+    };
+    std::mt19937_64 rng(12345);
+
+    for(int i = 0; i < 5000; ++i)
+    {
+        uint64_t bits = rng();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+
+        if(value != value || value - value != 0)
+        {
+            continue; // Skip NaN and infinity
+        }
+
+        char text[64];
+        snprintf(text, sizeof(text), "%.*g", 1 + (int)(rng() % 17), value);
+        test_cases.push_back(text);
+        snprintf(text, sizeof(text), "%.17g", value);
+        test_cases.push_back(text);
+    }
+
+    for(const auto &json : test_cases)
+    {
+        EXPECT_EQ(ParseNumberBits(parser, json), StrtodBits(json)) << "Failed for: " << json;
+    }
+}
+
+// Test: Number decoding ignores the C locale and never reads past the input length
+TEST_F(JsonParserTest, NumberDecodingLocaleAndBounds)
+{
+    const char *locale = setlocale(LC_NUMERIC, "de_DE.UTF-8");
+    json_parser_init(&parser, "1.5", 3);
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.tokens[0].value.number, 1.5);
+    json_parser_free(&parser);
+
+    if(locale)
+    {
+        setlocale(LC_NUMERIC, "C");
+    }
+
+    const char digits[] = {'1', '2', '3'}; // Not NUL-terminated
+    json_parser_init(&parser, digits, 2);
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.tokens[0].value.number, 12.0);
+    json_parser_free(&parser);
+    json_parser_init(&parser, "1e5", 2);
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_INVALID_NUMBER);
+}
+
+// Test: Integer literals keep full 64-bit precision when integers are enabled
+TEST_F(JsonParserTest, IntegerTokens)
+{
+    const char *json = "[9007199254740993, -9223372036854775808, 18446744073709551615, 18446744073709551616, 1.0, 1e2, -0, 42]";
+    json_parser_init(&parser, json, strlen(json));
+    parser.flags |= JSON_FLAG_INTEGERS;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    size_t count;
+    const json_token_t *tokens = json_get_tokens(&parser, &count);
+    ASSERT_EQ(count, 9);
+    EXPECT_EQ(tokens[1].flags, JSON_TOKEN_FLAG_INTEGER);
+    EXPECT_EQ(tokens[1].value.integer, 9007199254740993LL);
+    EXPECT_EQ(tokens[2].flags, JSON_TOKEN_FLAG_INTEGER);
+    EXPECT_EQ(tokens[2].value.integer, INT64_MIN);
+    EXPECT_EQ(tokens[3].flags, JSON_TOKEN_FLAG_INTEGER | JSON_TOKEN_FLAG_UNSIGNED);
+    EXPECT_EQ(tokens[3].value.uinteger, UINT64_MAX);
+    // Out of range, fractional and exponent forms stay doubles
+    EXPECT_EQ(tokens[4].flags, 0);
+    EXPECT_EQ(tokens[4].value.number, 18446744073709551616.0);
+    EXPECT_EQ(tokens[5].flags, 0);
+    EXPECT_EQ(tokens[6].flags, 0);
+    EXPECT_EQ(tokens[7].flags, 0);
+    EXPECT_TRUE(std::signbit(tokens[7].value.number));
+    EXPECT_EQ(tokens[8].value.integer, 42);
+}
+
+// Test: Without the flag every number is still a double
+TEST_F(JsonParserTest, IntegerTokensDisabledByDefault)
+{
+    const char *json = "18446744073709551615";
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.tokens[0].flags, 0);
+    EXPECT_EQ(parser.tokens[0].value.number, 18446744073709551615.0);
+}
+
+// Test: Lazy numbers are validated during parsing and converted on access
+TEST_F(JsonParserTest, LazyNumbers)
+{
+    const char *json = "[1.5, -42, 18446744073709551615, 1e400, 3.0]";
+    json_parser_init(&parser, json, strlen(json));
+    parser.flags = JSON_FLAG_LAZY_NUMBERS | JSON_FLAG_INTEGERS;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    ASSERT_EQ(parser.token_count, 6);
+
+    for(size_t i = 1; i < parser.token_count; i++)
+    {
+        EXPECT_EQ(parser.tokens[i].flags, JSON_TOKEN_FLAG_LAZY);
+    }
+
+    EXPECT_EQ(json_token_get_double(&parser, &parser.tokens[1]), 1.5);
+    EXPECT_EQ(parser.tokens[1].flags, 0);
+    EXPECT_EQ(parser.tokens[1].value.number, 1.5);
+
+    int64_t i64 = 0;
+    uint64_t u64 = 0;
+    EXPECT_EQ(json_token_get_int64(&parser, &parser.tokens[2], &i64), JSON_ERROR_NONE);
+    EXPECT_EQ(i64, -42);
+    EXPECT_EQ(parser.tokens[2].flags, JSON_TOKEN_FLAG_INTEGER);
+    EXPECT_EQ(json_token_get_uint64(&parser, &parser.tokens[2], &u64), JSON_ERROR_INVALID_NUMBER);
+
+    EXPECT_EQ(json_token_get_int64(&parser, &parser.tokens[3], &i64), JSON_ERROR_INVALID_NUMBER);
+    EXPECT_EQ(json_token_get_uint64(&parser, &parser.tokens[3], &u64), JSON_ERROR_NONE);
+    EXPECT_EQ(u64, UINT64_MAX);
+
+    EXPECT_TRUE(std::isinf(json_token_get_double(&parser, &parser.tokens[4])));
+    EXPECT_EQ(json_token_get_int64(&parser, &parser.tokens[4], &i64), JSON_ERROR_INVALID_NUMBER);
+
+    EXPECT_EQ(json_token_get_int64(&parser, &parser.tokens[5], &i64), JSON_ERROR_NONE);
+    EXPECT_EQ(i64, 3);
+    EXPECT_EQ(json_token_get_int64(&parser, &parser.tokens[0], &i64), JSON_ERROR_INVALID_TOKEN);
+}
+
+// Test: Lazy mode still rejects malformed numbers
+TEST_F(JsonParserTest, LazyNumbersValidate)
+{
+    const char *cases[] = {"[01]", "[1.]", "[-]", "[1e+]"};
+
+    for(const char *json : cases)
+    {
+        json_parser_init(&parser, json, strlen(json));
+        parser.flags = JSON_FLAG_LAZY_NUMBERS;
+        EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_INVALID_NUMBER) << json;
+        json_parser_free(&parser);
+    }
+
+    const char *json = "[0.1]";
+    json_parser_init(&parser, json, strlen(json));
+    parser.flags = JSON_FLAG_LAZY_NUMBERS;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(json_token_get_double(&parser, &parser.tokens[1]), 0.1);
+}
+
+// Test: Containers record their child count and the index of their next sibling
+TEST_F(JsonParserTest, NavigationLinks)
+{
+    const char *json = "{\"a\": [1, [2, 3], {\"b\": 4}], \"c\": {}, \"d\": 5}";
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    ASSERT_EQ(parser.token_count, 14);
+
+    const json_token_t *t = parser.tokens;
+    EXPECT_EQ(t[0].size, 3u);
+    EXPECT_EQ(t[0].next, 14u);
+    EXPECT_EQ(t[2].size, 3u);
+    EXPECT_EQ(t[2].next, 10u);
+    EXPECT_EQ(t[4].size, 2u);
+    EXPECT_EQ(t[4].next, 7u);
+    EXPECT_EQ(t[11].size, 0u);
+    EXPECT_EQ(t[11].next, 12u);
+    EXPECT_EQ(t[3].size, 0u);
+    EXPECT_EQ(t[3].next, 4u);
+
+    // Third element of "a": hop over the first two siblings
+    size_t element = 3;
+    element = t[element].next;
+    element = t[element].next;
+    EXPECT_EQ(t[element].type, JSON_TOKEN_OBJECT);
+    EXPECT_EQ(element, 7u);
+
+    // The key after "a" follows its whole value
+    EXPECT_EQ(t[t[2].next].type, JSON_TOKEN_STRING);
+    EXPECT_STREQ(t[t[2].next].value.string, "c");
+}
+
+#ifdef JSON_PARENT_LINKS
+// Test: Every token points to its enclosing container
+TEST_F(JsonParserTest, ParentLinks)
+{
+    const char *json = "{\"a\": [1, {\"b\": 2}]}";
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    const unsigned int parents[] = {JSON_TOKEN_NO_PARENT, 0, 0, 2, 2, 4, 4};
+    ASSERT_EQ(parser.token_count, sizeof(parents) / sizeof(parents[0]));
+
+    for(size_t i = 0; i < parser.token_count; i++)
+    {
+        EXPECT_EQ(parser.tokens[i].parent, parents[i]) << i;
+    }
+}
+#endif
+
+// Test: Only the four RFC 8259 whitespace bytes separate tokens, in every entry point
+TEST_F(JsonParserTest, WhitespaceIsRfcOnly)
+{
+    const char *json = "[1,\t\r\n                   2]";
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.token_count, 3u);
+
+    for(const char *space : {"\v", "\f", "\xA0", "\xC2\xA0"})
+    {
+        // Put the byte after a long run so the SIMD skips reach it as well
+        std::string text = std::string("[1,") + std::string(40, ' ') + space + "2]";
+        json_parser_reset(&parser, text.data(), text.size());
+        EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_INVALID_TOKEN) << text;
+        EXPECT_EQ(parser.pos, 43u);
+        size_t pos = 0;
+        EXPECT_EQ(json_validate(text.data(), text.size(), JSON_DEFAULT_MAX_DEPTH, JSON_DEFAULT_MAX_STRING, &pos), JSON_ERROR_INVALID_TOKEN);
+        EXPECT_EQ(pos, 43u);
+        json_parser_reset(&parser, NULL, 0);
+        EXPECT_EQ(json_parser_feed(&parser, text.data(), text.size()), JSON_ERROR_INVALID_TOKEN);
+    }
+}
+
+#ifdef JSON_STRICT
+// Test: Strict builds reject trailing commas in objects in every entry point
+TEST_F(JsonParserTest, StrictTrailingComma)
+{
+    const char *json = "{\"a\": 1, }";
+    json_parser_init(&parser, json, strlen(json));
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_UNEXPECTED_CHAR);
+    EXPECT_EQ(parser.pos, 9u);
+    size_t pos = 0;
+    EXPECT_EQ(json_validate(json, strlen(json), JSON_DEFAULT_MAX_DEPTH, JSON_DEFAULT_MAX_STRING, &pos), JSON_ERROR_UNEXPECTED_CHAR);
+    EXPECT_EQ(pos, 9u);
+    json_parser_reset(&parser, NULL, 0);
+    EXPECT_EQ(json_parser_feed(&parser, json, strlen(json)), JSON_ERROR_UNEXPECTED_CHAR);
+}
+#endif
+
+#ifdef JSON_PARSER_STATS
+// Test: Parse statistics count what json_parser_parse did
+TEST_F(JsonParserTest, ParseStats)
+{
+    const char *json = "{\"a\": [1, 2.5, \"x\\n\\u0041\"], \"b\": {\"c\": {}}}";
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.stats.tokens, 10u);
+    EXPECT_EQ(parser.stats.token_reallocs, 0u);
+    EXPECT_EQ(parser.stats.string_bytes, 10u); // "a", "x\nA", "b" and "c" with terminators
+    EXPECT_EQ(parser.stats.escapes, 2u);
+    EXPECT_EQ(parser.stats.numbers, 2u);
+    EXPECT_EQ(parser.stats.max_depth, 3u);
+    EXPECT_GT(parser.stats.parse_cycles, 0u);
+    json_parser_free(&parser);
+
+    // Lazy numbers are counted when read, growth of the token array is counted per realloc
+    std::string array = "[";
+
+    for(int i = 0; i < 300; i++)
+    {
+        array += std::to_string(i) + ",";
+    }
+
+    array.back() = ']';
+    json_parser_init(&parser, array.c_str(), array.size());
+    parser.flags = JSON_FLAG_LAZY_NUMBERS;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.stats.tokens, 301u);
+    EXPECT_EQ(parser.stats.token_reallocs, 2u);
+    EXPECT_EQ(parser.stats.numbers, 0u);
+    EXPECT_EQ(json_token_get_double(&parser, &parser.tokens[5]), 4.0);
+    EXPECT_EQ(parser.stats.numbers, 1u);
+
+    // Every parse starts from zero
+    json_parser_reset(&parser, "[]", 2);
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.stats.tokens, 1u);
+    EXPECT_EQ(parser.stats.numbers, 0u);
+}
+#endif
+
+// Test: Object lookup by key on small and wide objects
+TEST_F(JsonParserTest, ObjectFind)
+{
+    std::string json = "{\"small\": {\"x\": 1, \"y\": [2]}, \"wide\": {";
+
+    for(int i = 0; i < 200; i++)
+    {
+        json += (i ? ", \"k" : "\"k") + std::to_string(i) + "\": " + std::to_string(i);
+    }
+
+    json += ", \"k7\": -1, \"esc\\u0041\": true}}";
+    json_parser_init(&parser, json.c_str(), json.size());
+    parser.flags = JSON_FLAG_ZERO_COPY | JSON_FLAG_INTEGERS;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+
+    const json_token_t *small = json_object_find(&parser, &parser.tokens[0], "small", 5);
+    ASSERT_NE(small, nullptr);
+    EXPECT_EQ(small->type, JSON_TOKEN_OBJECT);
+    const json_token_t *y = json_object_find(&parser, small, "y", 1);
+    ASSERT_NE(y, nullptr);
+    EXPECT_EQ(y->type, JSON_TOKEN_ARRAY);
+    EXPECT_EQ(json_object_find(&parser, small, "z", 1), nullptr);
+    EXPECT_EQ(small->value.index, nullptr);
+
+    const json_token_t *wide = json_object_find(&parser, &parser.tokens[0], "wide", 4);
+    ASSERT_NE(wide, nullptr);
+
+    for(int i = 0; i < 200; i++)
+    {
+        std::string key = "k" + std::to_string(i);
+        const json_token_t *value = json_object_find(&parser, wide, key.data(), key.size());
+        ASSERT_NE(value, nullptr) << key;
+        EXPECT_EQ(value->value.integer, i) << key;
+    }
+
+    EXPECT_NE(wide->value.index, nullptr);
+    EXPECT_EQ(json_object_find(&parser, wide, "k200", 4), nullptr);
+    EXPECT_EQ(json_object_find(&parser, wide, "k", 1), nullptr);
+    const json_token_t *esc = json_object_find(&parser, wide, "escA", 4);
+    ASSERT_NE(esc, nullptr);
+    EXPECT_EQ(esc->type, JSON_TOKEN_TRUE);
+    EXPECT_EQ(json_object_find(&parser, y, "x", 1), nullptr);
+}
+
+// Test: Eager key indexing, also from an arena
+TEST_F(JsonParserTest, ObjectFindEagerArena)
+{
+    std::string json = "[{";
+
+    for(int i = 0; i < JSON_OBJECT_INDEX_THRESHOLD; i++)
+    {
+        json += (i ? ", \"f" : "\"f") + std::to_string(i) + "\": \"v" + std::to_string(i) + "\"";
+    }
+
+    json += "}, {\"a\": 1}]";
+    static char buffer[16384];
+    json_arena_t arena;
+    ASSERT_EQ(json_arena_init(&arena, buffer, sizeof(buffer)), JSON_ERROR_NONE);
+    json_parser_init_arena(&parser, json.c_str(), json.size(), &arena);
+    parser.flags = JSON_FLAG_OBJECT_INDEX;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+
+    const json_token_t *wide = &parser.tokens[1];
+    const json_token_t *narrow = &parser.tokens[wide->next];
+    EXPECT_NE(wide->value.index, nullptr);
+    EXPECT_EQ(narrow->value.index, nullptr);
+
+    const json_token_t *value = json_object_find(&parser, wide, "f3", 2);
+    ASSERT_NE(value, nullptr);
+    EXPECT_STREQ(value->value.string, "v3");
+    ASSERT_NE(json_object_find(&parser, narrow, "a", 1), nullptr);
+
+    json_parser_reset(&parser, json.c_str(), json.size());
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_NE(json_object_find(&parser, &parser.tokens[1], "f15", 3), nullptr);
+    json_parser_free(&parser);
+    json_arena_free(&arena);
+}
+
+// Test: Strings with an escaped NUL keep their length on every access, copied or zero-copy
+TEST_F(JsonParserTest, EmbeddedNulLength)
+{
+    std::string json = "{\"a\\u0000b\": \"x\\u0000y\"";
+
+    for(int i = 0; i < JSON_OBJECT_INDEX_THRESHOLD; i++)
+    {
+        json += ", \"f" + std::to_string(i) + "\": " + std::to_string(i);
+    }
+
+    json += "}";
+    const char *text = json.c_str();
+
+    for(unsigned int flags : {0u, (unsigned int)JSON_FLAG_ZERO_COPY})
+    {
+        json_parser_init(&parser, text, json.size());
+        parser.flags = flags;
+        ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+
+        for(int pass = 0; pass < 2; pass++)
+        {
+            size_t length = 0;
+            const char *key = json_token_string(&parser, &parser.tokens[1], &length);
+            ASSERT_EQ(length, 3u) << "flags " << flags << " pass " << pass;
+            EXPECT_EQ(std::string(key, length), std::string("a\0b", 3));
+            const char *value = json_token_string(&parser, &parser.tokens[2], &length);
+            ASSERT_EQ(length, 3u) << "flags " << flags << " pass " << pass;
+            EXPECT_EQ(std::string(value, length), std::string("x\0y", 3));
+
+            const json_token_t *found = json_object_find(&parser, &parser.tokens[0], "a\0b", 3);
+            ASSERT_EQ(found, &parser.tokens[2]) << "flags " << flags << " pass " << pass;
+            EXPECT_EQ(json_object_find(&parser, &parser.tokens[0], "a", 1), nullptr);
+        }
+
+        json_parser_free(&parser);
+    }
+
+    json_parser_init(&parser, text, json.size());
+}
+
+// Test: Interned keys share one string per distinct key, across parses and with a shared table
+TEST_F(JsonParserTest, InternKeys)
+{
+    std::string json = "[";
+
+    for(int i = 0; i < 100; i++)
+    {
+        json += (i ? ", " : "") + std::string("{\"id\": ") + std::to_string(i) + ", \"na\\u006De\": \"id\", \"k" + std::to_string(i) + "\": 0}";
+    }
+
+    json += ", {\"a\\u0000b\": 1, \"\": 2}]";
+    json_parser_init(&parser, json.c_str(), json.size());
+    parser.flags = JSON_FLAG_INTERN_KEYS;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    ASSERT_NE(parser.intern, nullptr);
+    EXPECT_EQ(parser.intern->count, 104u);
+
+    const json_token_t *first = &parser.tokens[1];
+    const char *id = first[1].value.string;
+    const char *name = first[3].value.string;
+    EXPECT_STREQ(id, "id");
+    EXPECT_STREQ(name, "name");
+    EXPECT_EQ(first[1].flags, JSON_TOKEN_FLAG_INTERNED);
+    // Values are never interned, even when they equal a key
+    EXPECT_NE(first[4].value.string, id);
+    EXPECT_EQ(first[4].flags, 0u);
+
+    const json_token_t *last = &parser.tokens[parser.token_count - 5];
+
+    for(const json_token_t *obj = first; obj != last; obj = &parser.tokens[obj->next])
+    {
+        EXPECT_EQ(obj[1].value.string, id);
+        EXPECT_EQ(obj[3].value.string, name);
+    }
+
+    EXPECT_EQ(json_intern_find(parser.intern, "id", 2), id);
+    size_t length = 0;
+    EXPECT_EQ(memcmp(json_token_string(&parser, &last[1], &length), "a\0b", 3), 0);
+    EXPECT_EQ(length, 3u);
+    EXPECT_STREQ(json_token_string(&parser, &last[3], &length), "");
+    EXPECT_EQ(length, 0u);
+    ASSERT_NE(json_object_find(&parser, first, "name", 4), nullptr);
+    EXPECT_EQ(json_object_find(&parser, last, "a\0b", 3)->value.number, 1.0);
+
+    // The table outlives reset, so a second parse finds every key already there
+    json_parser_reset(&parser, json.c_str(), json.size());
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.intern->count, 104u);
+    EXPECT_EQ(parser.tokens[2].value.string, id);
+
+    // Push parsing interns the decoded keys in the same table
+    json_parser_t stream;
+    json_parser_init(&stream, NULL, 0);
+    stream.flags = JSON_FLAG_INTERN_KEYS;
+    stream.intern = parser.intern;
+    ASSERT_EQ(json_parser_feed(&stream, json.data(), json.size()), JSON_ERROR_NONE);
+    ASSERT_EQ(json_parser_finish(&stream), JSON_ERROR_NONE);
+    EXPECT_EQ(stream.tokens[4].value.string, name);
+    EXPECT_EQ(parser.intern->count, 104u);
+    json_parser_free(&stream);
+
+    // A read-only table is searched first; keys it lacks go to the parser's own table
+    json_intern_t shared;
+    json_intern_init(&shared);
+    const char *shared_id = json_intern(&shared, "id", 2);
+    ASSERT_NE(shared_id, nullptr);
+    EXPECT_EQ(json_intern(&shared, "id", 2), shared_id);
+    json_parser_t other;
+    json_parser_init(&other, "{\"id\": 1, \"x\": 2}", 17);
+    other.flags = JSON_FLAG_INTERN_KEYS;
+    other.intern_shared = &shared;
+    ASSERT_EQ(json_parser_parse(&other), JSON_ERROR_NONE);
+    EXPECT_EQ(other.tokens[1].value.string, shared_id);
+    EXPECT_STREQ(other.tokens[3].value.string, "x");
+    EXPECT_EQ(json_intern_find(&shared, "x", 1), nullptr);
+    EXPECT_EQ(other.intern->count, 1u);
+    json_parser_free(&other);
+    json_intern_free(&shared);
+
+    // Zero-copy keys already point into the input and are left alone
+    json_parser_free(&parser);
+    json_parser_init(&parser, json.c_str(), json.size());
+    parser.flags = JSON_FLAG_INTERN_KEYS | JSON_FLAG_ZERO_COPY;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.intern, nullptr);
+    EXPECT_EQ(parser.tokens[2].flags, JSON_TOKEN_FLAG_RAW);
+}
+
+// Test: A frozen document keeps every value after the parser and its input are gone
+TEST_F(JsonParserTest, FreezeIsSelfContained)
+{
+    std::string json = "{\"name\": \"caf\\u00e9\", \"n\": [1, -2, 18446744073709551615, 2.5, true, null], \"wide\": {";
+
+    for(int i = 0; i < 40; i++)
+    {
+        json += (i ? ", \"k" : "\"k") + std::to_string(i) + "\": " + std::to_string(i);
+    }
+
+    json += ", \"k3\": -1}, \"nul\": \"a\\u0000b\"}";
+    std::vector<uint64_t> copy;
+
+    {
+        std::string input = json;
+        json_parser_init(&parser, input.c_str(), input.size());
+        parser.flags = JSON_FLAG_ZERO_COPY | JSON_FLAG_INTEGERS | JSON_FLAG_LAZY_NUMBERS;
+        ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+
+        size_t size = 0;
+        ASSERT_EQ(json_freeze(&parser, NULL, 0, &size), JSON_ERROR_NONE);
+        EXPECT_EQ(size % 8, 0u);
+        std::vector<uint64_t> small(size / 8 - 1);
+        EXPECT_EQ(json_freeze(&parser, small.data(), small.size() * 8, NULL), JSON_ERROR_BUFFER_FULL);
+
+        json_frozen_t *frozen = NULL;
+        ASSERT_EQ(json_freeze_alloc(&parser, &frozen), JSON_ERROR_NONE);
+        EXPECT_EQ(frozen->size, size);
+        EXPECT_EQ(frozen->token_count, parser.token_count);
+        // Offsets only, so the bytes work at any other aligned address
+        copy.assign((uint64_t *)frozen, (uint64_t *)frozen + size / 8);
+        json_frozen_free(frozen);
+        json_parser_free(&parser);
+        input.assign(input.size(), 'x');
+    }
+
+    const json_frozen_t *frozen = (const json_frozen_t *)copy.data();
+    EXPECT_EQ(frozen->magic, JSON_FROZEN_MAGIC);
+    EXPECT_EQ(frozen->version, (uint32_t)JSON_FROZEN_VERSION);
+    const json_frozen_token_t *root = JSON_FROZEN_TOKENS(frozen);
+    EXPECT_EQ(root->type, JSON_TOKEN_OBJECT);
+    EXPECT_EQ(root->next, frozen->token_count);
+    EXPECT_EQ(root->offset, 0u);
+    EXPECT_EQ(sizeof(json_frozen_token_t), 16u);
+
+    size_t length = 0;
+    const json_frozen_token_t *name = json_frozen_find(frozen, root, "name", 4);
+    ASSERT_NE(name, nullptr);
+    EXPECT_STREQ(json_frozen_string(frozen, name, &length), "caf\xC3\xA9");
+    EXPECT_EQ(length, 5u);
+    const json_frozen_token_t *nul = json_frozen_find(frozen, root, "nul", 3);
+    ASSERT_NE(nul, nullptr);
+    const char *bytes = json_frozen_string(frozen, nul, &length);
+    EXPECT_EQ(std::string(bytes, length), std::string("a\0b", 3));
+    EXPECT_EQ(json_frozen_string(frozen, root, &length), nullptr);
+
+    const json_frozen_token_t *n = json_frozen_find(frozen, root, "n", 1);
+    ASSERT_NE(n, nullptr);
+    ASSERT_EQ(n->size, 6u);
+    EXPECT_EQ(n[1].flags, JSON_TOKEN_FLAG_INTEGER);
+    EXPECT_EQ(json_frozen_value(frozen, &n[1])->integer, 1);
+    EXPECT_EQ(json_frozen_value(frozen, &n[2])->integer, -2);
+    EXPECT_EQ(n[3].flags, JSON_TOKEN_FLAG_INTEGER | JSON_TOKEN_FLAG_UNSIGNED);
+    EXPECT_EQ(json_frozen_value(frozen, &n[3])->uinteger, UINT64_MAX);
+    EXPECT_EQ(n[4].flags, 0u);
+    EXPECT_EQ(json_frozen_value(frozen, &n[4])->number, 2.5);
+    EXPECT_EQ(json_frozen_value(frozen, &n[5]), nullptr);
+    EXPECT_EQ(n[5].type, JSON_TOKEN_TRUE);
+    EXPECT_EQ(n[6].type, JSON_TOKEN_NULL);
+
+    // Large objects carry a key table, duplicates resolve to the first member
+    const json_frozen_token_t *wide = json_frozen_find(frozen, root, "wide", 4);
+    ASSERT_NE(wide, nullptr);
+    EXPECT_NE(wide->offset, 0u);
+
+    for(int i = 0; i < 40; i++)
+    {
+        std::string key = "k" + std::to_string(i);
+        const json_frozen_token_t *value = json_frozen_find(frozen, wide, key.data(), key.size());
+        ASSERT_NE(value, nullptr) << key;
+        EXPECT_EQ(json_frozen_value(frozen, value)->integer, i) << key;
+    }
+
+    EXPECT_EQ(json_frozen_find(frozen, wide, "k40", 3), nullptr);
+    EXPECT_EQ(json_frozen_find(frozen, n, "k1", 2), nullptr);
+    EXPECT_EQ(json_frozen_find(frozen, root, "missing", 7), nullptr);
+
+    json_parser_init(&parser, "[1,", 3);
+    EXPECT_NE(json_parser_parse(&parser), JSON_ERROR_NONE);
+    json_frozen_t *failed = NULL;
+    EXPECT_EQ(json_freeze_alloc(&parser, &failed), parser.error);
+    EXPECT_EQ(failed, nullptr);
+}
+
+// Test: Pooled parsers are handed out once each and keep their settings between uses
+TEST(JsonPoolTest, AcquireRelease)
+{
+    json_parser_pool_t pool;
+    ASSERT_EQ(json_parser_pool_init(&pool, 2), JSON_ERROR_NONE);
+    json_parser_t *a = json_parser_pool_acquire(&pool, "[1]", 3);
+    json_parser_t *b = json_parser_pool_acquire(&pool, "{\"k\": \"v\"}", 10);
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(json_parser_pool_acquire(&pool, "[]", 2), nullptr);
+
+    b->flags = JSON_FLAG_INTEGERS;
+    ASSERT_EQ(json_parser_parse(a), JSON_ERROR_NONE);
+    ASSERT_EQ(json_parser_parse(b), JSON_ERROR_NONE);
+    EXPECT_STREQ(b->tokens[2].value.string, "v");
+    json_parser_pool_release(&pool, b);
+    EXPECT_EQ(b->token_count, 0u);
+
+    json_parser_t *c = json_parser_pool_acquire(&pool, "[7]", 3);
+    EXPECT_EQ(c, b);
+    ASSERT_EQ(json_parser_parse(c), JSON_ERROR_NONE);
+    EXPECT_EQ(c->tokens[1].flags, JSON_TOKEN_FLAG_INTEGER);
+    json_parser_pool_release(&pool, a);
+    json_parser_pool_release(&pool, c);
+    json_parser_pool_free(&pool);
+
+    ASSERT_EQ(json_parser_pool_init(&pool, 0), JSON_ERROR_NONE);
+    EXPECT_EQ(json_parser_pool_acquire(&pool, "[]", 2), nullptr);
+    json_parser_pool_free(&pool);
+}
+
+// Test: Threads share one pool and one frozen document without locks
+TEST(JsonPoolTest, ThreadsShareFrozenDocument)
+{
+    json_parser_t source;
+    const char *config = "{\"workers\": 8, \"name\": \"pool\"}";
+    json_parser_init(&source, config, strlen(config));
+    ASSERT_EQ(json_parser_parse(&source), JSON_ERROR_NONE);
+    json_frozen_t *frozen = NULL;
+    ASSERT_EQ(json_freeze_alloc(&source, &frozen), JSON_ERROR_NONE);
+    json_parser_free(&source);
+
+    json_parser_pool_t pool;
+    ASSERT_EQ(json_parser_pool_init(&pool, 3), JSON_ERROR_NONE);
+    std::vector<std::thread> threads;
+    std::vector<int> failures(6);
+
+    for(size_t t = 0; t < failures.size(); t++)
+    {
+        threads.emplace_back([&, t]
+        {
+            for(int i = 0; i < 2000; i++)
+            {
+                std::string json = "[" + std::to_string(t) + ", " + std::to_string(i) + "]";
+                json_parser_t *parser = json_parser_pool_acquire(&pool, json.data(), json.size());
+
+                if(!parser)
+                {
+                    continue;
+                }
+
+                const json_frozen_token_t *workers = json_frozen_find(frozen, JSON_FROZEN_TOKENS(frozen), "workers", 7);
+                failures[t] += json_parser_parse(parser) != JSON_ERROR_NONE || parser->tokens[1].value.number != (double)t ||
+                               parser->tokens[2].value.number != (double)i || !workers || json_frozen_value(frozen, workers)->number != 8.0;
+                json_parser_pool_release(&pool, parser);
+            }
+        });
+    }
+
+    for(auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    for(size_t t = 0; t < failures.size(); t++)
+    {
+        EXPECT_EQ(failures[t], 0) << t;
+    }
+
+    // Every parser came back
+    json_parser_t *held[3];
+
+    for(auto &parser : held)
+    {
+        parser = json_parser_pool_acquire(&pool, "[]", 2);
+        EXPECT_NE(parser, nullptr);
+    }
+
+    EXPECT_EQ(json_parser_pool_acquire(&pool, "[]", 2), nullptr);
+    json_parser_pool_free(&pool);
+    json_frozen_free(frozen);
+}
+
+static void WriteFile(const char *path, const std::string &contents)
+{
+    FILE *file = fopen(path, "wb");
+    ASSERT_NE(file, nullptr);
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+}
+
+static std::string ReadFile(const char *path)
+{
+    std::string contents;
+    FILE *file = fopen(path, "rb");
+
+    if(file)
+    {
+        char buffer[4096];
+        size_t got;
+
+        while((got = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            contents.append(buffer, got);
+        }
+
+        fclose(file);
+    }
+
+    return contents;
+}
+
+// Test: Tapes reload without parsing and are rebuilt when damaged, stale or missing
+TEST_F(JsonParserTest, TapeReloadAndFallback)
+{
+    const char *source = "json_parser_test_tape.json";
+    const char *path = "json_parser_test_tape.bin";
+    WriteFile(source, "{\"name\": \"tape\", \"n\": [1, 2.5]}");
+    remove(path);
+
+    ASSERT_EQ(json_parser_init_file(&parser, source), JSON_ERROR_NONE);
+    parser.flags = JSON_FLAG_INTEGERS;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    ASSERT_EQ(json_tape_save(&parser, path, source), JSON_ERROR_NONE);
+    json_parser_free(&parser);
+
+    json_tape_t tape;
+    ASSERT_EQ(json_tape_load(&tape, path, source), JSON_ERROR_NONE);
+    EXPECT_FALSE(tape.reparsed);
+#if defined(__unix__) || defined(__APPLE__)
+    EXPECT_TRUE(tape.file_mapped);
+#endif
+    const json_frozen_token_t *root = JSON_FROZEN_TOKENS(tape.frozen);
+    const json_frozen_token_t *n = json_frozen_find(tape.frozen, root, "n", 1);
+    ASSERT_NE(n, nullptr);
+    EXPECT_EQ(n[1].flags, JSON_TOKEN_FLAG_INTEGER);
+    EXPECT_EQ(json_frozen_value(tape.frozen, &n[1])->integer, 1);
+    EXPECT_EQ(json_frozen_value(tape.frozen, &n[2])->number, 2.5);
+    json_tape_free(&tape);
+    EXPECT_EQ(tape.frozen, nullptr);
+
+    // A flipped bit fails the checksum; open falls back to the source and rewrites the tape
+    std::string bytes = ReadFile(path);
+    ASSERT_GT(bytes.size(), 64u);
+    std::string damaged = bytes;
+    damaged[bytes.size() - 3] ^= 1;
+    WriteFile(path, damaged);
+    EXPECT_EQ(json_tape_load(&tape, path, source), JSON_ERROR_CORRUPT);
+    ASSERT_EQ(json_tape_open(&tape, path, source, JSON_FLAG_INTEGERS), JSON_ERROR_NONE);
+    EXPECT_TRUE(tape.reparsed);
+    size_t length = 0;
+    EXPECT_STREQ(json_frozen_string(tape.frozen, json_frozen_find(tape.frozen, JSON_FROZEN_TOKENS(tape.frozen), "name", 4), &length), "tape");
+    json_tape_free(&tape);
+    EXPECT_EQ(ReadFile(path), bytes);
+    ASSERT_EQ(json_tape_open(&tape, path, source, JSON_FLAG_INTEGERS), JSON_ERROR_NONE);
+    EXPECT_FALSE(tape.reparsed);
+    json_tape_free(&tape);
+
+    WriteFile(path, bytes.substr(0, 20));
+    EXPECT_EQ(json_tape_load(&tape, path, source), JSON_ERROR_CORRUPT);
+    WriteFile(path, bytes);
+
+    // An edited source makes the tape stale
+    WriteFile(source, "{\"name\": \"edited\"}");
+    EXPECT_EQ(json_tape_load(&tape, path, source), JSON_ERROR_STALE);
+    EXPECT_EQ(tape.frozen, nullptr);
+    ASSERT_EQ(json_tape_open(&tape, path, source, 0), JSON_ERROR_NONE);
+    EXPECT_TRUE(tape.reparsed);
+    EXPECT_STREQ(json_frozen_string(tape.frozen, JSON_FROZEN_TOKENS(tape.frozen) + 2, NULL), "edited");
+    json_tape_free(&tape);
+
+    // Without a source the tape is trusted as it is
+    WriteFile(source, "{\"name\": \"edited again\"}");
+    ASSERT_EQ(json_tape_load(&tape, path, NULL), JSON_ERROR_NONE);
+    EXPECT_STREQ(json_frozen_string(tape.frozen, JSON_FROZEN_TOKENS(tape.frozen) + 2, NULL), "edited");
+    json_tape_free(&tape);
+
+    WriteFile(source, "{\"name\": ");
+    EXPECT_EQ(json_tape_open(&tape, "json_parser_test_missing.bin", source, 0), JSON_ERROR_UNEXPECTED_CHAR);
+    EXPECT_EQ(tape.frozen, nullptr);
+    remove(source);
+    remove(path);
+    EXPECT_EQ(json_tape_load(&tape, path, NULL), JSON_ERROR_IO);
+    EXPECT_EQ(json_tape_open(&tape, path, source, 0), JSON_ERROR_IO);
+    EXPECT_STREQ(json_error_string(JSON_ERROR_STALE), "Binary data is older than its source");
+    EXPECT_STREQ(json_error_string(JSON_ERROR_TOO_LARGE), "Document too large to freeze");
+    json_tape_free(&tape);
+}
+
+// Test: Damaged frozen documents are rejected before any accessor reads them
+TEST_F(JsonParserTest, FrozenCheck)
+{
+    const char *json = "{\"a\": [1, {\"b\": \"c\"}], \"d\": null}";
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    size_t size = 0;
+    ASSERT_EQ(json_freeze(&parser, NULL, 0, &size), JSON_ERROR_NONE);
+    std::vector<uint64_t> blob(size / 8 + 1);
+    ASSERT_EQ(json_freeze(&parser, blob.data(), size, NULL), JSON_ERROR_NONE);
+    ASSERT_EQ(json_frozen_check(blob.data(), size), JSON_ERROR_NONE);
+    EXPECT_EQ(json_frozen_check(blob.data(), size + 8), JSON_ERROR_CORRUPT);
+    EXPECT_EQ(json_frozen_check((char *)blob.data() + 4, size - 4), JSON_ERROR_CORRUPT);
+
+    std::vector<uint64_t> copy = blob;
+    json_frozen_token_t *tokens = (json_frozen_token_t *)((json_frozen_t *)copy.data() + 1);
+    auto expect_corrupt = [&](const char *what)
+    {
+        EXPECT_EQ(json_frozen_check(copy.data(), size), JSON_ERROR_CORRUPT) << what;
+        copy = blob;
+        tokens = (json_frozen_token_t *)((json_frozen_t *)copy.data() + 1);
+    };
+
+    tokens[0].next = 3;
+    expect_corrupt("root next");
+    tokens[2].size = 3;
+    expect_corrupt("array size");
+    tokens[3].next = 3;
+    expect_corrupt("backward next");
+    tokens[1].type = JSON_TOKEN_NUMBER;
+    expect_corrupt("key type");
+    tokens[1].offset = (uint32_t)size - 1;
+    expect_corrupt("string offset");
+    tokens[1].size = 1000;
+    expect_corrupt("string length");
+    tokens[3].offset += 4;
+    expect_corrupt("number offset");
+    tokens[8].size = 1;
+    expect_corrupt("literal size");
+    tokens[0].offset = 4;
+    expect_corrupt("key table");
+    ((json_frozen_t *)copy.data())->version++;
+    expect_corrupt("version");
+}
+
+// Test: JSON Pointer compilation follows RFC 6901
+TEST(JsonPathTest, Compile)
+{
+    json_path_t path;
+    ASSERT_EQ(json_path_compile(&path, "/a~1b/~0c/*/12/012", 18), JSON_ERROR_NONE);
+    ASSERT_EQ(path.count, 5);
+    EXPECT_EQ(std::string(path.segments[0].name, path.segments[0].length), "a/b");
+    EXPECT_EQ(std::string(path.segments[1].name, path.segments[1].length), "~c");
+    EXPECT_TRUE(path.segments[2].wildcard);
+    EXPECT_EQ(path.segments[3].index, 12u);
+    EXPECT_EQ(path.segments[4].index, SIZE_MAX);
+    EXPECT_TRUE(path.wildcard);
+    json_path_free(&path);
+
+    ASSERT_EQ(json_path_compile(&path, "", 0), JSON_ERROR_NONE);
+    EXPECT_EQ(path.count, 0);
+    json_path_free(&path);
+
+    EXPECT_EQ(json_path_compile(&path, "a/b", 3), JSON_ERROR_INVALID_TOKEN);
+    EXPECT_EQ(json_path_compile(&path, "/a~2", 4), JSON_ERROR_INVALID_ESCAPE);
+    EXPECT_EQ(path.segments, nullptr);
+}
+
+static std::vector<std::string> QueryPath(const std::string &json, const char *pointer, size_t max_matches, json_error_t *error)
+{
+    json_path_t path;
+    std::vector<json_path_match_t> matches(max_matches);
+    std::vector<std::string> values;
+    size_t count = 0;
+
+    if(json_path_compile(&path, pointer, strlen(pointer)) != JSON_ERROR_NONE)
+    {
+        *error = JSON_ERROR_INVALID_TOKEN;
+        return values;
+    }
+
+    *error = json_path_query(&path, json.data(), json.size(), matches.data(), max_matches, &count);
+
+    for(size_t i = 0; i < count; i++)
+    {
+        values.push_back(json.substr(matches[i].start, matches[i].end - matches[i].start));
+    }
+
+    json_path_free(&path);
+    return values;
+}
+
+// Test: Path queries return the spans of matching values
+TEST(JsonPathTest, Query)
+{
+    const std::string json = "{\"meta\": {\"skip\": [1, {\"x\": \"}]\\\"\"}]}, "
+                             "\"entries\": [{\"id\": 1, \"n\": \"a\"}, {\"n\": \"b\", \"id\": [2, 3]}, {\"id\": \"three\"}, 4], "
+                             "\"a/b\": {\"~\": true}, \"k\\u00e9y\": null}";
+    json_error_t error;
+
+    std::vector<std::string> ids = QueryPath(json, "/entries/*/id", 10, &error);
+    EXPECT_EQ(error, JSON_ERROR_NONE);
+    ASSERT_EQ(ids.size(), 3u);
+    EXPECT_EQ(ids[0], "1");
+    EXPECT_EQ(ids[1], "[2, 3]");
+    EXPECT_EQ(ids[2], "\"three\"");
+
+    EXPECT_EQ(QueryPath(json, "/entries/1/id/1", 1, &error), std::vector<std::string> {"3"});
+    EXPECT_EQ(QueryPath(json, "/a~1b/~0", 1, &error), std::vector<std::string> {"true"});
+    EXPECT_EQ(QueryPath(json, "/k\xc3\xa9y", 1, &error), std::vector<std::string> {"null"});
+    EXPECT_EQ(QueryPath(json, "/meta/skip/1/x", 1, &error), std::vector<std::string> {"\"}]\\\"\""});
+    EXPECT_EQ(QueryPath(json, "", 1, &error), std::vector<std::string> {json});
+    EXPECT_TRUE(QueryPath(json, "/entries/4", 1, &error).empty());
+    EXPECT_EQ(error, JSON_ERROR_NONE);
+    EXPECT_TRUE(QueryPath(json, "/meta/skip/0/x", 1, &error).empty());
+    EXPECT_EQ(error, JSON_ERROR_NONE);
+
+    // A full scan still rejects broken structure
+    QueryPath("{\"a\": [1, 2}", "/b", 1, &error);
+    EXPECT_EQ(error, JSON_ERROR_UNEXPECTED_CHAR);
+    QueryPath("{\"a\": 1} x", "/b", 1, &error);
+    EXPECT_EQ(error, JSON_ERROR_TRAILING_CHARS);
+}
+
+// Test: Queries stop as soon as enough matches were found
+TEST(JsonPathTest, EarlyTermination)
+{
+    const std::string json = "{\"id\": 7, \"rest\": [1, 2, 3, <garbage";
+    json_error_t error;
+    EXPECT_EQ(QueryPath(json, "/id", 1, &error), std::vector<std::string> {"7"});
+    EXPECT_EQ(error, JSON_ERROR_NONE);
+
+    const std::string list = "[{\"v\": 1}, {\"v\": 2}, {\"v\": 3}, <garbage";
+    EXPECT_EQ(QueryPath(list, "/*/v", 2, &error), (std::vector<std::string> {"1", "2"}));
+    EXPECT_EQ(error, JSON_ERROR_NONE);
+    QueryPath(list, "/*/v", 5, &error);
+    EXPECT_EQ(error, JSON_ERROR_UNEXPECTED_CHAR);
+}
+
+static void ExpectSameTokens(const json_parser_t &a, const json_parser_t &b, const std::string &label)
+{
+    ASSERT_EQ(a.token_count, b.token_count) << label;
+
+    for(size_t i = 0; i < a.token_count; i++)
+    {
+        const json_token_t &x = a.tokens[i];
+        const json_token_t &y = b.tokens[i];
+        ASSERT_EQ(x.type, y.type) << label << " token " << i;
+        ASSERT_EQ(x.start, y.start) << label << " token " << i;
+        ASSERT_EQ(x.end, y.end) << label << " token " << i;
+        ASSERT_EQ(x.size, y.size) << label << " token " << i;
+        ASSERT_EQ(x.next, y.next) << label << " token " << i;
+        ASSERT_EQ(x.flags, y.flags) << label << " token " << i;
+#ifdef JSON_PARENT_LINKS
+        ASSERT_EQ(x.parent, y.parent) << label << " token " << i;
+#endif
+
+        if(x.type == JSON_TOKEN_STRING)
+        {
+            ASSERT_STREQ(x.value.string, y.value.string) << label << " token " << i;
+        }
+        else if(x.type == JSON_TOKEN_NUMBER)
+        {
+            ASSERT_EQ(x.value.uinteger, y.value.uinteger) << label << " token " << i;
+        }
+    }
+}
+
+// Test: Feeding any split of a document gives the same tokens as one contiguous parse
+TEST_F(JsonParserTest, FeedMatchesParse)
+{
+    const std::string json = " {\"k\\u00e9y\": [1, -2.5e3, 18446744073709551615, true, false, null],"
+                             " \"s\": \"a\\\"b\\\\c\\n\\ud83d\\ude00\\/\", \"o\": {\"e\": {}, \"a\": []}, \"n\": 0.1} ";
+    json_parser_init(&parser, json.c_str(), json.size());
+    parser.flags = JSON_FLAG_INTEGERS;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+
+    for(size_t step = 1; step <= json.size(); step++)
+    {
+        json_parser_t stream;
+        json_parser_init(&stream, NULL, 0);
+        stream.flags = JSON_FLAG_INTEGERS;
+        json_error_t error = JSON_ERROR_NEED_MORE;
+
+        for(size_t pos = 0; pos < json.size(); pos += step)
+        {
+            error = json_parser_feed(&stream, json.data() + pos, std::min(step, json.size() - pos));
+            // Complete as soon as the closing brace arrives, trailing whitespace is still accepted
+            ASSERT_EQ(error, pos + step < json.size() - 1 ? JSON_ERROR_NEED_MORE : JSON_ERROR_NONE) << "step " << step << " pos " << pos;
+        }
+
+        ASSERT_EQ(error, JSON_ERROR_NONE) << "step " << step;
+        ASSERT_EQ(json_parser_finish(&stream), JSON_ERROR_NONE);
+        ExpectSameTokens(parser, stream, "step " + std::to_string(step));
+        json_parser_free(&stream);
+    }
+}
+
+// Test: Empty strings and keys arrive before any byte has been buffered
+TEST_F(JsonParserTest, FeedEmptyStrings)
+{
+    for(unsigned int flags : {0u, (unsigned int)JSON_FLAG_INTERN_KEYS})
+    {
+        json_parser_init(&parser, NULL, 0);
+        parser.flags = flags;
+        ASSERT_EQ(json_parser_feed(&parser, "{\"\": [\"\"]}", 10), JSON_ERROR_NONE);
+        ASSERT_EQ(json_parser_finish(&parser), JSON_ERROR_NONE);
+        ASSERT_EQ(parser.token_count, 4);
+
+        for(size_t i : {1, 3})
+        {
+            size_t length = 1;
+            const char *value = json_token_string(&parser, &parser.tokens[i], &length);
+            ASSERT_NE(value, nullptr);
+            EXPECT_EQ(length, 0u);
+            EXPECT_STREQ(value, "");
+        }
+
+        json_parser_free(&parser);
+    }
+
+    json_parser_init(&parser, NULL, 0);
+}
+
+// Test: Push parsing reports truncation, trailing data and errors split across chunks
+TEST_F(JsonParserTest, FeedErrors)
+{
+    json_parser_init(&parser, NULL, 0);
+    EXPECT_EQ(json_parser_feed(&parser, "[1, 2", 5), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_finish(&parser), JSON_ERROR_UNEXPECTED_CHAR);
+    json_parser_free(&parser);
+
+    // A root number is only complete at the end of input
+    json_parser_init(&parser, NULL, 0);
+    EXPECT_EQ(json_parser_feed(&parser, "12", 2), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_feed(&parser, "34", 2), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_finish(&parser), JSON_ERROR_NONE);
+    ASSERT_EQ(parser.token_count, 1);
+    EXPECT_EQ(parser.tokens[0].value.number, 1234.0);
+    json_parser_free(&parser);
+
+    json_parser_init(&parser, NULL, 0);
+    EXPECT_EQ(json_parser_feed(&parser, "{} ", 3), JSON_ERROR_NONE);
+    EXPECT_EQ(json_parser_feed(&parser, "\n", 1), JSON_ERROR_NONE);
+    EXPECT_EQ(json_parser_feed(&parser, "x", 1), JSON_ERROR_TRAILING_CHARS);
+    EXPECT_EQ(json_parser_feed(&parser, " ", 1), JSON_ERROR_TRAILING_CHARS);
+    json_parser_free(&parser);
+
+    json_parser_init(&parser, NULL, 0);
+    EXPECT_EQ(json_parser_feed(&parser, "[\"\\", 3), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_feed(&parser, "x\"]", 3), JSON_ERROR_INVALID_ESCAPE);
+    json_parser_free(&parser);
+
+    json_parser_init(&parser, NULL, 0);
+    EXPECT_EQ(json_parser_feed(&parser, "[\"\\ud83d", 8), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_feed(&parser, "\\u0041\"]", 8), JSON_ERROR_INVALID_UNICODE);
+    json_parser_free(&parser);
+
+    json_parser_init(&parser, NULL, 0);
+    EXPECT_EQ(json_parser_feed(&parser, "[tr", 3), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_feed(&parser, "ue, fals", 8), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_feed(&parser, "y]", 2), JSON_ERROR_INVALID_TOKEN);
+    json_parser_free(&parser);
+
+    json_parser_init(&parser, NULL, 0);
+    parser.max_depth = 2;
+    EXPECT_EQ(json_parser_feed(&parser, "[[", 2), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_feed(&parser, "[", 1), JSON_ERROR_NESTING_DEPTH);
+    json_parser_free(&parser);
+
+    json_parser_init(&parser, NULL, 0);
+    EXPECT_EQ(json_parser_feed(&parser, "  ", 2), JSON_ERROR_NEED_MORE);
+    EXPECT_EQ(json_parser_finish(&parser), JSON_ERROR_EMPTY_INPUT);
+    json_parser_free(&parser);
+
+    const struct
+    {
+        const char *json;
+        json_error_t error;
+    } cases[] =
+    {
+        {"{\"a\":]", JSON_ERROR_INVALID_TOKEN},
+        {"[0x]", JSON_ERROR_INVALID_NUMBER},
+        {"[1, 0x1]", JSON_ERROR_INVALID_NUMBER},
+        {"[.23", JSON_ERROR_INVALID_NUMBER},
+        {"[1, -", JSON_ERROR_INVALID_NUMBER},
+        {"t", JSON_ERROR_INVALID_TOKEN},
+        {"[tr", JSON_ERROR_INVALID_TOKEN},
+        {"\"t\\u", JSON_ERROR_INVALID_UNICODE},
+        {"[\"\\ud83d\\u00", JSON_ERROR_INVALID_UNICODE},
+        {"[1e5x]", JSON_ERROR_UNEXPECTED_CHAR},
+        {"[1, 2", JSON_ERROR_UNEXPECTED_CHAR},
+    };
+    std::vector<std::string> docs;
+
+    for(const auto &c : cases)
+    {
+        json_parser_init(&parser, c.json, strlen(c.json));
+        EXPECT_EQ(json_parser_parse(&parser), c.error) << c.json;
+        json_parser_free(&parser);
+        docs.push_back(c.json);
+    }
+
+    // Every chunking fails exactly like json_parser_parse over the whole document
+    const std::string seed = "{\"a\": [1, -2.5e+3, true, false, null, \"x\\u00e9\\ud83d\\ude00\\n\"], \"b\": {\"c\": {}, \"d\": [0]}}";
+    const char replacements[] = {'"', ',', ':', ']', '}', '[', '{', 'x', '0', '-', '.', 'e', 't', 'u', '\\', '\n', '\0'};
+
+    for(size_t i = 0; i < seed.size(); ++i)
+    {
+        docs.push_back(seed.substr(0, i));
+
+        for(char r : replacements)
+        {
+            std::string doc = seed;
+            doc[i] = r;
+            docs.push_back(doc);
+        }
+    }
+
+    for(const std::string &doc : docs)
+    {
+        json_parser_init(&parser, doc.data(), doc.size());
+        json_error_t expected = json_parser_parse(&parser);
+        json_parser_free(&parser);
+
+        for(size_t chunk : {1, 3})
+        {
+            json_parser_init(&parser, NULL, 0);
+            json_error_t error = JSON_ERROR_NEED_MORE;
+
+            for(size_t i = 0; i < doc.size() && (error == JSON_ERROR_NONE || error == JSON_ERROR_NEED_MORE); i += chunk)
+            {
+                error = json_parser_feed(&parser, doc.data() + i, std::min(chunk, doc.size() - i));
+            }
+
+            if(error == JSON_ERROR_NONE || error == JSON_ERROR_NEED_MORE)
+            {
+                error = json_parser_finish(&parser);
+            }
+
+            EXPECT_EQ(error, expected) << doc << " in chunks of " << chunk;
+            json_parser_free(&parser);
+        }
+    }
+
+    json_parser_init(&parser, NULL, 0);
+}
+
+// Test: Misspelled literals are rejected by the contiguous parser too
+TEST_F(JsonParserTest, InvalidLiteral)
+{
+    const char *json = "[tru]";
+    json_parser_init(&parser, json, strlen(json));
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_INVALID_TOKEN);
+}
+
+// Test: Nesting far beyond the C stack is bounded only by max_depth
+TEST_F(JsonParserTest, DeepNestingIsIterative)
+{
+    const size_t depth = 200000;
+    std::string json(depth, '[');
+    json.append(depth, ']');
+    json_parser_init(&parser, json.c_str(), json.size());
+    parser.max_depth = depth;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    ASSERT_EQ(parser.token_count, depth);
+    EXPECT_EQ(parser.tokens[0].next, depth);
+    EXPECT_EQ(parser.tokens[depth - 2].size, 1);
+    EXPECT_EQ(parser.tokens[depth - 1].size, 0);
+    EXPECT_EQ(parser.tokens[depth - 1].start, depth - 1);
+    EXPECT_EQ(parser.tokens[depth - 1].end, depth + 1);
+
+    // The frame stack is kept, one level too deep still fails cleanly
+    json.insert(0, "{\"a\":");
+    json += "}";
+    json_parser_reset(&parser, json.c_str(), json.size());
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_NESTING_DEPTH);
+    json_parser_reset(&parser, json.c_str(), json.size());
+    parser.max_depth = depth + 1;
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.tokens[0].size, 1);
+}
+
+// Test: Splitting a large array across threads gives the tokens of a sequential parse
+TEST_F(JsonParserTest, ParallelMatchesSequential)
+{
+    std::string items;
+
+    for(int i = 0; i < 600; ++i)
+    {
+        items += i ? ", " : "";
+
+        switch(i % 4)
+        {
+            case 0:
+                items += "{\"id\": " + std::to_string(i) + ", \"s\": \"a,]\\\"b\\u00e9\", \"n\": [[], {}, -1.5e3]}";
+                break;
+
+            case 1:
+                items += "\"x,y]\"";
+                break;
+
+            case 2:
+                items += "[" + std::string(i % 50, '1').insert(0, "9") + ", true, null]";
+                break;
+
+            default:
+                items += std::to_string(i);
+        }
+    }
+
+    const std::string docs[] =
+    {
+        "{\"meta\": {\"v\": [1, 2]}, \"items\": [" + items + "], \"tail\": [false]}",
+        " [" + items + "] ",
+    };
+    const char *paths[] = {"/items", ""};
+
+    for(int d = 0; d < 2; ++d)
+    {
+        json_path_t path;
+        ASSERT_EQ(json_path_compile(&path, paths[d], strlen(paths[d])), JSON_ERROR_NONE);
+        json_parser_init(&parser, docs[d].c_str(), docs[d].size());
+        parser.flags = JSON_FLAG_INTEGERS;
+        ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+
+        for(unsigned int threads : {1u, 2u, 3u, 7u})
+        {
+            json_parser_t split;
+            json_parser_init(&split, docs[d].c_str(), docs[d].size());
+            split.flags = JSON_FLAG_INTEGERS | JSON_FLAG_PRESCAN | JSON_FLAG_STRUCTURAL_INDEX;
+            ASSERT_EQ(json_parser_parse_parallel(&split, &path, threads), JSON_ERROR_NONE);
+            ExpectSameTokens(parser, split, std::string(paths[d]) + " threads " + std::to_string(threads));
+            json_parser_free(&split);
+        }
+
+        json_parser_free(&parser);
+        json_path_free(&path);
+    }
+
+    json_parser_init(&parser, NULL, 0);
+}
+
+// Test: Errors inside and around the split array match a sequential parse
+TEST_F(JsonParserTest, ParallelErrors)
+{
+    std::string items;
+
+    for(int i = 0; i < 200; ++i)
+    {
+        items += i ? ", [" : "[";
+        items += std::to_string(i) + "]";
+    }
+
+    const std::string docs[] =
+    {
+        "{\"a\": [" + items + ", [1 2]]}",
+        "{\"a\": [" + items + ",]}",
+        "{\"a\": [" + items + "], \"b\": tru}",
+        "{\"x\": [\"unterminated], \"a\": [" + items + "]}",
+        "{\"a\": [" + items + ", [[[[1]]]]]}",
+        "{\"a\": [ ]}",
+        "{\"a\": {\"b\": 1}}",
+    };
+    json_path_t path;
+    ASSERT_EQ(json_path_compile(&path, "/a", 2), JSON_ERROR_NONE);
+
+    for(const std::string &doc : docs)
+    {
+        json_parser_init(&parser, doc.c_str(), doc.size());
+        parser.max_depth = 5;
+        json_error_t expected = json_parser_parse(&parser);
+        json_parser_t split;
+        json_parser_init(&split, doc.c_str(), doc.size());
+        split.max_depth = 5;
+        ASSERT_EQ(json_parser_parse_parallel(&split, &path, 4), expected) << doc;
+        EXPECT_EQ(split.pos, parser.pos) << doc;
+
+        if(expected == JSON_ERROR_NONE)
+        {
+            ExpectSameTokens(parser, split, doc);
+        }
+
+        json_parser_free(&split);
+        json_parser_free(&parser);
+    }
+
+    json_path_free(&path);
+    json_parser_init(&parser, NULL, 0);
+}
+
+// Test: Files are parsed straight from a read-only mapping that the parser owns
+TEST_F(JsonParserTest, InitFile)
+{
+    const char *path = "json_parser_test_input.json";
+    const char *json = "{\"name\": \"mapped\", \"n\": [1, 2]}\n";
+    FILE *file = fopen(path, "wb");
+    ASSERT_NE(file, nullptr);
+    fputs(json, file);
+    fclose(file);
+
+    ASSERT_EQ(json_parser_init_file(&parser, path), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.length, strlen(json));
+#if defined(__unix__) || defined(__APPLE__)
+    EXPECT_TRUE(parser.file_mapped);
+#endif
+    parser.flags = JSON_FLAG_ZERO_COPY;
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    ASSERT_EQ(parser.token_count, 7);
+    size_t length;
+    const char *name = json_token_string(&parser, &parser.tokens[2], &length);
+    EXPECT_EQ(std::string(name, length), "mapped");
+    EXPECT_GE(name, parser.json);
+    EXPECT_LT(name, parser.json + parser.length);
+    json_parser_free(&parser);
+    EXPECT_EQ(parser.file, nullptr);
+
+    // Empty files and special files take the read fallback
+    file = fopen(path, "wb");
+    ASSERT_NE(file, nullptr);
+    fclose(file);
+    ASSERT_EQ(json_parser_init_file(&parser, path), JSON_ERROR_NONE);
+    EXPECT_FALSE(parser.file_mapped);
+    EXPECT_EQ(json_parser_parse(&parser), JSON_ERROR_EMPTY_INPUT);
+    json_parser_free(&parser);
+    remove(path);
+
+#if defined(__unix__) || defined(__APPLE__)
+    ASSERT_EQ(json_parser_init_file(&parser, "/dev/null"), JSON_ERROR_NONE);
+    EXPECT_EQ(parser.length, 0);
+    json_parser_free(&parser);
+#endif
+
+    EXPECT_EQ(json_parser_init_file(&parser, path), JSON_ERROR_IO);
+    EXPECT_STREQ(json_error_string(JSON_ERROR_IO), "Cannot read file");
+}
+
+// Test: Validation reports the same error and offset as a full parse
+TEST_F(JsonParserTest, ValidateMatchesParse)
+{
+    const std::string seed = " {\"a\": [1, -2.5e+3, true, false, null, \"x\\u00e9\\n\"], \"b\": {\"c\": {}, \"d\": []}, \"e\": 0.5} ";
+    std::vector<std::string> docs = {"", "  ", "[1,]", "{\"a\":1,}", "[1 2]", "{\"a\" 1}", "[tru]", "01", "[\"\\x\"]", "1 2", "[[[[1]]]]"};
+    const char replacements[] = {'"', ',', ':', ']', '}', '[', '{', 'x', '1', '-', '\\', '\n', '\0'};
+
+    for(size_t i = 0; i < seed.size(); ++i)
+    {
+        docs.push_back(seed.substr(0, i));
+
+        for(char r : replacements)
+        {
+            std::string doc = seed;
+            doc[i] = r;
+            docs.push_back(doc);
+        }
+    }
+
+    for(const std::string &doc : docs)
+    {
+        json_parser_init(&parser, doc.data(), doc.size());
+        parser.max_depth = 3;
+        parser.max_string = 8;
+        json_error_t expected = json_parser_parse(&parser);
+        size_t pos = 12345;
+        ASSERT_EQ(json_validate(doc.data(), doc.size(), 3, 8, &pos), expected) << doc;
+        EXPECT_EQ(pos, expected == JSON_ERROR_NONE ? 0 : parser.pos) << doc;
+        json_parser_free(&parser);
+    }
+
+    // Nesting beyond the inline bit stack
+    std::string deep(JSON_VALIDATE_INLINE_DEPTH * 3, '[');
+    deep.insert(deep.size() / 2, "{\"k\":");
+    deep.append(JSON_VALIDATE_INLINE_DEPTH * 3 / 2, ']');
+    deep += "}";
+    deep.append(JSON_VALIDATE_INLINE_DEPTH * 3 / 2, ']');
+    EXPECT_EQ(json_validate(deep.data(), deep.size(), deep.size(), 8, NULL), JSON_ERROR_NONE);
+    EXPECT_EQ(json_validate(deep.data(), deep.size(), JSON_VALIDATE_INLINE_DEPTH * 3, 8, NULL), JSON_ERROR_NESTING_DEPTH);
+    deep[deep.size() - 2] = '}';
+    EXPECT_EQ(json_validate(deep.data(), deep.size(), deep.size(), 8, NULL), JSON_ERROR_UNEXPECTED_CHAR);
+    json_parser_init(&parser, NULL, 0);
+}
+
+struct SaxLog
+{
+    std::string events;
+    std::string skip_key;
+    std::string stop_at;
+    bool skip_arrays = false;
+
+    json_sax_action_t Add(const std::string &event)
+    {
+        events += event + " ";
+        return event == stop_at ? JSON_SAX_STOP : JSON_SAX_CONTINUE;
+    }
+};
+
+static json_sax_handler_t SaxLogHandler()
+{
+    json_sax_handler_t handler = {};
+    handler.on_object_begin = [](void *u) { return static_cast<SaxLog *>(u)->Add("{"); };
+    handler.on_object_end = [](void *u) { return static_cast<SaxLog *>(u)->Add("}"); };
+    handler.on_array_begin = [](void *u)
+    {
+        SaxLog *log = static_cast<SaxLog *>(u);
+        return log->skip_arrays ? JSON_SAX_SKIP : log->Add("[");
+    };
+    handler.on_array_end = [](void *u) { return static_cast<SaxLog *>(u)->Add("]"); };
+    handler.on_key = [](void *u, const char *key, size_t length)
+    {
+        SaxLog *log = static_cast<SaxLog *>(u);
+        std::string name(key, length);
+        json_sax_action_t action = log->Add("k:" + name);
+        return name == log->skip_key ? JSON_SAX_SKIP : action;
+    };
+    handler.on_string = [](void *u, const char *value, size_t length)
+    {
+        return static_cast<SaxLog *>(u)->Add("s:" + std::string(value, length));
+    };
+    handler.on_number = [](void *u, const json_token_t *token)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "n:%g", token->value.number);
+        return static_cast<SaxLog *>(u)->Add(text);
+    };
+    handler.on_boolean = [](void *u, int value) { return static_cast<SaxLog *>(u)->Add(value ? "true" : "false"); };
+    handler.on_null = [](void *u) { return static_cast<SaxLog *>(u)->Add("null"); };
+    handler.on_end = [](void *u) { static_cast<SaxLog *>(u)->Add("end"); };
+    return handler;
+}
+
+// Test: SAX parsing reports every value in document order without keeping tokens
+TEST_F(JsonParserTest, SaxEvents)
+{
+    const char *json = "{\"a\": [1, \"x\\ty\", {\"b\": null}], \"c\": true, \"d\\u0041\": {}}";
+    json_sax_handler_t handler = SaxLogHandler();
+    SaxLog log;
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse_sax(&parser, &handler, &log), JSON_ERROR_NONE);
+    EXPECT_EQ(log.events, "{ k:a [ n:1 s:x\ty { k:b null } ] k:c true k:dA { } } end ");
+    EXPECT_EQ(parser.token_count, 0);
+    EXPECT_EQ(parser.flags, 0u);
+}
+
+// Test: Callbacks can skip subtrees and stop the parse
+TEST_F(JsonParserTest, SaxSkipAndStop)
+{
+    const char *json = "{\"a\": [1, {\"b\": 2}], \"skip\": {\"x\": [3]}, \"c\": 4}";
+    json_sax_handler_t handler = SaxLogHandler();
+    json_parser_init(&parser, json, strlen(json));
+
+    SaxLog by_key;
+    by_key.skip_key = "skip";
+    ASSERT_EQ(json_parser_parse_sax(&parser, &handler, &by_key), JSON_ERROR_NONE);
+    EXPECT_EQ(by_key.events, "{ k:a [ n:1 { k:b n:2 } ] k:skip k:c n:4 } end ");
+
+    SaxLog no_arrays;
+    no_arrays.skip_arrays = true;
+    json_parser_reset(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse_sax(&parser, &handler, &no_arrays), JSON_ERROR_NONE);
+    EXPECT_EQ(no_arrays.events, "{ k:a k:skip { k:x } k:c n:4 } end ");
+
+    SaxLog stop;
+    stop.stop_at = "n:2";
+    json_parser_reset(&parser, json, strlen(json));
+    EXPECT_EQ(json_parser_parse_sax(&parser, &handler, &stop), JSON_ERROR_ABORTED);
+    EXPECT_EQ(stop.events, "{ k:a [ n:1 { k:b n:2 ");
+
+    // Skipped subtrees are still validated
+    const char *bad = "{\"skip\": [1, 2,], \"c\": 4}";
+    SaxLog invalid;
+    invalid.skip_key = "skip";
+    json_parser_reset(&parser, bad, strlen(bad));
+    EXPECT_EQ(json_parser_parse_sax(&parser, &handler, &invalid), JSON_ERROR_UNEXPECTED_CHAR);
+    EXPECT_EQ(invalid.events, "{ k:skip ");
+}
+
+// Test: NDJSON records are split on newlines and parsed with per-record errors
+TEST(JsonBatchTest, RecordsAndErrors)
+{
+    const std::string json = "{\"a\": [1, 2]}\r\n\n  \n[tru]\n\"x\\ny\"\n{\"b\": {}} 7\n42";
+    json_batch_t batch;
+    json_batch_init(&batch);
+    batch.flags = JSON_FLAG_ZERO_COPY | JSON_FLAG_INTEGERS;
+    ASSERT_EQ(json_batch_parse(&batch, json.c_str(), json.size()), JSON_ERROR_NONE);
+    ASSERT_EQ(batch.record_count, 5);
+    EXPECT_EQ(batch.error_count, 2);
+
+    const json_record_t *r = batch.records;
+    ASSERT_EQ(r[0].error, JSON_ERROR_NONE);
+    EXPECT_EQ(r[0].start, 0);
+    EXPECT_EQ(r[0].end, 14);
+    ASSERT_EQ(r[0].token_count, 5);
+    EXPECT_EQ(r[0].tokens[0].next, 5);
+    EXPECT_EQ(r[0].tokens[2].size, 2);
+    EXPECT_EQ(r[0].tokens[2].next, 5);
+    EXPECT_EQ(r[0].tokens[4].value.integer, 2);
+
+    EXPECT_EQ(r[1].error, JSON_ERROR_INVALID_TOKEN);
+    EXPECT_EQ(r[1].tokens, nullptr);
+    EXPECT_EQ(r[1].token_count, 0);
+    EXPECT_EQ(json[r[1].start], '[');
+    EXPECT_GE(r[1].error_pos, r[1].start);
+    EXPECT_LT(r[1].error_pos, r[1].end);
+
+    // Escaped zero-copy strings are decoded, token offsets are absolute in the input
+    ASSERT_EQ(r[2].token_count, 1);
+    EXPECT_STREQ(r[2].tokens[0].value.string, "x\ny");
+    EXPECT_EQ(r[2].tokens[0].start, r[2].start + 1);
+
+    EXPECT_EQ(r[3].error, JSON_ERROR_TRAILING_CHARS);
+    ASSERT_EQ(r[4].token_count, 1);
+    EXPECT_EQ(r[4].tokens[0].value.integer, 42);
+    EXPECT_EQ(r[4].tokens[0].start, json.size() - 2);
+    json_batch_free(&batch);
+
+    // Empty and blank input has no records
+    ASSERT_EQ(json_batch_parse(&batch, " \n\n", 3), JSON_ERROR_NONE);
+    EXPECT_EQ(batch.record_count, 0);
+    EXPECT_EQ(batch.error_count, 0);
+    json_batch_free(&batch);
+}
+
+// Test: A record view reads record tokens through the parser accessors
+TEST(JsonBatchTest, RecordView)
+{
+    std::string wide = "{\"n\\u0061me\": \"x\\ty\", \"big\": 18446744073709551615";
+
+    for(int i = 0; i < JSON_OBJECT_INDEX_THRESHOLD; i++)
+    {
+        wide += ", \"k" + std::to_string(i) + "\": " + std::to_string(i);
+    }
+
+    const std::string json = "[1]\n" + wide + "}\n{\"a\": }\n";
+
+    for(unsigned int flags : {(unsigned int)JSON_FLAG_INTEGERS, (unsigned int)(JSON_FLAG_ZERO_COPY | JSON_FLAG_INTEGERS | JSON_FLAG_OBJECT_INDEX)})
+    {
+        json_batch_t batch;
+        json_batch_init(&batch);
+        batch.flags = flags;
+        ASSERT_EQ(json_batch_parse(&batch, json.c_str(), json.size()), JSON_ERROR_NONE);
+        ASSERT_EQ(batch.record_count, 3);
+
+        json_parser_t view;
+        ASSERT_EQ(json_record_view(&batch, &batch.records[1], &view), JSON_ERROR_NONE);
+        const json_token_t *root = &view.tokens[0];
+
+        for(int pass = 0; pass < 2; pass++)
+        {
+            const json_token_t *name = json_object_find(&view, root, "name", 4);
+            ASSERT_NE(name, nullptr);
+            size_t length = 0;
+            const char *value = json_token_string(&view, name, &length);
+            EXPECT_EQ(std::string(value, length), "x\ty");
+            const json_token_t *k = json_object_find(&view, root, "k15", 3);
+            ASSERT_NE(k, nullptr);
+            int64_t integer = 0;
+            EXPECT_EQ(json_token_get_int64(&view, k, &integer), JSON_ERROR_NONE);
+            EXPECT_EQ(integer, 15);
+            uint64_t big = 0;
+            EXPECT_EQ(json_token_get_uint64(&view, json_object_find(&view, root, "big", 3), &big), JSON_ERROR_NONE);
+            EXPECT_EQ(big, UINT64_MAX);
+            EXPECT_EQ(json_object_find(&view, root, "k16", 3), nullptr);
+        }
+
+        // The view caches nothing into the batch's tokens
+        EXPECT_EQ(root->value.index, nullptr);
+        json::value doc(&view, root);
+        EXPECT_EQ(doc["k3"].as_int64(), 3);
+        EXPECT_EQ(doc["name"].as_string(), "x\ty");
+        json_parser_free(&view);
+        EXPECT_EQ(batch.records[1].tokens[0].type, JSON_TOKEN_OBJECT);
+
+        // A failed record gives a view that reports its error and finds nothing
+        EXPECT_EQ(json_record_view(&batch, &batch.records[2], &view), JSON_ERROR_INVALID_TOKEN);
+        EXPECT_EQ(view.token_count, 0);
+        EXPECT_EQ(view.error, JSON_ERROR_INVALID_TOKEN);
+        json_batch_free(&batch);
+    }
+}
+
+// Test: Any thread count gives the same records as a single worker
+TEST(JsonBatchTest, ThreadsMatchSingleWorker)
+{
+    std::string json;
+
+    for(int i = 0; i < 2000; ++i)
+    {
+        json += "{\"id\": " + std::to_string(i) + ", \"name\": \"n\\u00e9" + std::to_string(i) + "\", \"tags\": [\"a\", \"b\"]}\n";
+
+        if(i % 97 == 0)
+        {
+            json += "{\"broken\": }\n";
+        }
+    }
+
+    json_batch_t single;
+    json_batch_init(&single);
+    ASSERT_EQ(json_batch_parse(&single, json.c_str(), json.size()), JSON_ERROR_NONE);
+    ASSERT_EQ(single.record_count, 2021);
+    EXPECT_EQ(single.error_count, 21);
+
+    for(unsigned int threads : {2u, 3u, 8u, 5000u})
+    {
+        json_batch_t batch;
+        json_batch_init(&batch);
+        batch.threads = threads;
+        ASSERT_EQ(json_batch_parse(&batch, json.c_str(), json.size()), JSON_ERROR_NONE);
+        ASSERT_EQ(batch.record_count, single.record_count);
+        EXPECT_EQ(batch.error_count, single.error_count);
+        EXPECT_LE(batch.worker_count, threads);
+
+        for(size_t i = 0; i < batch.record_count; ++i)
+        {
+            const json_record_t &a = single.records[i];
+            const json_record_t &b = batch.records[i];
+            ASSERT_EQ(a.start, b.start);
+            ASSERT_EQ(a.error, b.error);
+            ASSERT_EQ(a.error_pos, b.error_pos);
+            ASSERT_EQ(a.token_count, b.token_count);
+
+            for(size_t t = 0; t < a.token_count; ++t)
+            {
+                ASSERT_EQ(a.tokens[t].type, b.tokens[t].type);
+                ASSERT_EQ(a.tokens[t].start, b.tokens[t].start);
+                ASSERT_EQ(a.tokens[t].next, b.tokens[t].next);
+
+                if(a.tokens[t].type == JSON_TOKEN_STRING)
+                {
+                    ASSERT_STREQ(a.tokens[t].value.string, b.tokens[t].value.string);
+                }
+            }
+        }
+
+        json_batch_free(&batch);
+    }
+
+    json_batch_free(&single);
+}
+
+static std::string WriterOutput(const json_writer_t &writer)
+{
+    return std::string(writer.buffer, writer.length);
+}
+
+// Test: Writer places separators, escapes strings and formats numbers
+TEST(JsonWriterTest, ValuesAndEscapes)
+{
+    json_writer_t writer;
+    json_writer_init(&writer, NULL, 1); // Grows from a single byte
+    const char text[] = "a\"b\\\n\x01\xC3\xA9/";
+    json_write_object_begin(&writer);
+    json_write_key(&writer, "s", 1);
+    json_write_string(&writer, text, sizeof(text) - 1);
+    json_write_key(&writer, "n", 1);
+    json_write_array_begin(&writer);
+    json_write_int64(&writer, 1);
+    json_write_int64(&writer, INT64_MIN);
+    json_write_uint64(&writer, UINT64_MAX);
+    json_write_double(&writer, 0.1);
+    json_write_double(&writer, -0.0);
+    json_write_double(&writer, 1e21);
+    json_write_double(&writer, 1.5e-7);
+    json_write_double(&writer, 250.0);
+    json_write_array_end(&writer);
+    json_write_key(&writer, "t", 1);
+    json_write_bool(&writer, 1);
+    json_write_key(&writer, "f", 1);
+    json_write_bool(&writer, 0);
+    json_write_key(&writer, "z", 1);
+    json_write_null(&writer);
+    json_write_key(&writer, "e", 1);
+    json_write_object_begin(&writer);
+    json_write_object_end(&writer);
+    json_write_key(&writer, "a", 1);
+    json_write_array_begin(&writer);
+    json_write_raw(&writer, "[1, 2]", 6);
+    json_write_array_end(&writer);
+    ASSERT_EQ(json_write_object_end(&writer), JSON_ERROR_NONE);
+    EXPECT_EQ(writer.depth, 0u);
+    EXPECT_EQ(WriterOutput(writer),
+              "{\"s\":\"a\\\"b\\\\\\n\\u0001\xC3\xA9/\",\"n\":[1,-9223372036854775808,18446744073709551615,"
+              "0.1,-0,1e21,1.5e-7,250],\"t\":true,\"f\":false,\"z\":null,\"e\":{},\"a\":[[1, 2]]}");
+    json_writer_free(&writer);
+}
+
+// Test: A caller buffer is never grown, and the first error sticks
+TEST(JsonWriterTest, FixedBufferAndErrors)
+{
+    char buffer[8];
+    json_writer_t writer;
+    json_writer_init(&writer, buffer, sizeof(buffer));
+    json_write_array_begin(&writer);
+    EXPECT_EQ(json_write_string(&writer, "abcdef", 6), JSON_ERROR_BUFFER_FULL);
+    EXPECT_EQ(json_write_null(&writer), JSON_ERROR_BUFFER_FULL);
+    EXPECT_STREQ(json_error_string(JSON_ERROR_BUFFER_FULL), "Output buffer full");
+
+    json_writer_reset(&writer);
+    EXPECT_EQ(json_write_double(&writer, NAN), JSON_ERROR_INVALID_NUMBER);
+    json_writer_reset(&writer);
+    EXPECT_EQ(json_write_array_end(&writer), JSON_ERROR_UNEXPECTED_CHAR);
+
+    json_writer_reset(&writer);
+    json_write_array_begin(&writer);
+    json_write_int64(&writer, 42);
+    ASSERT_EQ(json_write_array_end(&writer), JSON_ERROR_NONE);
+    EXPECT_EQ(WriterOutput(writer), "[42]");
+    EXPECT_EQ(writer.buffer, buffer);
+    json_writer_free(&writer);
+}
+
+// Test: Formatted doubles read back as the same value and never need more than 17 digits
+TEST(JsonWriterTest, DoublesRoundTrip)
+{
+    std::mt19937_64 rng(7);
+    json_writer_t writer;
+    json_writer_init(&writer, NULL, 0);
+
+    for(int i = 0; i < 100000; i++)
+    {
+        uint64_t bits = rng();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+
+        if(i % 2)
+        {
+            value = (double)(int64_t)(bits >> 24) / 1000.0;
+        }
+
+        if(!std::isfinite(value))
+        {
+            continue;
+        }
+
+        json_writer_reset(&writer);
+        ASSERT_EQ(json_write_double(&writer, value), JSON_ERROR_NONE);
+        std::string text = WriterOutput(writer);
+        double back = strtod(text.c_str(), NULL);
+        ASSERT_EQ(memcmp(&back, &value, sizeof(value)), 0) << text;
+        std::string digits;
+
+        for(size_t c = 0; c < text.size() && text[c] != 'e'; c++)
+        {
+            if(isdigit((unsigned char)text[c]) && (text[c] != '0' || !digits.empty()))
+            {
+                digits += text[c];
+            }
+        }
+
+        digits.erase(digits.find_last_not_of('0') + 1);
+        ASSERT_LE(digits.size(), 17u) << text;
+    }
+
+    const double edges[] = {5e-324, 2.2250738585072014e-308, 1.7976931348623157e308, 9007199254740993.0, 1e-6, 1e-7};
+    const char *expected[] = {"5e-324", "2.2250738585072014e-308", "1.7976931348623157e308", "9007199254740992", "0.000001", "1e-7"};
+
+    for(size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+    {
+        json_writer_reset(&writer);
+        json_write_double(&writer, edges[i]);
+        EXPECT_EQ(WriterOutput(writer), expected[i]);
+    }
+
+    json_writer_free(&writer);
+}
+
+// Test: Unchanged keys and values are copied verbatim from the parsed input
+TEST_F(JsonParserTest, WriterReemitsTokens)
+{
+    const char *json = "{\"keep\": {\"x\": [1, 2.50]}, \"change\": 5, \"s\": \"a\\u0041\", \"drop\": null}";
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    json_writer_t writer;
+    json_writer_init(&writer, NULL, 0);
+    json_write_object_begin(&writer);
+
+    for(size_t key = 1; key < parser.token_count; key = parser.tokens[key + 1].next)
+    {
+        const json_token_t *value = &parser.tokens[key + 1];
+
+        if(strcmp(parser.tokens[key].value.string, "drop") == 0)
+        {
+            continue;
+        }
+
+        json_write_key_token(&writer, &parser, &parser.tokens[key]);
+
+        if(strcmp(parser.tokens[key].value.string, "change") == 0)
+        {
+            json_write_int64(&writer, 6);
+        }
+        else
+        {
+            json_write_token(&writer, &parser, value);
+        }
+    }
+
+    ASSERT_EQ(json_write_object_end(&writer), JSON_ERROR_NONE);
+    EXPECT_EQ(WriterOutput(writer), "{\"keep\":{\"x\": [1, 2.50]},\"change\":6,\"s\":\"a\\u0041\"}");
+    json_writer_free(&writer);
+}
+
+// Test: C++ views read strings, numbers and literals and look up members and elements
+TEST(JsonDocumentTest, ViewsAndLookups)
+{
+    const std::string json = R"({"name": "J\u00f6rg", "age": 42, "ratio": 0.5, "ok": true, "none": null,
+                                 "tags": ["a", "b", "c"], "nested": {"list": [[1], {"deep": -7}]}})";
+    json::document doc;
+    doc.get()->flags |= JSON_FLAG_ZERO_COPY; // Escaped strings are decoded on first access
+    ASSERT_EQ(doc.parse(json), JSON_ERROR_NONE);
+    EXPECT_TRUE(doc.root().is_object());
+    EXPECT_EQ(doc.root().size(), 7u);
+    EXPECT_EQ(doc["name"].as_string(), "J\xc3\xb6rg");
+    EXPECT_EQ(doc["name"].raw(), "J\\u00f6rg");
+    EXPECT_EQ(doc["age"].as_int64(), 42);
+    EXPECT_EQ(doc["age"].as_uint64(), 42u);
+    EXPECT_EQ(doc["ratio"].as_double(), 0.5);
+    EXPECT_EQ(doc["ratio"].as_int64(-1), -1);
+    EXPECT_TRUE(doc["ok"].as_bool());
+    EXPECT_TRUE(doc["none"].is_null());
+    EXPECT_EQ(doc["tags"][2].as_string(), "c");
+    EXPECT_EQ(doc["nested"]["list"][1]["deep"].as_int64(), -7);
+
+    // Missing values propagate through chains and report their fallbacks
+    EXPECT_FALSE(doc["missing"]);
+    EXPECT_FALSE(doc["tags"][3]);
+    EXPECT_FALSE(doc["age"]["x"]["y"][0]);
+    EXPECT_EQ(doc["missing"].type(), JSON_TOKEN_INVALID);
+    EXPECT_EQ(doc["missing"].as_string(), "");
+    EXPECT_EQ(doc["missing"].as_int64(5), 5);
+    EXPECT_EQ(doc["missing"].size(), 0u);
+    EXPECT_EQ(doc["missing"].begin(), doc["missing"].end());
+
+    std::string keys;
+
+    for(auto [key, value] : doc.root().items())
+    {
+        keys += std::string(key) + (value.is_object() || value.is_array() ? "+" : "") + ",";
+    }
+
+    EXPECT_EQ(keys, "name,age,ratio,ok,none,tags+,nested+,");
+    std::string tags;
+
+    for(json::value tag : doc["tags"])
+    {
+        tags += tag.as_string();
+    }
+
+    EXPECT_EQ(tags, "abc");
+
+    // Iteration steps over nested containers instead of into them
+    size_t count = 0;
+
+    for(json::value element : doc["nested"]["list"])
+    {
+        EXPECT_EQ(element.type(), count ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY);
+        count++;
+    }
+
+    EXPECT_EQ(count, 2u);
+    EXPECT_TRUE(doc["tags"].items().empty());
+    EXPECT_EQ(doc.root().begin(), doc.root().end());
+}
+
+// Test: Documents own their parser once: moves transfer it, copies do not compile
+TEST(JsonDocumentTest, MoveTransfersOwnership)
+{
+    static_assert(!std::is_copy_constructible<json::document>::value, "documents must not copy");
+    static_assert(std::is_nothrow_move_constructible<json::document>::value, "moves must not throw");
+    static_assert(std::is_nothrow_move_assignable<json::document>::value, "moves must not throw");
+
+    const std::string first = "{\"a\": \"first string, long enough to be copied\"}";
+    const std::string second = "[\"second\"]";
+    json::document a;
+    ASSERT_EQ(a.parse(first), JSON_ERROR_NONE);
+    json::document b(std::move(a));
+    EXPECT_EQ(b["a"].as_string(), "first string, long enough to be copied");
+
+    json::document c;
+    ASSERT_EQ(c.parse(second), JSON_ERROR_NONE);
+    c = std::move(b); // Releases c's own tokens and strings
+    EXPECT_EQ(c["a"].as_string(), "first string, long enough to be copied");
+
+    a = std::move(c);
+    EXPECT_EQ(a.parse(second), JSON_ERROR_NONE);
+    EXPECT_EQ(a[0].as_string(), "second");
+
+    json::document failed;
+    EXPECT_EQ(failed.parse("[1,"), JSON_ERROR_UNEXPECTED_CHAR);
+    EXPECT_EQ(failed.error(), JSON_ERROR_UNEXPECTED_CHAR);
+    EXPECT_FALSE(failed.root());
+}
+
+struct BindAddress
+{
+    char city[16];
+    uint16_t zip;
+};
+
+struct BindPerson
+{
+    int32_t id;
+    uint8_t age;
+    int64_t big;
+    double score;
+    float ratio;
+    bool active;
+    int verified;
+    char name[8];
+    BindAddress home;
+};
+
+// Test: json_bind decodes members into a struct and skips everything it does not know
+TEST(JsonBindTest, DecodesIntoStruct)
+{
+    static const json_field_t address_fields[] =
+    {
+        JSON_BIND("city", BindAddress, city, JSON_FIELD_STRING),
+        JSON_BIND("zip", BindAddress, zip, JSON_FIELD_UINT),
+    };
+    json_schema_t address;
+    ASSERT_EQ(json_schema_compile(&address, address_fields, 2), JSON_ERROR_NONE);
+    const json_field_t person_fields[] =
+    {
+        JSON_BIND("id", BindPerson, id, JSON_FIELD_INT),
+        JSON_BIND("age", BindPerson, age, JSON_FIELD_UINT),
+        JSON_BIND("big", BindPerson, big, JSON_FIELD_INT),
+        JSON_BIND("score", BindPerson, score, JSON_FIELD_DOUBLE),
+        JSON_BIND("ratio", BindPerson, ratio, JSON_FIELD_DOUBLE),
+        JSON_BIND("active", BindPerson, active, JSON_FIELD_BOOL),
+        JSON_BIND("verified", BindPerson, verified, JSON_FIELD_BOOL),
+        JSON_BIND("name", BindPerson, name, JSON_FIELD_STRING),
+        JSON_BIND_OBJECT("home", BindPerson, home, &address),
+    };
+    json_schema_t person;
+    ASSERT_EQ(json_schema_compile(&person, person_fields, sizeof(person_fields) / sizeof(person_fields[0])), JSON_ERROR_NONE);
+
+    const char *json = "{\"extra\": {\"deep\": [1, {\"id\": 99}]}, \"id\": -42, \"age\": 200, \"big\": -9223372036854775808,"
+                       " \"score\": 2.5e3, \"ratio\": 0.25, \"active\": true, \"n\\u0061me\": \"Jo\\u00e9\","
+                       " \"home\": {\"zip\": 12345, \"city\": \"Oslo\", \"country\": null}, \"verified\": null, \"id\": 7}";
+    BindPerson p;
+    memset(&p, 0, sizeof(p));
+    p.verified = 3;
+    size_t pos = 1;
+    ASSERT_EQ(json_bind(&person, json, strlen(json), &p, &pos), JSON_ERROR_NONE);
+    EXPECT_EQ(pos, 0u);
+    EXPECT_EQ(p.id, -42); // The first duplicate wins, as in json_object_find
+    EXPECT_EQ(p.age, 200);
+    EXPECT_EQ(p.big, INT64_MIN);
+    EXPECT_EQ(p.score, 2500.0);
+    EXPECT_EQ(p.ratio, 0.25f);
+    EXPECT_TRUE(p.active);
+    EXPECT_EQ(p.verified, 3); // null leaves the member alone
+    EXPECT_STREQ(p.name, "Jo\xc3\xa9");
+    EXPECT_STREQ(p.home.city, "Oslo");
+    EXPECT_EQ(p.home.zip, 12345);
+
+    json_schema_free(&person);
+    json_schema_free(&address);
+}
+
+// Test: json_bind reports type, range and syntax errors where they occur
+TEST(JsonBindTest, Errors)
+{
+    static const json_field_t fields[] =
+    {
+        JSON_BIND("age", BindPerson, age, JSON_FIELD_UINT),
+        JSON_BIND("id", BindPerson, id, JSON_FIELD_INT),
+        JSON_BIND("name", BindPerson, name, JSON_FIELD_STRING),
+    };
+    json_schema_t schema;
+    ASSERT_EQ(json_schema_compile(&schema, fields, 3), JSON_ERROR_NONE);
+    struct
+    {
+        const char *json;
+        json_error_t error;
+        size_t pos;
+    } cases[] =
+    {
+        {"{\"age\": \"old\"}", JSON_ERROR_TYPE_MISMATCH, 8},
+        {"{\"age\": [1, 2]}", JSON_ERROR_TYPE_MISMATCH, 8},
+        {"{\"age\": [1, 2}", JSON_ERROR_UNEXPECTED_CHAR, 13},
+        {"{\"age\": 256}", JSON_ERROR_INVALID_NUMBER, 8},
+        {"{\"age\": -1}", JSON_ERROR_INVALID_NUMBER, 8},
+        {"{\"age\": 1.5}", JSON_ERROR_INVALID_NUMBER, 8},
+        {"{\"id\": 2147483648}", JSON_ERROR_INVALID_NUMBER, 7},
+        {"{\"name\": \"12345678\"}", JSON_ERROR_STRING_TOO_LONG, 9},
+        {"{\"other\": [1, }", JSON_ERROR_INVALID_TOKEN, 14},
+        {"{\"age\": 1 \"id\": 2}", JSON_ERROR_UNEXPECTED_CHAR, 10},
+        {"[1]", JSON_ERROR_TYPE_MISMATCH, 0},
+        {"  ", JSON_ERROR_EMPTY_INPUT, 2},
+        {"{} x", JSON_ERROR_TRAILING_CHARS, 3},
+    };
+
+    for(const auto &c : cases)
+    {
+        BindPerson p;
+        size_t pos = 0;
+        EXPECT_EQ(json_bind(&schema, c.json, strlen(c.json), &p, &pos), c.error) << c.json;
+        EXPECT_EQ(pos, c.pos) << c.json;
+    }
+
+    std::string deep = "{\"skip\": " + std::string(JSON_DEFAULT_MAX_DEPTH, '[') + std::string(JSON_DEFAULT_MAX_DEPTH, ']') + "}";
+    BindPerson p;
+    EXPECT_EQ(json_bind(&schema, deep.data(), deep.size(), &p, NULL), JSON_ERROR_NESTING_DEPTH);
+    json_schema_free(&schema);
+
+    // Descriptors whose member cannot hold the type, or nested schemas not compiled yet
+    json_schema_t nested;
+    memset(&nested, 0, sizeof(nested));
+    const json_field_t bad_size[] = {{"x", JSON_FIELD_INT, 0, 3, NULL}};
+    const json_field_t bad_nested[] = {{"x", JSON_FIELD_OBJECT, 0, 8, &nested}};
+    EXPECT_EQ(json_schema_compile(&schema, bad_size, 1), JSON_ERROR_TYPE_MISMATCH);
+    EXPECT_EQ(json_schema_compile(&schema, bad_nested, 1), JSON_ERROR_TYPE_MISMATCH);
+    json_schema_free(&schema);
+}
+
+// Test: Repeated keys are validated but only the first occurrence is stored
+TEST(JsonBindTest, FirstDuplicateWins)
+{
+    static const json_field_t address_fields[] =
+    {
+        JSON_BIND("city", BindAddress, city, JSON_FIELD_STRING),
+        JSON_BIND("zip", BindAddress, zip, JSON_FIELD_UINT),
+    };
+    json_schema_t address;
+    ASSERT_EQ(json_schema_compile(&address, address_fields, 2), JSON_ERROR_NONE);
+    const json_field_t person_fields[] =
+    {
+        JSON_BIND("name", BindPerson, name, JSON_FIELD_STRING),
+        JSON_BIND_OBJECT("home", BindPerson, home, &address),
+    };
+    json_schema_t person;
+    ASSERT_EQ(json_schema_compile(&person, person_fields, 2), JSON_ERROR_NONE);
+
+    const char *json = "{\"name\": \"A\", \"home\": {\"city\": \"X\", \"city\": \"Y\"}, \"home\": {\"zip\": 9}, \"name\": \"B\"}";
+    BindPerson p{};
+    ASSERT_EQ(json_bind(&person, json, strlen(json), &p, NULL), JSON_ERROR_NONE);
+    EXPECT_STREQ(p.name, "A");
+    EXPECT_STREQ(p.home.city, "X");
+    EXPECT_EQ(p.home.zip, 0);
+
+    // Skipped duplicates are still checked, against the syntax but not the member type
+    const char *wrong_type = "{\"name\": \"A\", \"name\": 5}";
+    EXPECT_EQ(json_bind(&person, wrong_type, strlen(wrong_type), &p, NULL), JSON_ERROR_NONE);
+    const char *broken = "{\"name\": \"A\", \"name\": [}";
+    EXPECT_EQ(json_bind(&person, broken, strlen(broken), &p, NULL), JSON_ERROR_INVALID_TOKEN);
+
+    json_parser_t parser;
+    json_parser_init(&parser, json, strlen(json));
+    ASSERT_EQ(json_parser_parse(&parser), JSON_ERROR_NONE);
+    const json_token_t *name = json_object_find(&parser, &parser.tokens[0], "name", 4);
+    ASSERT_NE(name, nullptr);
+    EXPECT_STREQ(name->value.string, "A");
+    json_parser_free(&parser);
+    json_schema_free(&person);
+    json_schema_free(&address);
+
+    // Schemas with more fields than the inline bitmap holds
+    std::vector<std::string> keys;
+    std::vector<json_field_t> wide;
+    int32_t values[300] = {0};
+
+    for(int i = 0; i < 300; i++)
+    {
+        keys.push_back("f" + std::to_string(i));
+    }
+
+    for(int i = 0; i < 300; i++)
+    {
+        wide.push_back({keys[i].c_str(), JSON_FIELD_INT, i * sizeof(int32_t), sizeof(int32_t), NULL});
+    }
+
+    json_schema_t schema;
+    ASSERT_EQ(json_schema_compile(&schema, wide.data(), wide.size()), JSON_ERROR_NONE);
+    const char *repeated = "{\"f299\": 1, \"f0\": 2, \"f299\": 3, \"f0\": 4}";
+    ASSERT_EQ(json_bind(&schema, repeated, strlen(repeated), values, NULL), JSON_ERROR_NONE);
+    EXPECT_EQ(values[299], 1);
+    EXPECT_EQ(values[0], 2);
+    json_schema_free(&schema);
+}
+
+struct BindText
+{
+    uint8_t id;
+    char text[1024];
+};
+
+// Test: Known strings are bounded by their buffer, the rest by the schema's own limits
+TEST(JsonBindTest, Limits)
+{
+    static const json_field_t fields[] =
+    {
+        JSON_BIND("id", BindText, id, JSON_FIELD_UINT),
+        JSON_BIND("text", BindText, text, JSON_FIELD_STRING),
+    };
+    json_schema_t schema;
+    ASSERT_EQ(json_schema_compile(&schema, fields, 2), JSON_ERROR_NONE);
+    EXPECT_EQ(schema.max_depth, (size_t)JSON_DEFAULT_MAX_DEPTH);
+
+    const std::string long_value(300, 'a');
+    std::string json = "{\"text\": \"" + long_value + "\\u00e9\", \"note\": \"" + long_value + "\", \"id\": 1}";
+    BindText t{};
+    ASSERT_EQ(json_bind(&schema, json.data(), json.size(), &t, NULL), JSON_ERROR_NONE);
+    EXPECT_EQ(std::string(t.text), long_value + "\xc3\xa9");
+    EXPECT_EQ(t.id, 1);
+
+    // 1023 decoded bytes fit with the NUL, 1024 do not
+    std::string fits = "{\"text\": \"" + std::string(1021, 'b') + "\\u00e9\"}";
+    ASSERT_EQ(json_bind(&schema, fits.data(), fits.size(), &t, NULL), JSON_ERROR_NONE);
+    EXPECT_EQ(strlen(t.text), 1023u);
+    std::string too_long = "{\"text\": \"" + std::string(1022, 'b') + "\\u00e9\"}";
+    size_t pos = 0;
+    EXPECT_EQ(json_bind(&schema, too_long.data(), too_long.size(), &t, &pos), JSON_ERROR_STRING_TOO_LONG);
+    EXPECT_EQ(pos, 9u);
+
+    // Skipped values and nesting follow the schema's limits
+    schema.max_string = 100;
+    EXPECT_EQ(json_bind(&schema, json.data(), json.size(), &t, NULL), JSON_ERROR_STRING_TOO_LONG);
+    std::string deep = "{\"skip\": " + std::string(100, '[') + std::string(100, ']') + "}";
+    EXPECT_EQ(json_bind(&schema, deep.data(), deep.size(), &t, NULL), JSON_ERROR_NESTING_DEPTH);
+    schema.max_depth = 101;
+    EXPECT_EQ(json_bind(&schema, deep.data(), deep.size(), &t, NULL), JSON_ERROR_NONE);
+    std::string deep_id = "{\"id\": " + std::string(100, '[') + std::string(100, ']') + "}";
+    EXPECT_EQ(json_bind(&schema, deep_id.data(), deep_id.size(), &t, NULL), JSON_ERROR_TYPE_MISMATCH);
+    schema.max_depth = 100;
+    EXPECT_EQ(json_bind(&schema, deep_id.data(), deep_id.size(), &t, NULL), JSON_ERROR_NESTING_DEPTH);
+    json_schema_free(&schema);
+}
+
+// Test: The C++ schema owns its table and json::bind forwards to json_bind
+TEST(JsonBindTest, CppSchema)
+{
+    static const json_field_t address_fields[] =
+    {
+        JSON_BIND("city", BindAddress, city, JSON_FIELD_STRING),
+        JSON_BIND("zip", BindAddress, zip, JSON_FIELD_UINT),
+    };
+    static const json::schema address(address_fields);
+    static const json_field_t wrapper_fields[] =
+    {
+        JSON_BIND_OBJECT("home", BindPerson, home, address.get()),
+        JSON_BIND("id", BindPerson, id, JSON_FIELD_INT),
+    };
+    json::schema person(wrapper_fields);
+    ASSERT_EQ(address.error(), JSON_ERROR_NONE);
+    ASSERT_EQ(person.error(), JSON_ERROR_NONE);
+    BindPerson p{};
+    ASSERT_EQ(json::bind(person, R"({"id": 5, "home": {"city": "Rome", "zip": 100}})", p), JSON_ERROR_NONE);
+    EXPECT_EQ(p.id, 5);
+    EXPECT_STREQ(p.home.city, "Rome");
+    EXPECT_EQ(p.home.zip, 100);
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
 #include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <map>
 #include "json_parser.h"
+#include "json_parser.hpp"
 
 class JsonStructureTest : public ::testing::Test
 {
@@ -119,14 +124,8 @@ protected:
 
                     if(current_value_token->type == JSON_TOKEN_OBJECT || current_value_token->type == JSON_TOKEN_ARRAY)
                     {
-                        token++; // Move past the object/array token itself
-
-                        while(token < tokens_end && token->start < current_value_token->end)
-                        {
-                            token++; // Skip children
-                        }
-
-                        // Now token is at the next key or end of entry_obj
+                        // Jump over the whole subtree to the next key or end of entry_obj
+                        token = tokens + current_value_token->next;
                     }
                     else
                     {
@@ -223,10 +222,402 @@ TEST_F(JsonStructureTest, ValidateFullStructure)
     }
 
     ASSERT_EQ(entry_count, 100); // Ensure 100 entries
+    ASSERT_EQ(entries_array->size, 100u);
+    ASSERT_EQ(root_obj->next, token_count);
+    // The pre-scan estimate must match the real token count
+    ASSERT_EQ(json_count_tokens(json_str.data(), json_str.size()), token_count);
+}
+
+TEST_F(JsonStructureTest, StructuralIndexMatchesScalar)
+{
+    json_parser_t indexed;
+    json_parser_init(&indexed, json_str.data(), json_str.size());
+    indexed.flags |= JSON_FLAG_STRUCTURAL_INDEX;
+    ASSERT_EQ(json_parser_parse(&indexed), JSON_ERROR_NONE);
+    ASSERT_EQ(indexed.token_count, token_count);
+
+    for(size_t i = 0; i < token_count; i++)
+    {
+        ASSERT_EQ(indexed.tokens[i].type, tokens[i].type) << "Token " << i;
+        ASSERT_EQ(indexed.tokens[i].start, tokens[i].start) << "Token " << i;
+        ASSERT_EQ(indexed.tokens[i].end, tokens[i].end) << "Token " << i;
+    }
+
+    json_parser_free(&indexed);
+}
+
+TEST_F(JsonStructureTest, PathQueryEntryIds)
+{
+    json_path_t path;
+    ASSERT_EQ(json_path_compile(&path, "/entries/*/id", 13), JSON_ERROR_NONE);
+    std::vector<json_path_match_t> matches(200);
+    size_t count = 0;
+    ASSERT_EQ(json_path_query(&path, json_str.data(), json_str.size(), matches.data(), matches.size(), &count), JSON_ERROR_NONE);
+    ASSERT_EQ(count, 100u);
+
+    for(size_t i = 0; i < count; i++)
+    {
+        ASSERT_EQ(json_str.substr(matches[i].start, matches[i].end - matches[i].start), std::to_string(i));
+    }
+
+    json_path_free(&path);
+}
+
+TEST_F(JsonStructureTest, FeedInChunksMatchesParse)
+{
+    for(size_t chunk : {7, 4096})
+    {
+        json_parser_t stream;
+        json_parser_init(&stream, NULL, 0);
+        json_error_t error = JSON_ERROR_NEED_MORE;
+
+        for(size_t pos = 0; pos < json_str.size(); pos += chunk)
+        {
+            error = json_parser_feed(&stream, json_str.data() + pos, std::min(chunk, json_str.size() - pos));
+            ASSERT_TRUE(error == JSON_ERROR_NEED_MORE || error == JSON_ERROR_NONE) << "Chunk at " << pos;
+        }
+
+        ASSERT_EQ(json_parser_finish(&stream), JSON_ERROR_NONE);
+        ASSERT_EQ(stream.token_count, token_count);
+
+        for(size_t i = 0; i < token_count; i++)
+        {
+            ASSERT_EQ(stream.tokens[i].type, tokens[i].type) << "Token " << i;
+            ASSERT_EQ(stream.tokens[i].start, tokens[i].start) << "Token " << i;
+            ASSERT_EQ(stream.tokens[i].end, tokens[i].end) << "Token " << i;
+            ASSERT_EQ(stream.tokens[i].next, tokens[i].next) << "Token " << i;
+        }
+
+        json_parser_free(&stream);
+    }
+}
+
+TEST_F(JsonStructureTest, SaxKeepsTokenArrayAtDepth)
+{
+    json_sax_handler_t handler = {};
+    handler.on_key = [](void *user, const char *key, size_t length)
+    {
+        *static_cast<size_t *>(user) += length == 2 && memcmp(key, "id", 2) == 0;
+        return JSON_SAX_CONTINUE;
+    };
+    size_t ids = 0;
+    json_parser_t sax;
+    json_parser_init(&sax, json_str.data(), json_str.size());
+    ASSERT_EQ(json_parser_parse_sax(&sax, &handler, &ids), JSON_ERROR_NONE);
+    ASSERT_EQ(ids, 100u);
+    ASSERT_EQ(sax.token_count, 0u);
+    ASSERT_EQ(sax.token_cap, (size_t)JSON_DEFAULT_MAX_TOKENS);
+    json_parser_free(&sax);
+}
+
+TEST_F(JsonStructureTest, ParallelEntriesMatchParse)
+{
+    json_path_t path;
+    ASSERT_EQ(json_path_compile(&path, "/entries", 8), JSON_ERROR_NONE);
+    json_parser_t split;
+    json_parser_init(&split, json_str.data(), json_str.size());
+    ASSERT_EQ(json_parser_parse_parallel(&split, &path, 4), JSON_ERROR_NONE);
+    ASSERT_EQ(split.token_count, token_count);
+
+    for(size_t i = 0; i < token_count; i++)
+    {
+        ASSERT_EQ(split.tokens[i].type, tokens[i].type) << "Token " << i;
+        ASSERT_EQ(split.tokens[i].start, tokens[i].start) << "Token " << i;
+        ASSERT_EQ(split.tokens[i].end, tokens[i].end) << "Token " << i;
+        ASSERT_EQ(split.tokens[i].size, tokens[i].size) << "Token " << i;
+        ASSERT_EQ(split.tokens[i].next, tokens[i].next) << "Token " << i;
+    }
+
+    json_parser_free(&split);
+    json_path_free(&path);
+}
+
+TEST_F(JsonStructureTest, InitFileMatchesParse)
+{
+    json_parser_t mapped;
+    ASSERT_EQ(json_parser_init_file(&mapped, "../large_json_file.json"), JSON_ERROR_NONE);
+    ASSERT_EQ(mapped.length, json_str.size());
+    ASSERT_EQ(json_parser_parse(&mapped), JSON_ERROR_NONE);
+    ASSERT_EQ(mapped.token_count, token_count);
+
+    for(size_t i = 0; i < token_count; i++)
+    {
+        ASSERT_EQ(mapped.tokens[i].type, tokens[i].type) << "Token " << i;
+        ASSERT_EQ(mapped.tokens[i].start, tokens[i].start) << "Token " << i;
+        ASSERT_EQ(mapped.tokens[i].end, tokens[i].end) << "Token " << i;
+    }
+
+    json_parser_free(&mapped);
+}
+
+TEST_F(JsonStructureTest, ValidateWithoutTokens)
+{
+    size_t pos = 1;
+    ASSERT_EQ(json_validate(json_str.data(), json_str.size(), JSON_DEFAULT_MAX_DEPTH, JSON_DEFAULT_MAX_STRING, &pos), JSON_ERROR_NONE);
+    EXPECT_EQ(pos, 0u);
+
+    std::string broken = json_str;
+    size_t last_id = broken.rfind("\"id\"");
+    ASSERT_NE(last_id, std::string::npos);
+    broken[last_id + 4] = ' ';
+    json_parser_t full;
+    json_parser_init(&full, broken.data(), broken.size());
+    json_error_t expected = json_parser_parse(&full);
+    ASSERT_NE(expected, JSON_ERROR_NONE);
+    EXPECT_EQ(json_validate(broken.data(), broken.size(), JSON_DEFAULT_MAX_DEPTH, JSON_DEFAULT_MAX_STRING, &pos), expected);
+    EXPECT_EQ(pos, full.pos);
+    json_parser_free(&full);
+}
+
+// Writes the value at tokens[i] from its parsed form, returns the index after it
+static size_t WriteValue(json_writer_t *writer, const json_token_t *tokens, size_t i)
+{
+    const json_token_t *t = &tokens[i++];
+
+    switch(t->type)
+    {
+        case JSON_TOKEN_OBJECT:
+            json_write_object_begin(writer);
+
+            for(unsigned int m = 0; m < t->size; m++)
+            {
+                json_write_key(writer, tokens[i].value.string, strlen(tokens[i].value.string));
+                i = WriteValue(writer, tokens, i + 1);
+            }
+
+            json_write_object_end(writer);
+            break;
+
+        case JSON_TOKEN_ARRAY:
+            json_write_array_begin(writer);
+
+            for(unsigned int m = 0; m < t->size; m++)
+            {
+                i = WriteValue(writer, tokens, i);
+            }
+
+            json_write_array_end(writer);
+            break;
+
+        case JSON_TOKEN_STRING:
+            json_write_string(writer, t->value.string, strlen(t->value.string));
+            break;
+
+        case JSON_TOKEN_NUMBER:
+            json_write_double(writer, t->value.number);
+            break;
+
+        case JSON_TOKEN_TRUE:
+        case JSON_TOKEN_FALSE:
+            json_write_bool(writer, t->type == JSON_TOKEN_TRUE);
+            break;
+
+        default:
+            json_write_null(writer);
+            break;
+    }
+
+    return i;
+}
+
+TEST_F(JsonStructureTest, WriterRebuildsDocument)
+{
+    json_writer_t writer;
+    json_writer_init(&writer, NULL, 0);
+    ASSERT_EQ(WriteValue(&writer, tokens, 0), token_count);
+    ASSERT_EQ(writer.error, JSON_ERROR_NONE);
+    ASSERT_LT(writer.length, json_str.size()); // Whitespace is gone
+
+    json_parser_t rebuilt;
+    json_parser_init(&rebuilt, writer.buffer, writer.length);
+    ASSERT_EQ(json_parser_parse(&rebuilt), JSON_ERROR_NONE);
+    ASSERT_EQ(rebuilt.token_count, token_count);
+
+    for(size_t i = 0; i < token_count; i++)
+    {
+        ASSERT_EQ(rebuilt.tokens[i].type, tokens[i].type) << "Token " << i;
+        ASSERT_EQ(rebuilt.tokens[i].size, tokens[i].size) << "Token " << i;
+
+        if(tokens[i].type == JSON_TOKEN_STRING)
+        {
+            ASSERT_STREQ(rebuilt.tokens[i].value.string, tokens[i].value.string) << "Token " << i;
+        }
+        else if(tokens[i].type == JSON_TOKEN_NUMBER)
+        {
+            ASSERT_EQ(rebuilt.tokens[i].value.number, tokens[i].value.number) << "Token " << i;
+        }
+    }
+
+    json_parser_free(&rebuilt);
+    json_writer_free(&writer);
+}
+
+// Walks a value through the C++ views, checking that it is the token at `*index`
+static void WalkValue(const json::value &value, const json_token_t *tokens, size_t *index)
+{
+    ASSERT_EQ(value.token(), &tokens[*index]);
+    (*index)++;
+
+    for(auto [key, member] : value.items())
+    {
+        ASSERT_EQ(key, tokens[*index].value.string);
+        (*index)++;
+        WalkValue(member, tokens, index);
+    }
+
+    for(json::value element : value)
+    {
+        WalkValue(element, tokens, index);
+    }
+}
+
+// Test: Iterating the document through the C++ views visits every token in order
+TEST_F(JsonStructureTest, DocumentViewsVisitEveryToken)
+{
+    json::document doc;
+    ASSERT_EQ(doc.parse(json_str), JSON_ERROR_NONE);
+    size_t count = 0;
+    const json_token_t *doc_tokens = json_get_tokens(doc.get(), &count);
+    ASSERT_EQ(count, token_count);
+    size_t index = 0;
+    WalkValue(doc.root(), doc_tokens, &index);
+    ASSERT_EQ(index, token_count);
+}
+
+struct BoundMetadata
+{
+    char version[8];
+    char author[16];
+    bool valid;
+};
+
+struct BoundDocument
+{
+    BoundMetadata metadata;
+};
+
+// Test: Binding the metadata skips the entries array and matches the parsed tokens
+TEST_F(JsonStructureTest, BindMetadataSkipsEntries)
+{
+    static const json_field_t metadata_fields[] =
+    {
+        JSON_BIND("version", BoundMetadata, version, JSON_FIELD_STRING),
+        JSON_BIND("author", BoundMetadata, author, JSON_FIELD_STRING),
+        JSON_BIND("valid", BoundMetadata, valid, JSON_FIELD_BOOL),
+    };
+    json_schema_t metadata;
+    ASSERT_EQ(json_schema_compile(&metadata, metadata_fields, 3), JSON_ERROR_NONE);
+    const json_field_t document_fields[] = {JSON_BIND_OBJECT("metadata", BoundDocument, metadata, &metadata)};
+    json_schema_t document;
+    ASSERT_EQ(json_schema_compile(&document, document_fields, 1), JSON_ERROR_NONE);
+
+    BoundDocument bound{};
+    ASSERT_EQ(json_bind(&document, json_str.data(), json_str.size(), &bound, NULL), JSON_ERROR_NONE);
+    const json_token_t *meta = json_object_find(&parser, &tokens[0], "metadata", 8);
+    ASSERT_NE(meta, nullptr);
+    EXPECT_STREQ(bound.metadata.version, json_object_find(&parser, meta, "version", 7)->value.string);
+    EXPECT_STREQ(bound.metadata.author, json_object_find(&parser, meta, "author", 6)->value.string);
+    EXPECT_EQ(bound.metadata.valid, json_object_find(&parser, meta, "valid", 5)->type == JSON_TOKEN_TRUE);
+
+    json_schema_free(&document);
+    json_schema_free(&metadata);
+}
+
+// Test: Interning the keys leaves every token as it was and stores each distinct key once
+TEST_F(JsonStructureTest, InternedKeysMatchCopies)
+{
+    json_parser_t interned;
+    json_parser_init(&interned, json_str.c_str(), json_str.size());
+    interned.flags = JSON_FLAG_INTERN_KEYS;
+    ASSERT_EQ(json_parser_parse(&interned), JSON_ERROR_NONE);
+    ASSERT_EQ(interned.token_count, token_count);
+    std::map<std::string, const char *> keys;
+    size_t key_tokens = 0;
+
+    for(size_t i = 0; i < token_count; i++)
+    {
+        const json_token_t &token = interned.tokens[i];
+        EXPECT_EQ(token.type, tokens[i].type) << i;
+        EXPECT_EQ(token.start, tokens[i].start) << i;
+        EXPECT_EQ(token.next, tokens[i].next) << i;
+
+        if(token.type == JSON_TOKEN_STRING)
+        {
+            EXPECT_STREQ(token.value.string, tokens[i].value.string) << i;
+        }
+
+        if(token.flags & JSON_TOKEN_FLAG_INTERNED)
+        {
+            auto inserted = keys.emplace(token.value.string, token.value.string);
+            key_tokens++;
+            EXPECT_EQ(inserted.first->second, token.value.string) << i;
+        }
+    }
+
+    EXPECT_EQ(keys.size(), interned.intern->count);
+    EXPECT_LT(keys.size(), key_tokens);
+    json_parser_free(&interned);
+}
+
+// Test: Freezing the parse keeps every token, string and number of the document
+TEST_F(JsonStructureTest, FrozenMatchesTokens)
+{
+    json_frozen_t *frozen = NULL;
+    ASSERT_EQ(json_freeze_alloc(&parser, &frozen), JSON_ERROR_NONE);
+    ASSERT_EQ(frozen->token_count, token_count);
+    const json_frozen_token_t *frozen_tokens = JSON_FROZEN_TOKENS(frozen);
+
+    for(size_t i = 0; i < token_count; i++)
+    {
+        EXPECT_EQ(frozen_tokens[i].type, tokens[i].type) << i;
+        EXPECT_EQ(frozen_tokens[i].next, tokens[i].next) << i;
+
+        if(tokens[i].type == JSON_TOKEN_STRING)
+        {
+            size_t length = 0;
+            EXPECT_STREQ(json_frozen_string(frozen, &frozen_tokens[i], &length), tokens[i].value.string) << i;
+            EXPECT_EQ(length, strlen(tokens[i].value.string)) << i;
+        }
+        else
+        {
+            EXPECT_EQ(frozen_tokens[i].size, tokens[i].size) << i;
+        }
+
+        if(tokens[i].type == JSON_TOKEN_NUMBER)
+        {
+            EXPECT_EQ(json_frozen_value(frozen, &frozen_tokens[i])->number, tokens[i].value.number) << i;
+        }
+    }
+
+    const json_frozen_token_t *metadata = json_frozen_find(frozen, frozen_tokens, "metadata", 8);
+    ASSERT_NE(metadata, nullptr);
+    EXPECT_EQ(metadata - frozen_tokens, json_object_find(&parser, &tokens[0], "metadata", 8) - tokens);
+    json_frozen_free(frozen);
+}
+
+// Test: A tape of the document reloads to the same tokens as a fresh freeze
+TEST_F(JsonStructureTest, TapeReloadMatchesFreeze)
+{
+    const char *source = "../large_json_file.json";
+    const char *path = "validation_test_tape.bin";
+    ASSERT_EQ(json_tape_save(&parser, path, source), JSON_ERROR_NONE);
+    json_frozen_t *frozen = NULL;
+    ASSERT_EQ(json_freeze_alloc(&parser, &frozen), JSON_ERROR_NONE);
+
+    json_tape_t tape;
+    ASSERT_EQ(json_tape_open(&tape, path, source, 0), JSON_ERROR_NONE);
+    EXPECT_FALSE(tape.reparsed);
+    ASSERT_EQ(tape.frozen->size, frozen->size);
+    EXPECT_EQ(memcmp(tape.frozen, frozen, (size_t)frozen->size), 0);
+    EXPECT_EQ(JSON_FROZEN_TOKENS(tape.frozen)[0].next, token_count);
+
+    json_tape_free(&tape);
+    json_frozen_free(frozen);
+    remove(path);
 }
 
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}